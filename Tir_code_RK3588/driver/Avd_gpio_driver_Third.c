@@ -10,6 +10,23 @@
 #include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
+#include <linux/bitmap.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define CREATE_TRACE_POINTS
+#include "Avd_gpio_trace.h"
 
 // GPIO编号：A对应1，B对应2，C对应3，D对应4
 // 在rk3588上确定GPIO编号的公式为：GPIOn_xy=n*32+(x-1)*8+y
@@ -20,6 +37,79 @@
 #define SET_GPIO_OFF _IO(GPIO_IOC_MAGIC, 1)
 #define SET_GPIO_ALL_ON _IO(GPIO_IOC_MAGIC, 2)
 #define SET_GPIO_ALL_OFF _IO(GPIO_IOC_MAGIC, 3)
+
+/*
+ * 脉冲串命令：由内核 hrtimer 产生 PUL 边沿，一次 ioctl 完成一整段运动。
+ * 用户态结构体定义见 motor.h，两边必须保持一致。
+ */
+struct gpio_pulse_train
+{
+    __u32 pul_idx;   // 脉冲引脚索引
+    __u32 dir_idx;   // 方向引脚索引
+    __u32 en_idx;    // 使能引脚索引
+    __u32 dir_value; // 方向电平（启动前预先设置）
+    __u32 en_value;  // 使能电平（启动前预先设置）
+    __u32 edges;     // 需要输出的边沿数（每个边沿翻转一次电平）
+    __u32 period_ns; // 相邻两个边沿的间隔
+};
+
+// 延迟直方图分桶上限（ns），最后一桶为其余
+#define GPIO_JITTER_BUCKETS 8
+static const u32 jitter_bounds_ns[GPIO_JITTER_BUCKETS - 1] = {
+    1000, 5000, 10000, 20000, 50000, 100000, 500000};
+
+struct gpio_pulse_status
+{
+    __u32 pul_idx;   // 查询的脉冲引脚索引
+    __u32 wait_ms;   // >0 时阻塞等待脉冲串结束，最多等待 wait_ms 毫秒
+    __u32 running;   // 返回：1 表示仍在输出
+    __u32 done;      // 返回：已输出的边沿数
+    __u32 remaining; // 返回：剩余边沿数
+    __u32 late_max_ns; // 返回：边沿相对截止时间的最大延迟
+    __u32 late_avg_ns; // 返回：平均延迟
+    __u32 missed;      // 返回：延迟超过一个周期的边沿数
+    __u32 hist[GPIO_JITTER_BUCKETS]; // 返回：延迟直方图
+};
+
+// 分段脉冲串：每段边沿间隔恒定，用来近似加减速曲线
+#define GPIO_PULSE_MAX_SEGS 32
+
+struct gpio_pulse_seg
+{
+    __u32 edges;     // 本段边沿数
+    __u32 period_ns; // 本段边沿间隔
+};
+
+struct gpio_pulse_profile
+{
+    __u32 pul_idx;
+    __u32 dir_idx;
+    __u32 en_idx;
+    __u32 dir_value;
+    __u32 en_value;
+    __u32 nseg; // 有效分段数 1~GPIO_PULSE_MAX_SEGS
+    struct gpio_pulse_seg seg[GPIO_PULSE_MAX_SEGS];
+};
+
+#define GPIO_PULSE_START _IOW(GPIO_IOC_MAGIC, 4, struct gpio_pulse_train)
+#define GPIO_PULSE_STOP _IO(GPIO_IOC_MAGIC, 5)
+#define GPIO_PULSE_STATUS _IOWR(GPIO_IOC_MAGIC, 6, struct gpio_pulse_status)
+#define GPIO_PULSE_PROFILE _IOW(GPIO_IOC_MAGIC, 7, struct gpio_pulse_profile)
+
+/*
+ * 批量写：bit i 对应 gpio_pins[i]，只修改 mask 中置位的引脚。
+ * 同一 GPIO 控制器上的引脚（本板全部在 GPIO3）在一次寄存器写中同时变化。
+ */
+struct gpio_mask
+{
+    __u32 mask;  // 需要修改的引脚
+    __u32 value; // 对应引脚的电平
+};
+
+#define SET_GPIO_MASK _IOW(GPIO_IOC_MAGIC, 8, struct gpio_mask)
+
+// 边沿间隔下限，防止过小的周期把 CPU 卡死在 hrtimer 中断里
+#define GPIO_PULSE_MIN_PERIOD_NS 5000
 /*
 A: B5 B4 A2
 B: B0 C3 D3
@@ -62,7 +152,66 @@ static int gpio_pins[] = {
     105, // GPIO3_B1
     103  // GPIO3_A7
 };
-static int gpio_count = ARRAY_SIZE(gpio_pins);
+static unsigned int gpio_count = ARRAY_SIZE(gpio_pins);
+
+// 允许加载时替换引脚编号，便于在 gpio-sim/gpio-mockup 上测试：
+// insmod Avd_gpio_driver_Third.ko gpio_pins=512,513,...
+module_param_array(gpio_pins, int, &gpio_count, 0444);
+MODULE_PARM_DESC(gpio_pins, "GPIO numbers in table order (A_EN A_DIR A_PUL B_EN ... D_PUL)");
+
+// 逐次写入的日志默认关闭，需要时 echo 1 > /sys/module/Avd_gpio_driver_Third/parameters/debug
+// 高频场景请改用 avd_gpio tracepoint
+static bool debug;
+module_param(debug, bool, 0644);
+MODULE_PARM_DESC(debug, "Log every pin write and pulse train start (rate limited)");
+
+#define gpio_dbg(fmt, ...)                                              \
+    do                                                                  \
+    {                                                                   \
+        if (unlikely(debug))                                            \
+            pr_info_ratelimited("GPIO Driver: " fmt, ##__VA_ARGS__);    \
+    } while (0)
+
+// 每个引脚的计数，通过 debugfs 的 avd_gpio/pins 查看
+struct gpio_pin_stats
+{
+    atomic_long_t writes; // ioctl 写入次数（ON/OFF/ALL/MASK）
+    atomic_long_t edges;  // 脉冲串输出的边沿数
+    atomic_long_t trains; // 启动的脉冲串数
+    atomic_long_t busy;   // 因脉冲串占用被拒绝的写入
+};
+
+static struct gpio_pin_stats pin_stats[ARRAY_SIZE(gpio_pins)];
+static struct dentry *gpio_debugfs_dir;
+
+// 每个引脚一个脉冲串发生器，按 gpio_pins[] 索引
+struct pulse_train_state
+{
+    struct hrtimer timer;
+    struct work_struct work; // 可睡眠的 GPIO（如 gpio-sim）在工作队列里逐个输出边沿
+    spinlock_t lock;
+    struct gpio_pulse_seg seg[GPIO_PULSE_MAX_SEGS];
+    u32 nseg;
+    u32 cur_seg;
+    u32 seg_left; // 当前段剩余边沿数
+    ktime_t period;
+    int pin;
+    int level;
+    bool cansleep;
+    bool running;
+    u32 done;
+    u32 remaining;
+    u64 late_sum_ns;
+    u32 late_max_ns;
+    u32 missed;
+    u32 hist[GPIO_JITTER_BUCKETS];
+};
+
+static struct pulse_train_state pulse_trains[ARRAY_SIZE(gpio_pins)];
+static DECLARE_WAIT_QUEUE_HEAD(pulse_wq);
+static struct workqueue_struct *pulse_sleep_wq;
+// 占用引脚（启动脉冲串）与“检查未占用后写入”互斥；写可睡眠的 GPIO 不能持有 pt->lock
+static DEFINE_MUTEX(pulse_claim_lock);
 
 // 全局变量
 static dev_t dev_num;
@@ -71,6 +220,250 @@ int major;
 int minor;
 static struct class *my_GPIO;
 static struct device *GPIO_Device;
+/*
+ * @description : 记录一个边沿的延迟，翻转电平并推进分段，调用时持有 pt->lock
+ * @return : true 表示这是最后一个边沿
+ */
+static bool pulse_train_edge(struct pulse_train_state *pt, s64 late)
+{
+    int b;
+
+    if (late < 0)
+        late = 0;
+    pt->late_sum_ns += late;
+    if (late > pt->late_max_ns)
+        pt->late_max_ns = min_t(s64, late, U32_MAX);
+    if (late > ktime_to_ns(pt->period))
+        pt->missed++;
+    for (b = 0; b < GPIO_JITTER_BUCKETS - 1 && late >= jitter_bounds_ns[b]; b++)
+        ;
+    pt->hist[b]++;
+
+    pt->level = !pt->level;
+    trace_avd_gpio_edge(pt - pulse_trains, pt->level, late);
+    atomic_long_inc(&pin_stats[pt - pulse_trains].edges);
+
+    pt->done++;
+    if (--pt->remaining == 0)
+        return true;
+    // 当前段输出完毕，切换到下一段的周期
+    if (--pt->seg_left == 0 && pt->cur_seg + 1 < pt->nseg)
+    {
+        pt->cur_seg++;
+        pt->seg_left = pt->seg[pt->cur_seg].edges;
+        pt->period = ns_to_ktime(pt->seg[pt->cur_seg].period_ns);
+    }
+    return false;
+}
+
+static enum hrtimer_restart pulse_train_timer_fn(struct hrtimer *timer)
+{
+    struct pulse_train_state *pt = container_of(timer, struct pulse_train_state, timer);
+    enum hrtimer_restart ret = HRTIMER_RESTART;
+    unsigned long flags;
+    bool last;
+    s64 late;
+
+    // 记录本次边沿相对到期时间的延迟
+    late = ktime_to_ns(ktime_sub(hrtimer_cb_get_time(timer), hrtimer_get_expires(timer)));
+
+    spin_lock_irqsave(&pt->lock, flags);
+    if (!pt->running)
+    {
+        // 启动后在第一个边沿之前被停止
+        spin_unlock_irqrestore(&pt->lock, flags);
+        return HRTIMER_NORESTART;
+    }
+    last = pulse_train_edge(pt, late);
+    // 只有不睡眠的 GPIO 走这里，可以在中断上下文直接写
+    gpio_set_value(pt->pin, pt->level);
+    if (last)
+    {
+        pt->running = false;
+        ret = HRTIMER_NORESTART;
+        trace_avd_gpio_train_end(pt - pulse_trains, pt->done, 0, pt->missed);
+    }
+    else
+    {
+        // 在上一次到期时间上累加，避免中断延迟累积成漂移
+        hrtimer_add_expires(timer, pt->period);
+    }
+    spin_unlock_irqrestore(&pt->lock, flags);
+
+    if (ret == HRTIMER_NORESTART)
+        wake_up_interruptible(&pulse_wq);
+    return ret;
+}
+
+/*
+ * 可睡眠的 GPIO（如 gpio-sim）不能在 hrtimer 回调里写，整个脉冲串在工作队列中输出：
+ * 睡眠到每个边沿的到期时间后按顺序写入，调度延迟只会推迟边沿，不会合并或丢失边沿。
+ */
+static void pulse_train_work_fn(struct work_struct *work)
+{
+    struct pulse_train_state *pt = container_of(work, struct pulse_train_state, work);
+    unsigned long flags;
+    ktime_t expires, t;
+    bool last = false;
+    int level;
+
+    spin_lock_irqsave(&pt->lock, flags);
+    expires = ktime_add(ktime_get(), pt->period);
+    spin_unlock_irqrestore(&pt->lock, flags);
+
+    while (!last)
+    {
+        t = expires;
+        set_current_state(TASK_UNINTERRUPTIBLE);
+        schedule_hrtimeout_range(&t, 0, HRTIMER_MODE_ABS);
+
+        spin_lock_irqsave(&pt->lock, flags);
+        if (!pt->running)
+        {
+            spin_unlock_irqrestore(&pt->lock, flags);
+            return;
+        }
+        last = pulse_train_edge(pt, ktime_to_ns(ktime_sub(ktime_get(), expires)));
+        level = pt->level;
+        expires = ktime_add(expires, pt->period);
+        spin_unlock_irqrestore(&pt->lock, flags);
+
+        gpio_set_value_cansleep(pt->pin, level);
+    }
+
+    // 最后一个边沿写入之后才报告结束
+    spin_lock_irqsave(&pt->lock, flags);
+    if (pt->running)
+    {
+        pt->running = false;
+        trace_avd_gpio_train_end(pt - pulse_trains, pt->done, 0, pt->missed);
+    }
+    spin_unlock_irqrestore(&pt->lock, flags);
+    wake_up_interruptible(&pulse_wq);
+}
+
+static bool pulse_train_busy(unsigned long idx)
+{
+    bool busy;
+    unsigned long flags;
+
+    spin_lock_irqsave(&pulse_trains[idx].lock, flags);
+    busy = pulse_trains[idx].running;
+    spin_unlock_irqrestore(&pulse_trains[idx].lock, flags);
+    return busy;
+}
+
+static void pulse_train_stop(unsigned long idx)
+{
+    struct pulse_train_state *pt = &pulse_trains[idx];
+    unsigned long flags;
+
+    // 先清除 running，定时器回调和工作队列看到后不再输出边沿
+    spin_lock_irqsave(&pt->lock, flags);
+    if (pt->running)
+        trace_avd_gpio_train_end(idx, pt->done, pt->remaining, pt->missed);
+    pt->running = false;
+    pt->remaining = 0;
+    spin_unlock_irqrestore(&pt->lock, flags);
+
+    hrtimer_cancel(&pt->timer);
+    cancel_work_sync(&pt->work);
+    wake_up_interruptible(&pulse_wq);
+}
+
+static int pulse_train_start(const struct gpio_pulse_profile *req)
+{
+    struct pulse_train_state *pt;
+    unsigned long flags;
+    u32 total = 0;
+    u32 i;
+    int level;
+
+    if (req->pul_idx >= gpio_count || req->dir_idx >= gpio_count || req->en_idx >= gpio_count)
+        return -EINVAL;
+    if (req->nseg == 0 || req->nseg > GPIO_PULSE_MAX_SEGS)
+        return -EINVAL;
+    for (i = 0; i < req->nseg; i++)
+    {
+        if (req->seg[i].edges == 0 || req->seg[i].period_ns < GPIO_PULSE_MIN_PERIOD_NS)
+            return -EINVAL;
+        total += req->seg[i].edges;
+    }
+
+    pt = &pulse_trains[req->pul_idx];
+    level = gpio_get_value_cansleep(gpio_pins[req->pul_idx]) ? 1 : 0;
+
+    // 检查和占用在同一次加锁内完成，同一引脚的并发启动只有一个成功
+    mutex_lock(&pulse_claim_lock);
+    spin_lock_irqsave(&pt->lock, flags);
+    if (pt->running)
+    {
+        spin_unlock_irqrestore(&pt->lock, flags);
+        mutex_unlock(&pulse_claim_lock);
+        atomic_long_inc(&pin_stats[req->pul_idx].busy);
+        return -EBUSY;
+    }
+    memcpy(pt->seg, req->seg, req->nseg * sizeof(req->seg[0]));
+    pt->nseg = req->nseg;
+    pt->cur_seg = 0;
+    pt->seg_left = pt->seg[0].edges;
+    pt->pin = gpio_pins[req->pul_idx];
+    pt->cansleep = gpio_cansleep(pt->pin);
+    pt->level = level;
+    pt->period = ns_to_ktime(pt->seg[0].period_ns);
+    pt->done = 0;
+    pt->remaining = total;
+    pt->late_sum_ns = 0;
+    pt->late_max_ns = 0;
+    pt->missed = 0;
+    memset(pt->hist, 0, sizeof(pt->hist));
+    pt->running = true;
+    spin_unlock_irqrestore(&pt->lock, flags);
+    mutex_unlock(&pulse_claim_lock);
+
+    // 先建立方向和使能，第一个边沿在一个周期后输出，满足驱动器的建立时间
+    gpio_set_value_cansleep(gpio_pins[req->en_idx], req->en_value ? 1 : 0);
+    gpio_set_value_cansleep(gpio_pins[req->dir_idx], req->dir_value ? 1 : 0);
+
+    atomic_long_inc(&pin_stats[req->pul_idx].trains);
+    trace_avd_gpio_train_start(req->pul_idx, req->nseg, total, req->seg[0].period_ns);
+    gpio_dbg("Pulse train on GPIO[%u]: %u segments, %u edges\n", req->pul_idx, req->nseg, total);
+    if (gpio_cansleep(gpio_pins[req->pul_idx]))
+        queue_work(pulse_sleep_wq, &pt->work);
+    else
+        hrtimer_start(&pt->timer, ns_to_ktime(req->seg[0].period_ns), HRTIMER_MODE_REL);
+    return 0;
+}
+
+static int pulse_train_status(struct gpio_pulse_status *st)
+{
+    struct pulse_train_state *pt;
+    unsigned long flags;
+
+    if (st->pul_idx >= gpio_count)
+        return -EINVAL;
+
+    pt = &pulse_trains[st->pul_idx];
+    if (st->wait_ms > 0)
+    {
+        long ret = wait_event_interruptible_timeout(pulse_wq, !pulse_train_busy(st->pul_idx),
+                                                    msecs_to_jiffies(st->wait_ms));
+        if (ret < 0)
+            return ret;
+    }
+
+    spin_lock_irqsave(&pt->lock, flags);
+    st->running = pt->running;
+    st->done = pt->done;
+    st->remaining = pt->remaining;
+    st->late_max_ns = pt->late_max_ns;
+    st->late_avg_ns = pt->done ? div_u64(pt->late_sum_ns, pt->done) : 0;
+    st->missed = pt->missed;
+    memcpy(st->hist, pt->hist, sizeof(st->hist));
+    spin_unlock_irqrestore(&pt->lock, flags);
+    return 0;
+}
+
 static int device_open(struct inode *inode, struct file *file)
 {
     int i;
@@ -79,25 +472,146 @@ static int device_open(struct inode *inode, struct file *file)
     {
         gpio_direction_output(gpio_pins[i], 0);
     }
-    printk(KERN_INFO "GPIO Driver: Device opened, %d GPIOs initialized\n", gpio_count);
+    printk(KERN_INFO "GPIO Driver: Device opened, %u GPIOs initialized\n", gpio_count);
     return 0;
 }
 
 static int device_release(struct inode *inode, struct file *file)
 {
     int i;
-    // 设备关闭时将所有GPIO设为低电平
+    // 设备关闭时停止所有脉冲串，并将所有GPIO设为低电平
     for (i = 0; i < gpio_count; i++)
     {
-        gpio_set_value(gpio_pins[i], 0);
+        pulse_train_stop(i);
+        gpio_set_value_cansleep(gpio_pins[i], 0);
     }
     printk(KERN_INFO "GPIO Driver: Device closed, all GPIOs set to LOW\n");
     return 0;
 }
 
+/*
+ * @description : 按掩码同时设置多个引脚
+ * @return : 0 成功；-EINVAL 掩码超出引脚表；-EBUSY 其中有引脚正在输出脉冲串
+ */
+static int gpio_set_mask(u32 mask, u32 value)
+{
+    struct gpio_desc *descs[ARRAY_SIZE(gpio_pins)];
+    DECLARE_BITMAP(values, ARRAY_SIZE(gpio_pins));
+    unsigned int i, n = 0;
+    int ret = 0;
+
+    if (gpio_count < 32 && (mask >> gpio_count))
+        return -EINVAL;
+
+    bitmap_zero(values, ARRAY_SIZE(gpio_pins));
+    // 检查到写入结束一直持有占用锁，期间不会有脉冲串在这些引脚上启动
+    mutex_lock(&pulse_claim_lock);
+    for (i = 0; i < gpio_count; i++)
+    {
+        if (!(mask & BIT(i)))
+            continue;
+        if (pulse_train_busy(i))
+        {
+            atomic_long_inc(&pin_stats[i].busy);
+            ret = -EBUSY;
+            goto out;
+        }
+        descs[n] = gpio_to_desc(gpio_pins[i]);
+        if (!descs[n])
+        {
+            ret = -EINVAL;
+            goto out;
+        }
+        if (value & BIT(i))
+            __set_bit(n, values);
+        n++;
+    }
+    if (n == 0)
+        goto out;
+
+    for (i = 0; i < gpio_count; i++)
+    {
+        if (mask & BIT(i))
+            atomic_long_inc(&pin_stats[i].writes);
+    }
+    trace_avd_gpio_mask(mask, value);
+    gpio_dbg("GPIO mask 0x%03x -> 0x%03x\n", mask, value & mask);
+
+    // 与 gpio_set_value() 一样写原始电平；gpiolib 会把同一控制器的引脚合并为一次 set_multiple
+    ret = gpiod_set_raw_array_value_cansleep(n, descs, NULL, values);
+out:
+    mutex_unlock(&pulse_claim_lock);
+    return ret;
+}
+
+// 写单个引脚，引脚被脉冲串占用时返回 -EBUSY
+static int gpio_set_one(unsigned long idx, int value)
+{
+    mutex_lock(&pulse_claim_lock);
+    if (pulse_train_busy(idx))
+    {
+        mutex_unlock(&pulse_claim_lock);
+        atomic_long_inc(&pin_stats[idx].busy);
+        return -EBUSY;
+    }
+    gpio_set_value_cansleep(gpio_pins[idx], value);
+    mutex_unlock(&pulse_claim_lock);
+    atomic_long_inc(&pin_stats[idx].writes);
+    trace_avd_gpio_set(idx, gpio_pins[idx], value);
+    return 0;
+}
+
+// 写全部引脚：任一引脚被脉冲串占用则返回 -EBUSY，不写任何引脚
+static int gpio_set_all(int value)
+{
+    unsigned int i;
+
+    mutex_lock(&pulse_claim_lock);
+    for (i = 0; i < gpio_count; i++)
+    {
+        if (pulse_train_busy(i))
+        {
+            mutex_unlock(&pulse_claim_lock);
+            atomic_long_inc(&pin_stats[i].busy);
+            return -EBUSY;
+        }
+    }
+    for (i = 0; i < gpio_count; i++)
+    {
+        gpio_set_value_cansleep(gpio_pins[i], value);
+        atomic_long_inc(&pin_stats[i].writes);
+        trace_avd_gpio_set(i, gpio_pins[i], value);
+    }
+    mutex_unlock(&pulse_claim_lock);
+    return 0;
+}
+
+// debugfs: 每个引脚一行计数，以及当前脉冲串状态
+static int pin_stats_show(struct seq_file *s, void *unused)
+{
+    unsigned int i;
+
+    seq_puts(s, "idx gpio     writes      edges  trains  busy  running\n");
+    for (i = 0; i < gpio_count; i++)
+    {
+        seq_printf(s, "%3u %4d %10ld %10ld %7ld %5ld  %d\n", i, gpio_pins[i],
+                   atomic_long_read(&pin_stats[i].writes),
+                   atomic_long_read(&pin_stats[i].edges),
+                   atomic_long_read(&pin_stats[i].trains),
+                   atomic_long_read(&pin_stats[i].busy),
+                   READ_ONCE(pulse_trains[i].running));
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(pin_stats);
+
 static long GPIO_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
-    int i;
+    int ret;
+    struct gpio_pulse_train train;
+    struct gpio_pulse_status status;
+    struct gpio_pulse_profile profile;
+    struct gpio_mask mask;
 
     switch (cmd)
     {
@@ -105,11 +619,13 @@ static long GPIO_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         // 设置指定GPIO为高电平，arg为GPIO数组索引
         if (arg >= gpio_count)
         {
-            printk(KERN_WARNING "GPIO Driver: Invalid GPIO index: %lu,Max Number is %d\n", arg, gpio_count);
+            printk(KERN_WARNING "GPIO Driver: Invalid GPIO index: %lu,Max Number is %u\n", arg, gpio_count);
             return -EINVAL;
         }
-        gpio_set_value(gpio_pins[arg], 1);
-        printk(KERN_INFO "GPIO Driver: GPIO[%lu] ON (GPIO %d → HIGH)\n", arg, gpio_pins[arg]);
+        ret = gpio_set_one(arg, 1);
+        if (ret < 0)
+            return ret;
+        gpio_dbg("GPIO[%lu] ON (GPIO %d → HIGH)\n", arg, gpio_pins[arg]);
         break;
 
     case SET_GPIO_OFF:
@@ -119,26 +635,79 @@ static long GPIO_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
             printk(KERN_WARNING "GPIO Driver: Invalid GPIO index: %lu\n", arg);
             return -EINVAL;
         }
-        gpio_set_value(gpio_pins[arg], 0);
-        printk(KERN_INFO "GPIO Driver: GPIO[%lu] OFF (GPIO %d → LOW)\n", arg, gpio_pins[arg]);
+        ret = gpio_set_one(arg, 0);
+        if (ret < 0)
+            return ret;
+        gpio_dbg("GPIO[%lu] OFF (GPIO %d → LOW)\n", arg, gpio_pins[arg]);
         break;
 
     case SET_GPIO_ALL_ON:
-        // 设置所有GPIO为高电平
-        for (i = 0; i < gpio_count; i++)
-        {
-            gpio_set_value(gpio_pins[i], 1);
-        }
-        printk(KERN_INFO "GPIO Driver: All GPIOs set to HIGH\n");
+        // 设置所有GPIO为高电平，有引脚正在输出脉冲串时整体拒绝
+        ret = gpio_set_all(1);
+        if (ret < 0)
+            return ret;
+        gpio_dbg("All GPIOs set to HIGH\n");
         break;
 
     case SET_GPIO_ALL_OFF:
-        // 设置所有GPIO为低电平
-        for (i = 0; i < gpio_count; i++)
-        {
-            gpio_set_value(gpio_pins[i], 0);
-        }
-        printk(KERN_INFO "GPIO Driver: All GPIOs set to LOW\n");
+        // 设置所有GPIO为低电平，有引脚正在输出脉冲串时整体拒绝
+        ret = gpio_set_all(0);
+        if (ret < 0)
+            return ret;
+        gpio_dbg("All GPIOs set to LOW\n");
+        break;
+
+    case SET_GPIO_MASK:
+        // 按掩码批量设置引脚电平，一次调用修改多个轴的 EN/DIR/PUL
+        if (copy_from_user(&mask, (void __user *)arg, sizeof(mask)))
+            return -EFAULT;
+        ret = gpio_set_mask(mask.mask, mask.value);
+        if (ret < 0)
+            return ret;
+        break;
+
+    case GPIO_PULSE_START:
+        // 启动脉冲串：预置EN/DIR后由hrtimer输出edges个边沿
+        if (copy_from_user(&train, (void __user *)arg, sizeof(train)))
+            return -EFAULT;
+        profile.pul_idx = train.pul_idx;
+        profile.dir_idx = train.dir_idx;
+        profile.en_idx = train.en_idx;
+        profile.dir_value = train.dir_value;
+        profile.en_value = train.en_value;
+        profile.nseg = 1;
+        profile.seg[0].edges = train.edges;
+        profile.seg[0].period_ns = train.period_ns;
+        ret = pulse_train_start(&profile);
+        if (ret < 0)
+            return ret;
+        break;
+
+    case GPIO_PULSE_PROFILE:
+        // 启动分段脉冲串（加减速曲线）
+        if (copy_from_user(&profile, (void __user *)arg, sizeof(profile)))
+            return -EFAULT;
+        ret = pulse_train_start(&profile);
+        if (ret < 0)
+            return ret;
+        break;
+
+    case GPIO_PULSE_STOP:
+        // 停止指定引脚的脉冲串，arg为GPIO数组索引
+        if (arg >= gpio_count)
+            return -EINVAL;
+        pulse_train_stop(arg);
+        break;
+
+    case GPIO_PULSE_STATUS:
+        // 查询（或等待）脉冲串状态
+        if (copy_from_user(&status, (void __user *)arg, sizeof(status)))
+            return -EFAULT;
+        ret = pulse_train_status(&status);
+        if (ret < 0)
+            return ret;
+        if (copy_to_user((void __user *)arg, &status, sizeof(status)))
+            return -EFAULT;
         break;
 
     default:
@@ -168,6 +737,20 @@ static int __init mydevice_init(void)
 
     printk(KERN_INFO "GPIO Driver: Initializing driver...\n");
 
+    // 可睡眠 GPIO 的脉冲串各占一个工作项，允许多个轴同时输出
+    pulse_sleep_wq = alloc_workqueue("avd_gpio_pulse", WQ_UNBOUND | WQ_HIGHPRI, 0);
+    if (!pulse_sleep_wq)
+        return -ENOMEM;
+
+    // 初始化脉冲串发生器
+    for (i = 0; i < ARRAY_SIZE(pulse_trains); i++)
+    {
+        hrtimer_init(&pulse_trains[i].timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+        pulse_trains[i].timer.function = pulse_train_timer_fn;
+        INIT_WORK(&pulse_trains[i].work, pulse_train_work_fn);
+        spin_lock_init(&pulse_trains[i].lock);
+    }
+
     // 申请所有GPIO资源
     for (i = 0; i < gpio_count; i++)
     {
@@ -179,11 +762,8 @@ static int __init mydevice_init(void)
         {
             printk(KERN_ERR "GPIO Driver: Failed to request GPIO %d\n", gpio_pins[i]);
             // 失败时释放已申请的GPIO
-            while (--i >= 0)
-            {
-                gpio_free(gpio_pins[i]);
-            }
-            return -EBUSY;
+            ret = -EBUSY;
+            goto err_gpio;
         }
         printk(KERN_INFO "GPIO Driver: GPIO %d requested successfully\n", gpio_pins[i]);
     }
@@ -193,7 +773,7 @@ static int __init mydevice_init(void)
     if (ret < 0)
     {
         printk(KERN_ERR "GPIO Driver: Failed to allocate device number: %d\n", ret);
-        return ret;
+        goto err_gpio;
     }
     // // 修改后：完整的资源清理 添加的资源清理///////////////////////////////////////////
     // if (ret != 0)
@@ -214,7 +794,12 @@ static int __init mydevice_init(void)
     // 注册字符设备
     my_cdev.owner = THIS_MODULE;
     cdev_init(&my_cdev, &fops);
-    cdev_add(&my_cdev, dev_num, 1);
+    ret = cdev_add(&my_cdev, dev_num, 1);
+    if (ret < 0)
+    {
+        printk(KERN_ERR "GPIO Driver: Failed to add character device: %d\n", ret);
+        goto err_region;
+    }
 
     printk(KERN_INFO "GPIO Driver: Character device registered successfully\n");
 
@@ -223,7 +808,8 @@ static int __init mydevice_init(void)
     if (IS_ERR(my_GPIO))
     {
         pr_err("Failed to create class\n");
-        return PTR_ERR(my_GPIO);
+        ret = PTR_ERR(my_GPIO);
+        goto err_cdev;
     }
 
     // 创建设备节点
@@ -231,11 +817,16 @@ static int __init mydevice_init(void)
     if (IS_ERR(GPIO_Device))
     {
         pr_err("Failed to create device\n");
-        class_destroy(my_GPIO);
-        return PTR_ERR(GPIO_Device);
+        ret = PTR_ERR(GPIO_Device);
+        goto err_class;
     }
 
     printk(KERN_INFO "GPIO Driver: Device node '/dev/GPIO_Device' created successfully\n");
+
+    // debugfs 不可用时不影响驱动功能
+    gpio_debugfs_dir = debugfs_create_dir("avd_gpio", NULL);
+    debugfs_create_file("pins", 0444, gpio_debugfs_dir, NULL, &pin_stats_fops);
+
     printk(KERN_INFO "GPIO Driver: Driver initialization completed successfully!\n");
 
     // 打印成功开启的GPIO端口信息
@@ -249,6 +840,19 @@ static int __init mydevice_init(void)
     }
 
     return 0;
+
+    // 按申请的相反顺序释放
+err_class:
+    class_destroy(my_GPIO);
+err_cdev:
+    cdev_del(&my_cdev);
+err_region:
+    unregister_chrdev_region(dev_num, 1);
+err_gpio:
+    while (--i >= 0)
+        gpio_free(gpio_pins[i]);
+    destroy_workqueue(pulse_sleep_wq);
+    return ret;
 }
 
 /**
@@ -260,12 +864,16 @@ static void __exit mydevice_exit(void)
 
     printk(KERN_INFO "GPIO Driver: Starting driver cleanup...\n");
 
+    debugfs_remove_recursive(gpio_debugfs_dir);
+
     // 释放所有GPIO资源
     for (i = 0; i < gpio_count; i++)
     {
+        pulse_train_stop(i);
         gpio_free(gpio_pins[i]);
         printk(KERN_INFO "GPIO Driver: GPIO %d released\n", gpio_pins[i]);
     }
+    destroy_workqueue(pulse_sleep_wq);
 
     // 销毁设备节点
     device_destroy(my_GPIO, MKDEV(major, minor));
@@ -0,0 +1,114 @@
+/**
+ * @file Avd_gpio_trace.h
+ * @brief GPIO控制驱动的 tracepoint 定义
+ *
+ * 使用方法：
+ *   echo 1 > /sys/kernel/tracing/events/avd_gpio/enable
+ *   cat /sys/kernel/tracing/trace_pipe
+ * 未开启时每个 tracepoint 只是一个静态分支，几乎没有开销。
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM avd_gpio
+
+#if !defined(__AVD_GPIO_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __AVD_GPIO_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// 单个引脚电平写入（SET_GPIO_ON/OFF/ALL）
+TRACE_EVENT(avd_gpio_set,
+    TP_PROTO(unsigned int idx, int gpio, int value),
+    TP_ARGS(idx, gpio, value),
+    TP_STRUCT__entry(
+        __field(unsigned int, idx)
+        __field(int, gpio)
+        __field(int, value)
+    ),
+    TP_fast_assign(
+        __entry->idx = idx;
+        __entry->gpio = gpio;
+        __entry->value = value;
+    ),
+    TP_printk("idx=%u gpio=%d value=%d", __entry->idx, __entry->gpio, __entry->value)
+);
+
+// 按掩码批量写入（SET_GPIO_MASK）
+TRACE_EVENT(avd_gpio_mask,
+    TP_PROTO(u32 mask, u32 value),
+    TP_ARGS(mask, value),
+    TP_STRUCT__entry(
+        __field(u32, mask)
+        __field(u32, value)
+    ),
+    TP_fast_assign(
+        __entry->mask = mask;
+        __entry->value = value;
+    ),
+    TP_printk("mask=0x%03x value=0x%03x", __entry->mask, __entry->value)
+);
+
+// 脉冲串输出的一个边沿，late 为相对到期时间的延迟
+TRACE_EVENT(avd_gpio_edge,
+    TP_PROTO(unsigned int idx, int level, s64 late_ns),
+    TP_ARGS(idx, level, late_ns),
+    TP_STRUCT__entry(
+        __field(unsigned int, idx)
+        __field(int, level)
+        __field(s64, late_ns)
+    ),
+    TP_fast_assign(
+        __entry->idx = idx;
+        __entry->level = level;
+        __entry->late_ns = late_ns;
+    ),
+    TP_printk("idx=%u level=%d late=%lldns", __entry->idx, __entry->level, __entry->late_ns)
+);
+
+// 脉冲串启动
+TRACE_EVENT(avd_gpio_train_start,
+    TP_PROTO(unsigned int idx, u32 nseg, u32 edges, u32 first_period_ns),
+    TP_ARGS(idx, nseg, edges, first_period_ns),
+    TP_STRUCT__entry(
+        __field(unsigned int, idx)
+        __field(u32, nseg)
+        __field(u32, edges)
+        __field(u32, first_period_ns)
+    ),
+    TP_fast_assign(
+        __entry->idx = idx;
+        __entry->nseg = nseg;
+        __entry->edges = edges;
+        __entry->first_period_ns = first_period_ns;
+    ),
+    TP_printk("idx=%u nseg=%u edges=%u period=%uns",
+              __entry->idx, __entry->nseg, __entry->edges, __entry->first_period_ns)
+);
+
+// 脉冲串结束（输出完毕或被停止）
+TRACE_EVENT(avd_gpio_train_end,
+    TP_PROTO(unsigned int idx, u32 done, u32 remaining, u32 missed),
+    TP_ARGS(idx, done, remaining, missed),
+    TP_STRUCT__entry(
+        __field(unsigned int, idx)
+        __field(u32, done)
+        __field(u32, remaining)
+        __field(u32, missed)
+    ),
+    TP_fast_assign(
+        __entry->idx = idx;
+        __entry->done = done;
+        __entry->remaining = remaining;
+        __entry->missed = missed;
+    ),
+    TP_printk("idx=%u done=%u remaining=%u missed=%u",
+              __entry->idx, __entry->done, __entry->remaining, __entry->missed)
+);
+
+#endif /* __AVD_GPIO_TRACE_H */
+
+// 头文件位于模块目录，driver/makefile 中为本模块加了 -I$(src)
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE Avd_gpio_trace
+#include <trace/define_trace.h>
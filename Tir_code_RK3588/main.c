@@ -3,11 +3,15 @@
 #include <pthread.h>
 #include "motor.h"
 #include "task.h"
+#include "recipe.h"
+#include "pwm.h"
+#include "ph_detect.h"
 #include <unistd.h>
+#include <string.h>
 
 #define MAX_THREADS 16 
 
-int main()
+int main(int argc, char *argv[])
 {
     pthread_t threads[MAX_THREADS];
     int thread_ids[MAX_THREADS];
@@ -23,6 +27,57 @@ int main()
 
     setup_signal_handlers();
 
+    // --sim：不访问 /dev/GPIO_Device，GPIO写入只记录在内存中，用于离线验证运动曲线
+    // --recipe <文件>：工艺配方文件，默认 recipe.txt
+    // --pwm-root <目录>：PWM sysfs 根目录，默认 /sys/class/pwm（也可用环境变量 PWM_SYSFS_ROOT）
+    // --ph-image <文件>：离线对一帧图像做 pH 颜色分类并计时后退出，见 ph_detect.h
+    // --ph-threshold pH7:35,70,-25,25,25,90：重新标定一个类别的 LAB 阈值，可重复
+    // --ph-roi x,y,w,h：--ph-image 的色块提取区域，默认整帧（视觉代码.py 为 20,10,120,100）
+    const char *recipe_path = NULL;
+    const char *ph_image = NULL;
+    ph_rect_t ph_roi;
+    int use_roi = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--sim") == 0)
+        {
+            motor_gpio_use_sim();
+        }
+        else if (strcmp(argv[i], "--recipe") == 0 && i + 1 < argc)
+        {
+            recipe_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pwm-root") == 0 && i + 1 < argc)
+        {
+            pwm_set_root(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ph-image") == 0 && i + 1 < argc)
+        {
+            ph_image = argv[++i];
+        }
+        else if (strcmp(argv[i], "--ph-roi") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &ph_roi.x, &ph_roi.y, &ph_roi.w, &ph_roi.h) != 4 ||
+                ph_roi.w <= 0 || ph_roi.h <= 0)
+            {
+                printf("Invalid ROI %s, expected x,y,w,h\n", argv[i]);
+                return -1;
+            }
+            use_roi = 1;
+        }
+        else if (strcmp(argv[i], "--ph-threshold") == 0 && i + 1 < argc)
+        {
+            if (ph_set_threshold_text(argv[++i]) < 0)
+            {
+                printf("Invalid pH threshold %s, expected pH7:35,70,-25,25,25,90\n", argv[i]);
+                return -1;
+            }
+        }
+    }
+
+    if (ph_image)
+        return ph_image_run(ph_image, use_roi ? &ph_roi : NULL) < 0 ? -1 : 0;
+
     // 初始化电机
     printf("Initializing motor system...\n");
     if (motor_io_init() < 0)
@@ -36,6 +91,13 @@ int main()
     Set_Motor_Target(Motor_C, 0);
     Set_Motor_Target(Motor_D, 0);
 
+    if (recipe_init(recipe_path) <= 0)
+    {
+        printf("No usable process recipe\n");
+        motor_cleanup();
+        return -1;
+    }
+
     thread_count = create_all_tasks(threads, thread_ids);
     if (thread_count < 0)
     {
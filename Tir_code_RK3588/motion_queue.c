@@ -0,0 +1,92 @@
+#include <string.h>
+#include "motion_queue.h"
+
+/*
+ * @description : 生产者入队一条运动
+ * @return : 0 成功，-1 队列已满
+ */
+int motion_queue_push(motion_queue_t *q, float target, uint64_t now)
+{
+	uint32_t head, tail, depth;
+
+	pthread_mutex_lock(&q->producer_mutex);
+	tail = q->tail;
+	head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+	if (tail - head >= MOTION_QUEUE_DEPTH)
+	{
+		q->rejected++;
+		pthread_mutex_unlock(&q->producer_mutex);
+		return -1;
+	}
+
+	q->slot[tail & (MOTION_QUEUE_DEPTH - 1)].target = target;
+	q->slot[tail & (MOTION_QUEUE_DEPTH - 1)].enqueue_ns = now;
+	// 先写数据再发布 tail，消费者看到新 tail 时数据已完整
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+	q->enqueued++;
+	depth = tail + 1 - head;
+	if (depth > q->max_depth)
+		q->max_depth = depth;
+	pthread_mutex_unlock(&q->producer_mutex);
+	return 0;
+}
+
+/*
+ * @description : 消费者取出一条运动，并记录排队等待时间
+ * @return : 1 取到，0 队列为空
+ */
+int motion_queue_pop(motion_queue_t *q, motion_cmd_t *cmd, uint64_t now)
+{
+	uint32_t head = q->head;
+	uint64_t wait;
+
+	if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*cmd = q->slot[head & (MOTION_QUEUE_DEPTH - 1)];
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+	// 统计只由消费者写，原子写入只是为了打印线程读到完整的值
+	wait = now > cmd->enqueue_ns ? now - cmd->enqueue_ns : 0;
+	__atomic_add_fetch(&q->started, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&q->wait_sum_ns, wait, __ATOMIC_RELAXED);
+	if (wait > q->wait_max_ns)
+		__atomic_store_n(&q->wait_max_ns, wait, __ATOMIC_RELAXED);
+	return 1;
+}
+
+uint32_t motion_queue_depth(const motion_queue_t *q)
+{
+	return __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+}
+
+// 消费者丢弃所有排队运动（轴被中止时），返回丢弃条数
+uint32_t motion_queue_flush(motion_queue_t *q)
+{
+	uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+	uint32_t n = tail - q->head;
+
+	__atomic_store_n(&q->head, tail, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&q->flushed, n, __ATOMIC_RELAXED);
+	return n;
+}
+
+// 读取统计，消费者侧计数只做近似读取，用于打印
+void motion_queue_get_stats(motion_queue_t *q, motion_queue_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	pthread_mutex_lock(&q->producer_mutex);
+	stats->max_depth = q->max_depth;
+	stats->enqueued = q->enqueued;
+	stats->rejected = q->rejected;
+	pthread_mutex_unlock(&q->producer_mutex);
+
+	stats->depth = motion_queue_depth(q);
+	stats->started = __atomic_load_n(&q->started, __ATOMIC_RELAXED);
+	stats->flushed = __atomic_load_n(&q->flushed, __ATOMIC_RELAXED);
+	stats->underruns = __atomic_load_n(&q->underruns, __ATOMIC_RELAXED);
+	stats->wait_sum_ns = __atomic_load_n(&q->wait_sum_ns, __ATOMIC_RELAXED);
+	stats->wait_max_ns = __atomic_load_n(&q->wait_max_ns, __ATOMIC_RELAXED);
+}
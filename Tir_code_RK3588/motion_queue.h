@@ -0,0 +1,62 @@
+#ifndef __MOTION_QUEUE_H
+#define __MOTION_QUEUE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// 每个轴可以预先排队的运动条数，必须是2的幂
+#define MOTION_QUEUE_DEPTH 16
+
+// 一条排队的运动命令
+typedef struct
+{
+	float target;        // 目标圈数
+	uint64_t enqueue_ns; // 入队时间
+} motion_cmd_t;
+
+typedef struct
+{
+	uint32_t depth;      // 当前排队数
+	uint32_t max_depth;  // 历史最大排队数
+	uint64_t enqueued;   // 入队总数
+	uint64_t rejected;   // 队列满被拒绝的次数
+	uint64_t started;    // 已取出执行的条数
+	uint64_t flushed;    // 因中止被丢弃的条数
+	uint64_t underruns;  // 上一条排队运动结束时队列已空、轴空闲后才等到新命令的次数
+	uint64_t wait_sum_ns; // 入队到开始执行的等待时间总和
+	uint64_t wait_max_ns;
+} motion_queue_stats_t;
+
+/*
+ * 单生产者/单消费者环形队列，容量固定、预先分配。
+ * 消费者（步进线程）不加锁；多个低优先级生产者（控制台、串口、工艺流程）
+ * 之间用 producer_mutex 串行化，对消费者来说仍是单生产者。
+ */
+typedef struct
+{
+	motion_cmd_t slot[MOTION_QUEUE_DEPTH];
+	uint32_t head; // 下一个读取位置，只由消费者写
+	uint32_t tail; // 下一个写入位置，只由生产者写
+	pthread_mutex_t producer_mutex;
+
+	// 生产者侧统计（producer_mutex 保护）
+	uint32_t max_depth;
+	uint64_t enqueued;
+	uint64_t rejected;
+	// 消费者侧统计（只由步进线程写）
+	uint64_t started;
+	uint64_t flushed;
+	uint64_t underruns;
+	uint64_t wait_sum_ns;
+	uint64_t wait_max_ns;
+} motion_queue_t;
+
+#define MOTION_QUEUE_INIT {.producer_mutex = PTHREAD_MUTEX_INITIALIZER}
+
+int motion_queue_push(motion_queue_t *q, float target, uint64_t now);
+int motion_queue_pop(motion_queue_t *q, motion_cmd_t *cmd, uint64_t now);
+uint32_t motion_queue_depth(const motion_queue_t *q);
+uint32_t motion_queue_flush(motion_queue_t *q);
+void motion_queue_get_stats(motion_queue_t *q, motion_queue_stats_t *stats);
+
+#endif
@@ -1,10 +1,17 @@
+#define _GNU_SOURCE
 #include <unistd.h>
 #include "motor.h"
+#include "step_sched.h"
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
 
 motor motor_data_A;
 motor motor_data_B;
@@ -16,11 +23,74 @@ float Target_Circle_C = 0;
 float Target_Circle_D = 0;
 int gpio_fd = -1;
 
+// 引脚影子寄存器：最后一次写出的电平，-1 表示未知（启动时或写失败后）
+// 各线程通过 __atomic 内建函数访问；gpio_toggle() 和内核脉冲串共同维护 PUL 电平
+static int gpio_shadow[12] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+static gpio_write_stats_t gpio_stats;
+// 旧驱动不支持脉冲串命令时退回逐边沿翻转
+static int pulse_train_supported = 1;
+// 旧驱动不支持批量写时退回逐个引脚写
+static int gpio_mask_supported = 1;
+
+// 电机到位通知：任一电机 State 变为1时写入，process_task 阻塞等待它而不是轮询
+static int motor_done_fd = -1;
+
+// 仿真GPIO后端：不打开设备，只在内存中记录每个引脚的电平和边沿
+static int gpio_sim_mode = 0;
+static gpio_sim_pin_t gpio_sim_pins[12];
+static pthread_mutex_t gpio_sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int gpio_sim_write(gpio_index_t gpio_idx, int value)
+{
+	gpio_sim_pin_t *pin;
+
+	if (gpio_idx >= 12)
+		return -1;
+
+	pthread_mutex_lock(&gpio_sim_mutex);
+	pin = &gpio_sim_pins[gpio_idx];
+	if (pin->level != !!value)
+	{
+		uint64_t now = monotonic_ns();
+		if (pin->edges == 0)
+			pin->first_edge_ns = now;
+		pin->last_edge_ns = now;
+		pin->edges++;
+		pin->level = !!value;
+	}
+	pthread_mutex_unlock(&gpio_sim_mutex);
+	return 0;
+}
+
+void motor_gpio_use_sim(void)
+{
+	gpio_sim_mode = 1;
+}
+
+int motor_gpio_is_sim(void)
+{
+	return gpio_sim_mode;
+}
+
+void gpio_sim_get(gpio_index_t gpio_idx, gpio_sim_pin_t *pin)
+{
+	pthread_mutex_lock(&gpio_sim_mutex);
+	*pin = gpio_sim_pins[gpio_idx < 12 ? gpio_idx : 0];
+	pthread_mutex_unlock(&gpio_sim_mutex);
+}
+
 void delay_us(int us)
 {
 	struct timespec ts;
-	ts.tv_sec = 0;
-	ts.tv_nsec = us * 1000;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
 	nanosleep(&ts, NULL);
 }
 
@@ -31,6 +101,12 @@ void delay_ms(int ms)
 
 int motor_gpio_init(void)
 {
+	if (gpio_sim_mode)
+	{
+		printf("GPIO simulation backend enabled, %s not used\n", GPIO_DEVICE);
+		return 0;
+	}
+
 	gpio_fd = open(GPIO_DEVICE, O_RDWR);
 	if (gpio_fd < 0)
 	{
@@ -51,14 +127,19 @@ void motor_gpio_close(void)
 	}
 }
 
-int gpio_write(gpio_index_t gpio_idx, int value)
+// 不经过影子寄存器，直接写到设备（或仿真后端）
+static int gpio_write_raw(gpio_index_t gpio_idx, int value)
 {
+	if (gpio_sim_mode)
+		return gpio_sim_write(gpio_idx, value);
+
 	if (gpio_fd < 0)
 	{
 		printf("GPIO device not opened\n");
 		return -1;
 	}
 
+	__atomic_add_fetch(&gpio_stats.syscalls, 1, __ATOMIC_RELAXED);
 	if (value)
 	{
 		return ioctl(gpio_fd, SET_GPIO_ON, gpio_idx);
@@ -69,16 +150,342 @@ int gpio_write(gpio_index_t gpio_idx, int value)
 	}
 }
 
-// GPIO切换操作
+static int gpio_write_mask_raw(uint32_t mask, uint32_t values)
+{
+	gpio_mask_t req;
+	int i, ret = 0;
+
+	if (!gpio_sim_mode && gpio_fd >= 0 && gpio_mask_supported)
+	{
+		req.mask = mask;
+		req.value = values;
+		__atomic_add_fetch(&gpio_stats.syscalls, 1, __ATOMIC_RELAXED);
+		if (ioctl(gpio_fd, SET_GPIO_MASK, &req) == 0)
+			return 0;
+		if (errno != ENOTTY)
+			return -1;
+		printf("GPIO driver has no mask write support, writing pins one by one\n");
+		gpio_mask_supported = 0;
+	}
+
+	for (i = 0; i < 12; i++)
+	{
+		if ((mask & GPIO_BIT(i)) && gpio_write_raw((gpio_index_t)i, !!(values & GPIO_BIT(i))) < 0)
+			ret = -1;
+	}
+	return ret;
+}
+
+// 写失败后电平不确定，下次写入不能被跳过
+static void gpio_shadow_invalidate(uint32_t mask)
+{
+	int i;
+
+	for (i = 0; i < 12; i++)
+	{
+		if (mask & GPIO_BIT(i))
+			__atomic_store_n(&gpio_shadow[i], -1, __ATOMIC_RELEASE);
+	}
+}
+
+/*
+ * @description : 写一个引脚；电平与影子寄存器一致时不发起 ioctl
+ * @return : 0 成功（含被合并的写），<0 失败
+ */
+int gpio_write(gpio_index_t gpio_idx, int value)
+{
+	int ret;
+
+	if (gpio_idx >= 12)
+		return -1;
+
+	value = !!value;
+	if (__atomic_exchange_n(&gpio_shadow[gpio_idx], value, __ATOMIC_ACQ_REL) == value)
+	{
+		__atomic_add_fetch(&gpio_stats.suppressed, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	__atomic_add_fetch(&gpio_stats.issued, 1, __ATOMIC_RELAXED);
+	ret = gpio_write_raw(gpio_idx, value);
+	if (ret < 0)
+		gpio_shadow_invalidate(GPIO_BIT(gpio_idx));
+	return ret;
+}
+
+/*
+ * @description : 按掩码同时写多个引脚，bit i 对应 GPIO 索引 i
+ *                已经是目标电平的引脚从掩码中去掉，全部一致时不发起 ioctl
+ * @param - mask   : 需要修改的引脚
+ * @param - values : 对应引脚的电平
+ * @return : 0 成功，<0 失败
+ */
+int gpio_write_mask(uint32_t mask, uint32_t values)
+{
+	uint32_t pending = 0;
+	int i, ret;
+
+	for (i = 0; i < 12; i++)
+	{
+		int value = !!(values & GPIO_BIT(i));
+
+		if (!(mask & GPIO_BIT(i)))
+			continue;
+		if (__atomic_exchange_n(&gpio_shadow[i], value, __ATOMIC_ACQ_REL) == value)
+			__atomic_add_fetch(&gpio_stats.suppressed, 1, __ATOMIC_RELAXED);
+		else
+			pending |= GPIO_BIT(i);
+	}
+	if (pending == 0)
+		return 0;
+
+	__atomic_add_fetch(&gpio_stats.issued, __builtin_popcount(pending), __ATOMIC_RELAXED);
+	ret = gpio_write_mask_raw(pending, values);
+	if (ret < 0)
+		gpio_shadow_invalidate(pending);
+	return ret;
+}
+
+// 翻转影子寄存器中的电平，未知电平按低电平处理；返回翻转后的电平
+static int gpio_shadow_flip(gpio_index_t gpio_idx)
+{
+	int old = __atomic_load_n(&gpio_shadow[gpio_idx], __ATOMIC_ACQUIRE);
+
+	while (!__atomic_compare_exchange_n(&gpio_shadow[gpio_idx], &old, old == 1 ? 0 : 1,
+										0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		;
+	return old == 1 ? 0 : 1;
+}
+
+// 同时翻转多个PUL引脚，用于多轴插补时同一时刻的边沿
+int gpio_toggle_mask(uint32_t mask)
+{
+	uint32_t values = 0;
+	int i, ret;
+
+	mask &= GPIO_BIT(12) - 1;
+	if (mask == 0)
+		return 0;
+
+	for (i = 0; i < 12; i++)
+	{
+		if ((mask & GPIO_BIT(i)) && gpio_shadow_flip((gpio_index_t)i))
+			values |= GPIO_BIT(i);
+	}
+
+	__atomic_add_fetch(&gpio_stats.issued, __builtin_popcount(mask), __ATOMIC_RELAXED);
+	ret = gpio_write_mask_raw(mask, values);
+	if (ret < 0)
+		gpio_shadow_invalidate(mask);
+	return ret;
+}
+
+// GPIO切换操作：翻转总会改变电平，不经过合并判断
 int gpio_toggle(gpio_index_t gpio_idx)
 {
-	static int gpio_states[12] = {0};
+	int ret;
 
 	if (gpio_idx >= 12)
 		return -1;
 
-	gpio_states[gpio_idx] = !gpio_states[gpio_idx];
-	return gpio_write(gpio_idx, gpio_states[gpio_idx]);
+	__atomic_add_fetch(&gpio_stats.issued, 1, __ATOMIC_RELAXED);
+	ret = gpio_write_raw(gpio_idx, gpio_shadow_flip(gpio_idx));
+	if (ret < 0)
+		gpio_shadow_invalidate(GPIO_BIT(gpio_idx));
+	return ret;
+}
+
+void gpio_get_write_stats(gpio_write_stats_t *stats)
+{
+	stats->issued = __atomic_load_n(&gpio_stats.issued, __ATOMIC_RELAXED);
+	stats->suppressed = __atomic_load_n(&gpio_stats.suppressed, __ATOMIC_RELAXED);
+	stats->syscalls = __atomic_load_n(&gpio_stats.syscalls, __ATOMIC_RELAXED);
+}
+
+void Print_GPIO_Write_Stats(void)
+{
+	gpio_write_stats_t st;
+	uint64_t total;
+
+	gpio_get_write_stats(&st);
+	total = st.issued + st.suppressed;
+	printf("GPIO writes: issued=%llu suppressed=%llu (%.1f%%) syscalls=%llu\n",
+		   (unsigned long long)st.issued, (unsigned long long)st.suppressed,
+		   total ? 100.0 * st.suppressed / total : 0.0, (unsigned long long)st.syscalls);
+}
+
+// 驱动启动脉冲串前会自己写EN/DIR，同步到影子寄存器
+static void gpio_shadow_set_en_dir(const motor *motor_p)
+{
+	__atomic_store_n(&gpio_shadow[motor_p->EN_GPIO], motor_p->EN ? 1 : 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&gpio_shadow[motor_p->DIR_GPIO], motor_p->DIR ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+// 启动内核脉冲串：预置EN/DIR后由驱动输出edges个PUL边沿
+int gpio_pulse_train(motor *motor_p, uint32_t edges, uint32_t period_ns)
+{
+	gpio_pulse_train_t train;
+
+	if (gpio_fd < 0 || !pulse_train_supported)
+		return -1;
+
+	train.pul_idx = motor_p->PUL_GPIO;
+	train.dir_idx = motor_p->DIR_GPIO;
+	train.en_idx = motor_p->EN_GPIO;
+	train.dir_value = motor_p->DIR;
+	train.en_value = motor_p->EN;
+	train.edges = edges;
+	train.period_ns = period_ns;
+
+	if (ioctl(gpio_fd, GPIO_PULSE_START, &train) < 0)
+	{
+		if (errno == ENOTTY)
+		{
+			printf("GPIO driver has no pulse train support, falling back to toggling\n");
+			pulse_train_supported = 0;
+		}
+		else
+		{
+			printf("GPIO driver rejected pulse train on GPIO[%u] (%s), toggling in user space\n",
+				   motor_p->PUL_GPIO, strerror(errno));
+		}
+		return -1;
+	}
+	gpio_shadow_set_en_dir(motor_p);
+	return 0;
+}
+
+// 等待脉冲串结束，最多等待wait_ms毫秒；返回1表示仍在运行，0表示已结束
+int gpio_pulse_wait(gpio_index_t pul_idx, uint32_t wait_ms, uint32_t *done)
+{
+	gpio_pulse_status_t status;
+
+	status.pul_idx = pul_idx;
+	status.wait_ms = wait_ms;
+	if (ioctl(gpio_fd, GPIO_PULSE_STATUS, &status) < 0)
+		return -1;
+
+	if (done)
+		*done = status.done;
+	return status.running ? 1 : 0;
+}
+
+// 启动分段脉冲串，chunks由planner_to_chunks()生成
+int gpio_pulse_profile(motor *motor_p, const planner_chunk_t *chunks, int nseg)
+{
+	gpio_pulse_profile_t profile;
+
+	if (gpio_fd < 0 || !pulse_train_supported || nseg < 1 || nseg > GPIO_PULSE_MAX_SEGS)
+		return -1;
+
+	profile.pul_idx = motor_p->PUL_GPIO;
+	profile.dir_idx = motor_p->DIR_GPIO;
+	profile.en_idx = motor_p->EN_GPIO;
+	profile.dir_value = motor_p->DIR;
+	profile.en_value = motor_p->EN;
+	profile.nseg = nseg;
+	memcpy(profile.seg, chunks, nseg * sizeof(chunks[0]));
+
+	if (ioctl(gpio_fd, GPIO_PULSE_PROFILE, &profile) < 0)
+	{
+		if (errno == ENOTTY)
+		{
+			printf("GPIO driver has no pulse train support, falling back to toggling\n");
+			pulse_train_supported = 0;
+		}
+		else
+		{
+			printf("GPIO driver rejected pulse train on GPIO[%u] (%s), toggling in user space\n",
+				   motor_p->PUL_GPIO, strerror(errno));
+		}
+		return -1;
+	}
+	gpio_shadow_set_en_dir(motor_p);
+	return 0;
+}
+
+// 读取内核脉冲串的边沿延迟统计
+int gpio_pulse_timing(gpio_index_t pul_idx, motor_timing_t *timing)
+{
+	gpio_pulse_status_t status;
+
+	status.pul_idx = pul_idx;
+	status.wait_ms = 0;
+	if (ioctl(gpio_fd, GPIO_PULSE_STATUS, &status) < 0)
+		return -1;
+
+	timing->edges = status.done;
+	timing->late_sum_ns = (uint64_t)status.late_avg_ns * status.done;
+	timing->late_max_ns = status.late_max_ns;
+	timing->missed = status.missed;
+	memcpy(timing->hist, status.hist, sizeof(timing->hist));
+	return 0;
+}
+
+int gpio_pulse_stop(gpio_index_t pul_idx)
+{
+	return ioctl(gpio_fd, GPIO_PULSE_STOP, pul_idx);
+}
+
+// 把电机字段发布到快照，调用者必须持有 motor_p->mutex
+static void motor_publish_state(motor *motor_p)
+{
+	motor_state_t st;
+	int done;
+
+	st.EN = motor_p->EN;
+	st.DIR = motor_p->DIR;
+	st.Current_Step = motor_p->Current_Step;
+	st.Target_Step = motor_p->Target_Step;
+	st.Steps_Per_Circle = Motor_Steps_Per_Circle(motor_p);
+	st.State = motor_p->State;
+	st.Process_Flag = motor_p->Process_Flag;
+	st.Done_ns = motor_p->Snapshot.Done_ns;
+	done = st.State == 1 && motor_p->Snapshot.State != 1;
+	if (done)
+		st.Done_ns = monotonic_ns();
+	seqlock_publish(&motor_p->State_Seq, &motor_p->Snapshot, &st, sizeof(st));
+	if (done)
+		Motor_Done_Notify();
+}
+
+// 唤醒等待到位的线程；eventfd 写入不阻塞，步进线程也可以调用
+void Motor_Done_Notify(void)
+{
+	uint64_t one = 1;
+
+	if (motor_done_fd >= 0 && write(motor_done_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		perror("Motor_Done_Notify");
+}
+
+/*
+ * @description : 等待电机到位通知
+ * @param - timeout_ns : 最长等待时间
+ * @return : 1 收到通知，0 超时
+ */
+int Motor_Done_Wait(uint64_t timeout_ns)
+{
+	struct timespec ts = {.tv_sec = timeout_ns / 1000000000ull, .tv_nsec = timeout_ns % 1000000000ull};
+	struct pollfd pfd = {.fd = motor_done_fd, .events = POLLIN};
+	uint64_t count;
+
+	if (motor_done_fd < 0)
+	{
+		// eventfd 不可用时退回短周期轮询
+		if (timeout_ns > MOTOR_DONE_FALLBACK_NS)
+			ts = (struct timespec){.tv_sec = 0, .tv_nsec = MOTOR_DONE_FALLBACK_NS};
+		nanosleep(&ts, NULL);
+		return 0;
+	}
+	if (ppoll(&pfd, 1, &ts, NULL) <= 0)
+		return 0;
+	return read(motor_done_fd, &count, sizeof(count)) == sizeof(count);
+}
+
+// 读取电机状态快照，不加锁，不会阻塞步进线程
+void Motor_Get_State(const motor *motor_p, motor_state_t *state)
+{
+	seqlock_snapshot(&motor_p->State_Seq, state, &motor_p->Snapshot, sizeof(*state));
 }
 
 // 电机初始化
@@ -86,22 +493,34 @@ void Motor_Init(motor *motor_p, gpio_index_t en_gpio, gpio_index_t dir_gpio, gpi
 {
 	motor_p->EN = Disable;
 	motor_p->DIR = Forward;
-	motor_p->Current_Circle = 0;
-	motor_p->Target_Circle = 0;
+	motor_p->Current_Step = 0;
+	motor_p->Target_Step = 0;
+	motor_p->Steps_Per_Rev = PLUSE;
+	motor_p->Microstep = MICROSTEP;
 	motor_p->EN_GPIO = en_gpio;
 	motor_p->DIR_GPIO = dir_gpio;
 	motor_p->PUL_GPIO = pul_gpio;
+	motor_p->Limits.max_velocity = MOTOR_DEFAULT_VELOCITY;
+	motor_p->Limits.acceleration = MOTOR_DEFAULT_ACCEL;
+	motor_p->Limits.jerk = MOTOR_DEFAULT_JERK;
 	motor_p->State = 0;
 	motor_p->Process_Flag = 0;
 	motor_p->Pro_flag_printf_once = 0;
 
-	// 初始化互斥锁
-	pthread_mutex_init(&motor_p->mutex, NULL);
+	// 初始化互斥锁：步进线程与控制台等低优先级写者共用，开启优先级继承避免优先级反转
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&motor_p->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	memset(&motor_p->Timing, 0, sizeof(motor_p->Timing));
+	motor_p->Timing_Seq.seq = 0;
+	motor_p->State_Seq.seq = 0;
+	motor_publish_state(motor_p);
 
 	// 设置初始GPIO状态
-	gpio_write(motor_p->EN_GPIO, Disable);
-	gpio_write(motor_p->DIR_GPIO, Forward);
-	gpio_write(motor_p->PUL_GPIO, 0);
+	gpio_write_mask(GPIO_BIT(en_gpio) | GPIO_BIT(dir_gpio) | GPIO_BIT(pul_gpio),
+					(motor_p->EN ? GPIO_BIT(en_gpio) : 0) | (motor_p->DIR ? GPIO_BIT(dir_gpio) : 0));
 }
 
 // 电机IO初始化
@@ -114,11 +533,17 @@ int motor_io_init(void)
 		return -1;
 	}
 
+	motor_done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (motor_done_fd < 0)
+		perror("motor_io_init: eventfd");
+
 	// 初始化四个电机
 	Motor_Init(&motor_data_A, GPIO_IDX_A_EN, GPIO_IDX_A_DIR, GPIO_IDX_A_PUL);
 	Motor_Init(&motor_data_B, GPIO_IDX_B_EN, GPIO_IDX_B_DIR, GPIO_IDX_B_PUL);
 	Motor_Init(&motor_data_C, GPIO_IDX_C_EN, GPIO_IDX_C_DIR, GPIO_IDX_C_PUL);
 	Motor_Init(&motor_data_D, GPIO_IDX_D_EN, GPIO_IDX_D_DIR, GPIO_IDX_D_PUL);
+	// C轴行程最长（最多18圈），默认给更高的巡航速度
+	motor_data_C.Limits.max_velocity = MOTOR_C_DEFAULT_VELOCITY;
 
 	printf("Motor IO initialized successfully (A, B, C, D)\n");
 	return 0; // 返回成功
@@ -127,78 +552,98 @@ int motor_io_init(void)
 // 设置使能和方向
 void Set_EN_DIR(motor *motor_p)
 {
-	gpio_write(motor_p->EN_GPIO, motor_p->EN);
-	gpio_write(motor_p->DIR_GPIO, motor_p->DIR);
+	gpio_write_mask(GPIO_BIT(motor_p->EN_GPIO) | GPIO_BIT(motor_p->DIR_GPIO),
+					(motor_p->EN ? GPIO_BIT(motor_p->EN_GPIO) : 0) | (motor_p->DIR ? GPIO_BIT(motor_p->DIR_GPIO) : 0));
 }
 
-// 设置电机目标和方向
-void Set_MOTOR_Target_Circle_and_DIR(motor *motor_p, uint16_t target_circle, Control EN)
+/*
+ * @description : 准备一次运动：同步目标、方向和使能
+ *                由步进调度线程周期调用，替代原先每个电机线程里的 Motor_Run_Circle()
+ * @param - target_circle : 目标圈数
+ * @return : 本次需要输出的边沿数，0 表示无需运动（未置Process_Flag或已到达目标）
+ */
+int Motor_Prepare_Move(motor *motor_p, float target_circle, const char *name)
 {
+	Control en, dir;
+	int edges = 0;
+
 	pthread_mutex_lock(&motor_p->mutex);
 
-	motor_p->EN = EN;
-	motor_p->Target_Circle = target_circle;
+	en = motor_p->EN;
+	dir = motor_p->DIR;
+	motor_p->Target_Step = Motor_Circle_To_Step(motor_p, target_circle);
 
-	if (motor_p->Current_Circle == motor_p->Target_Circle)
+	if (motor_p->Current_Step == motor_p->Target_Step)
 	{
 		motor_p->EN = Disable;
 		motor_p->State = 1;
 	}
 	else
 	{
-		motor_p->DIR = (motor_p->Current_Circle < motor_p->Target_Circle) ? Forward : Backward;
+		motor_p->DIR = (motor_p->Current_Step < motor_p->Target_Step) ? Forward : Backward;
 		motor_p->EN = Enable;
 	}
 
-	pthread_mutex_unlock(&motor_p->mutex);
-}
-
-void Motor_Run_Circle(motor *motor_p, uint16_t target_circle, Control EN, const char *name)
-{
-	int i;
-	float RUN_Line = 0;
-
-	Set_MOTOR_Target_Circle_and_DIR(motor_p, target_circle, EN);
-	Set_EN_DIR(motor_p);
-
-	if (motor_p->DIR == Forward)
-		RUN_Line = motor_p->Target_Circle - motor_p->Current_Circle;
-	else if (motor_p->DIR == Backward)
-		RUN_Line = -(motor_p->Target_Circle - motor_p->Current_Circle);
-
 	if (motor_p->Process_Flag == 0 && motor_p->Pro_flag_printf_once == 0)
 	{
 		printf("Motor %s Process Flag is 0, please set it to 1 before running\r\n", name);
 		motor_p->Pro_flag_printf_once = 1;
-		return;
 	}
 	else if (motor_p->Process_Flag == 1 && motor_p->State == 0)
 	{
-		pthread_mutex_lock(&motor_p->mutex);
-
-		motor_p->State = 0;
-		int RUN_PLUSE = (int)(RUN_Line / 0.002f);
+		int32_t run_line = motor_p->Target_Step - motor_p->Current_Step;
 
-		for (i = 0; i < RUN_PLUSE; i++)
+		edges = run_line < 0 ? -run_line : run_line;
+		if (edges == 0)
 		{
-			gpio_toggle(motor_p->PUL_GPIO);
-			usleep(750);
-
-			if (motor_p->Process_Flag != 1)
-			{
-				motor_p->Current_Circle = motor_p->DIR == Forward ? motor_p->Current_Circle + (i * 0.002f) : motor_p->Current_Circle - (i * 0.002f);
-				pthread_mutex_unlock(&motor_p->mutex);
-				return;
-			}
+			// 已在目标位置（目标被改回当前位置），直接视为到达
+			motor_p->State = 1;
+			motor_p->Process_Flag = 0;
+			motor_p->Pro_flag_printf_once = 0;
 		}
+	}
 
-		motor_p->Current_Circle = motor_p->Target_Circle;
-		motor_p->State = 1;
+	motor_publish_state(motor_p);
+	pthread_mutex_unlock(&motor_p->mutex);
+
+	// 开始运动时总是刷新EN/DIR（其他线程可能只改了EN字段），空闲时只在变化时写
+	if (edges > 0 || en != motor_p->EN || dir != motor_p->DIR)
+		Set_EN_DIR(motor_p);
+	return edges;
+}
+
+/*
+ * @description : 结束一次运动
+ * @param - reached_step : 实际到达的位置（边沿数）
+ * @param - completed    : 1 表示完整走完，0 表示被中止
+ * @param - more_queued  : 1 表示运动队列中还有后续运动，保持执行状态直到队列取空
+ */
+void Motor_Finish_Move(motor *motor_p, int32_t reached_step, int completed, int more_queued)
+{
+	pthread_mutex_lock(&motor_p->mutex);
+
+	motor_p->Current_Step = reached_step;
+	if (completed && more_queued)
+	{
+		motor_p->State = 0;
+	}
+	else if (completed)
+	{
+		// 运动期间目标被改写时保持未完成，等待下一次Begin_Motor_flag
+		motor_p->State = motor_p->Target_Step == reached_step ? 1 : 0;
 		motor_p->Process_Flag = 0;
 		motor_p->Pro_flag_printf_once = 0;
-
-		pthread_mutex_unlock(&motor_p->mutex);
 	}
+
+	motor_publish_state(motor_p);
+	pthread_mutex_unlock(&motor_p->mutex);
+}
+
+// 内核脉冲串结束后同步PUL电平记录
+void gpio_pulse_account(gpio_index_t pul_idx, uint32_t done)
+{
+	if (pul_idx < 12 && (done & 1))
+		gpio_shadow_flip(pul_idx);
 }
 
 // 停止电机
@@ -208,7 +653,9 @@ void STOP_MOTOR(motor *motor_p)
 	motor_p->Process_Flag = 0;
 	motor_p->EN = Disable;
 	gpio_write(motor_p->EN_GPIO, Disable);
+	motor_publish_state(motor_p);
 	pthread_mutex_unlock(&motor_p->mutex);
+	step_sched_kick();
 }
 
 // 开始电机标志
@@ -217,17 +664,69 @@ void Begin_Motor_flag(motor *motor_p)
 	pthread_mutex_lock(&motor_p->mutex);
 	motor_p->Process_Flag = 1;
 	motor_p->State = 0;
+	motor_publish_state(motor_p);
 	pthread_mutex_unlock(&motor_p->mutex);
+	step_sched_kick();
 }
 
 // 打印电机状态
 void Print_Motor_IO_State(const char *name, motor *motor_p)
 {
-	pthread_mutex_lock(&motor_p->mutex);
-	printf("%s: EN=%d, DIR=%d, Current=%.1f, Target=%.1f, ProFlag=%d\r\n",
-		   name, motor_p->EN, motor_p->DIR,
-		   motor_p->Current_Circle, motor_p->Target_Circle, motor_p->Process_Flag);
-	pthread_mutex_unlock(&motor_p->mutex);
+	motor_state_t st;
+
+	Motor_Get_State(motor_p, &st);
+	printf("%s: EN=%d, DIR=%d, Current=%.3f (%d), Target=%.3f (%d), ProFlag=%d\r\n",
+		   name, st.EN, st.DIR,
+		   (double)st.Current_Step / st.Steps_Per_Circle, st.Current_Step,
+		   (double)st.Target_Step / st.Steps_Per_Circle, st.Target_Step, st.Process_Flag);
+}
+
+// 延迟直方图分桶上限（ns），最后一桶为其余
+static const uint32_t jitter_bounds_ns[JITTER_BUCKETS - 1] = {
+	1000, 5000, 10000, 20000, 50000, 100000, 500000};
+
+// 记录一个边沿的延迟（实际输出时间 - 截止时间）
+void motor_timing_record(motor_timing_t *timing, int64_t late_ns, int missed)
+{
+	int b;
+
+	if (late_ns < 0)
+		late_ns = 0;
+	timing->edges++;
+	timing->late_sum_ns += late_ns;
+	if (late_ns > timing->late_max_ns)
+		timing->late_max_ns = late_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)late_ns;
+	if (missed)
+		timing->missed++;
+	for (b = 0; b < JITTER_BUCKETS - 1 && (uint64_t)late_ns >= jitter_bounds_ns[b]; b++)
+		;
+	timing->hist[b]++;
+}
+
+// 把步进线程中的统计发布到电机状态；只有步进线程写，不需要互斥锁
+void Motor_Publish_Timing(motor *motor_p, const motor_timing_t *timing)
+{
+	seqlock_publish(&motor_p->Timing_Seq, &motor_p->Timing, timing, sizeof(*timing));
+}
+
+void Motor_Get_Timing(const motor *motor_p, motor_timing_t *timing)
+{
+	seqlock_snapshot(&motor_p->Timing_Seq, timing, &motor_p->Timing, sizeof(*timing));
+}
+
+// 打印最近一次运动的边沿时序统计
+void Print_Motor_Timing(const char *name, motor *motor_p)
+{
+	motor_timing_t t;
+	int b;
+
+	Motor_Get_Timing(motor_p, &t);
+
+	printf("%s timing: edges=%u late avg=%.1fus max=%.1fus missed=%u hist(<1,<5,<10,<20,<50,<100,<500,>=500us)=",
+		   name, t.edges, t.edges ? t.late_sum_ns / 1000.0 / t.edges : 0.0, t.late_max_ns / 1000.0, t.missed);
+	for (b = 0; b < JITTER_BUCKETS; b++)
+		printf(b ? ",%u" : "%u", t.hist[b]);
+	printf("\r\n");
 }
 
 // 设置电机目标
@@ -238,175 +737,138 @@ void Set_Motor_Target(int motor_index, float target_value)
 	case 0:
 		Target_Circle_A = (float)target_value;
 		pthread_mutex_lock(&motor_data_A.mutex);
-		motor_data_A.Target_Circle = (float)target_value;
+		motor_data_A.Target_Step = Motor_Circle_To_Step(&motor_data_A, target_value);
 		motor_data_A.State = 0;
+		motor_publish_state(&motor_data_A);
 		pthread_mutex_unlock(&motor_data_A.mutex);
 		printf("Motor A target set to: %.1f\r\n", target_value);
 		break;
 	case 1:
 		Target_Circle_B = (float)target_value;
 		pthread_mutex_lock(&motor_data_B.mutex);
-		motor_data_B.Target_Circle = (float)target_value;
+		motor_data_B.Target_Step = Motor_Circle_To_Step(&motor_data_B, target_value);
 		motor_data_B.State = 0;
+		motor_publish_state(&motor_data_B);
 		pthread_mutex_unlock(&motor_data_B.mutex);
 		printf("Motor B target set to: %.1f\r\n", target_value);
 		break;
 	case 2:
 		Target_Circle_C = (float)target_value;
 		pthread_mutex_lock(&motor_data_C.mutex);
-		motor_data_C.Target_Circle = (float)target_value;
+		motor_data_C.Target_Step = Motor_Circle_To_Step(&motor_data_C, target_value);
 		motor_data_C.State = 0;
+		motor_publish_state(&motor_data_C);
 		pthread_mutex_unlock(&motor_data_C.mutex);
 		printf("Motor C target set to: %.1f\r\n", target_value);
 		break;
 	case 3: // 新增电机D
 		Target_Circle_D = (float)target_value;
 		pthread_mutex_lock(&motor_data_D.mutex);
-		motor_data_D.Target_Circle = (float)target_value;
+		motor_data_D.Target_Step = Motor_Circle_To_Step(&motor_data_D, target_value);
 		motor_data_D.State = 0;
+		motor_publish_state(&motor_data_D);
 		pthread_mutex_unlock(&motor_data_D.mutex);
 		printf("Motor D target set to: %.1f\r\n", target_value);
 		break;
 	default:
 		printf("Invalid motor index: %d (valid range: 0-3)\r\n", motor_index);
-		break;
+		return;
 	}
+	step_sched_kick();
 }
-extern int set_pwm_duty_cycle(int duty_percent);
-void My_Motor_process(void)
+// 设置电机运动限制（圈/秒、圈/秒²、圈/秒³，jerk<=0 为梯形曲线）
+void Set_Motor_Limits(int motor_index, float velocity, float accel, float jerk)
 {
-	static int process_count = 0;
+	motor *motors[] = {&motor_data_A, &motor_data_B, &motor_data_C, &motor_data_D};
 
-	if (process_count == 0)
-	{
-		Set_Motor_Target(Motor_A, 5);
-		Set_Motor_Target(Motor_B, 0);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		printf("当前电机状态:\n");
-		printf("A: Current=%.1f, Target=%.1f\n", motor_data_A.Current_Circle, motor_data_A.Target_Circle);
-		printf("B: Current=%.1f, Target=%.1f\n", motor_data_B.Current_Circle, motor_data_B.Target_Circle);
-
-		process_count++;
-		printf("Process started, step 1 finished!\n"); // 第一步
-		return;
-	}
-	if (process_count == 1)
-	{
-		Set_Motor_Target(Motor_A, 10.5);
-		Set_Motor_Target(Motor_B, 0);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 2 finished!\n"); // 第二步
-		return;
-	}
-	if (process_count == 2)
-	{
-		Set_Motor_Target(Motor_A, 5);
-		Set_Motor_Target(Motor_B, 0);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 3 finished!\n"); // 第三步
-		return;
-	}
-	if (process_count == 3)
-	{
-		Set_Motor_Target(Motor_A, 5);
-		Set_Motor_Target(Motor_B, 2);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 4 finished!\n"); // 第四步
-		return;
-	}
-	if (process_count == 4)
-	{
-		Set_Motor_Target(Motor_A, 10.5);
-		Set_Motor_Target(Motor_B, 2);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		gpio_write(motor_data_D.EN_GPIO, Enable);
-		gpio_write(motor_data_D.PUL_GPIO, Enable);
-		set_pwm_duty_cycle(80);
-		printf("Process step 5 finished!\n"); // 第五步
-		return;
-	}
-	if (process_count == 5)
+	if (motor_index < 0 || motor_index > 3)
 	{
-		set_pwm_duty_cycle(0);
-		gpio_write(motor_data_D.EN_GPIO, Disable);
-		gpio_write(motor_data_D.PUL_GPIO, Disable);
-		Set_Motor_Target(Motor_A, 0);
-		Set_Motor_Target(Motor_B, 2);
-		Set_Motor_Target(Motor_C, 18);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 6 finished!\n"); // 第六步
-		return;
-	}
-	if (process_count == 6)
-	{
-		Set_Motor_Target(Motor_A, 5);
-		Set_Motor_Target(Motor_B, 1);
-		Set_Motor_Target(Motor_C, 0);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 7 finished!\n"); // 第7步  准备滴定
+		printf("Invalid motor index: %d (valid range: 0-3)\r\n", motor_index);
 		return;
 	}
-	if (process_count == 7)
+	if (velocity <= 0 || accel <= 0)
 	{
-		Set_Motor_Target(Motor_A, 10.5);
-		Set_Motor_Target(Motor_B, 1);
-		Set_Motor_Target(Motor_C, 0);
-		Set_Motor_Target(Motor_D, 0);
-		set_pwm_duty_cycle(80);
-		process_count++;
-		printf("Process step 8 finished!\n"); // 第8步   滴定
+		printf("Invalid limits: velocity and accel must be positive\r\n");
 		return;
 	}
-	if (process_count == 8)
+
+	pthread_mutex_lock(&motors[motor_index]->mutex);
+	motors[motor_index]->Limits.max_velocity = velocity;
+	motors[motor_index]->Limits.acceleration = accel;
+	motors[motor_index]->Limits.jerk = jerk;
+	pthread_mutex_unlock(&motors[motor_index]->mutex);
+	printf("Motor %c limits: v=%.2f a=%.2f j=%.2f\r\n", 'A' + motor_index, velocity, accel, jerk);
+}
+
+// 每圈对应的PUL边沿数：驱动器每收到一个完整脉冲（上升沿+下降沿）走一个细分步
+uint32_t Motor_Steps_Per_Circle(const motor *motor_p)
+{
+	return 2u * motor_p->Steps_Per_Rev * motor_p->Microstep;
+}
+
+// 圈数与边沿数互相换算，只在接口处使用，内部位置一律用整数边沿
+int32_t Motor_Circle_To_Step(const motor *motor_p, float circle)
+{
+	return (int32_t)lround((double)circle * Motor_Steps_Per_Circle(motor_p));
+}
+
+float Motor_Step_To_Circle(const motor *motor_p, int32_t step)
+{
+	return (float)((double)step / Motor_Steps_Per_Circle(motor_p));
+}
+
+/*
+ * @description : 设置电机的每圈步数和细分数，当前位置和目标按圈数保持不变
+ *                运动中修改会使正在执行的运动与新分辨率不一致，因此只允许在空闲时修改
+ */
+void Set_Motor_Resolution(int motor_index, int steps_per_rev, int microstep)
+{
+	motor *motors[] = {&motor_data_A, &motor_data_B, &motor_data_C, &motor_data_D};
+	motor *motor_p;
+	uint32_t old_spc;
+
+	if (motor_index < 0 || motor_index > 3)
 	{
-		Set_Motor_Target(Motor_A, 5);
-		Set_Motor_Target(Motor_B, 2);
-		Set_Motor_Target(Motor_C, 10);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		gpio_write(motor_data_D.EN_GPIO, Enable);
-		gpio_write(motor_data_D.PUL_GPIO, Enable);
-		set_pwm_duty_cycle(80);
-		printf("Process step 9 finished!\n"); // 第9步   预备水池清洗
+		printf("Invalid motor index: %d (valid range: 0-3)\r\n", motor_index);
 		return;
 	}
-	if (process_count == 9)
+	if (steps_per_rev <= 0 || steps_per_rev > UINT16_MAX || microstep <= 0 || microstep > 256)
 	{
-		usleep(2000000); // 等待2秒
-		gpio_write(motor_data_D.EN_GPIO, Disable);
-		gpio_write(motor_data_D.PUL_GPIO, Disable);
-		set_pwm_duty_cycle(80);
-		Set_Motor_Target(Motor_A, 10.5);
-		Set_Motor_Target(Motor_B, 2);
-		Set_Motor_Target(Motor_C, 10);
-		Set_Motor_Target(Motor_D, 0);
-		process_count++;
-		printf("Process step 10 finished!\n"); // 第10步   水池清洗
+		printf("Invalid resolution: steps_per_rev 1-65535, microstep 1-256\r\n");
 		return;
 	}
-	if (process_count == 10)
+
+	motor_p = motors[motor_index];
+	pthread_mutex_lock(&motor_p->mutex);
+	if (motor_p->Process_Flag == 1 && motor_p->State == 0)
 	{
-		Set_Motor_Target(Motor_A, 0);
-		Set_Motor_Target(Motor_B, 0);
-		Set_Motor_Target(Motor_C, 0);
-		Set_Motor_Target(Motor_D, 0);
-		set_pwm_duty_cycle(0);
-		process_count++;
-		printf("Process step 11 finished!\n"); // 第11步   复位
+		pthread_mutex_unlock(&motor_p->mutex);
+		printf("Motor %c is moving, resolution not changed\r\n", 'A' + motor_index);
 		return;
 	}
+	old_spc = Motor_Steps_Per_Circle(motor_p);
+	motor_p->Steps_Per_Rev = steps_per_rev;
+	motor_p->Microstep = microstep;
+	// 与 Motor_Circle_To_Step() 一样四舍五入
+	motor_p->Current_Step = (int32_t)lround((double)motor_p->Current_Step * Motor_Steps_Per_Circle(motor_p) / old_spc);
+	motor_p->Target_Step = (int32_t)lround((double)motor_p->Target_Step * Motor_Steps_Per_Circle(motor_p) / old_spc);
+	motor_publish_state(motor_p);
+	pthread_mutex_unlock(&motor_p->mutex);
+	printf("Motor %c resolution: %d steps/rev x %d microstep = %u edges/circle\r\n",
+		   'A' + motor_index, steps_per_rev, microstep, Motor_Steps_Per_Circle(motor_p));
 }
+
+/*
+ * @description : 泵开关，泵接在D轴驱动器的EN和PUL上，两根线一次写入
+ * @param - on : 1开 0关
+ */
+void Motor_Pump(int on)
+{
+	uint32_t mask = GPIO_BIT(motor_data_D.EN_GPIO) | GPIO_BIT(motor_data_D.PUL_GPIO);
+
+	gpio_write_mask(mask, on ? mask : 0);
+}
+
 // 清理资源
 void motor_cleanup(void)
 {
@@ -422,6 +884,11 @@ void motor_cleanup(void)
 		close(gpio_fd);
 		gpio_fd = -1;
 	}
+	if (motor_done_fd >= 0)
+	{
+		close(motor_done_fd);
+		motor_done_fd = -1;
+	}
 
 	printf("Motor system cleaned up\n");
 }
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <unistd.h>
+#include "planner.h"
+#include "seqlock.h"
 // GPIO设备文件路径
 #define GPIO_DEVICE "/dev/GPIO_Device"
 
@@ -13,6 +15,78 @@
 #define SET_GPIO_ON _IO(GPIO_IOC_MAGIC, 0)
 #define SET_GPIO_OFF _IO(GPIO_IOC_MAGIC, 1)
 
+// 内核脉冲串命令（与驱动中的定义保持一致）
+typedef struct
+{
+	uint32_t pul_idx;	// 脉冲引脚索引
+	uint32_t dir_idx;	// 方向引脚索引
+	uint32_t en_idx;	// 使能引脚索引
+	uint32_t dir_value; // 方向电平（启动前预先设置）
+	uint32_t en_value;	// 使能电平（启动前预先设置）
+	uint32_t edges;		// 需要输出的边沿数（每个边沿翻转一次电平）
+	uint32_t period_ns; // 相邻两个边沿的间隔
+} gpio_pulse_train_t;
+
+// 延迟直方图分桶数，上限见 motor.c 中的 jitter_bounds_ns
+#define JITTER_BUCKETS 8
+
+typedef struct
+{
+	uint32_t pul_idx;	// 查询的脉冲引脚索引
+	uint32_t wait_ms;	// >0 时阻塞等待脉冲串结束，最多等待 wait_ms 毫秒
+	uint32_t running;	// 返回：1 表示仍在输出
+	uint32_t done;		// 返回：已输出的边沿数
+	uint32_t remaining; // 返回：剩余边沿数
+	uint32_t late_max_ns;			// 返回：边沿相对截止时间的最大延迟
+	uint32_t late_avg_ns;			// 返回：平均延迟
+	uint32_t missed;				// 返回：延迟超过一个周期的边沿数
+	uint32_t hist[JITTER_BUCKETS]; // 返回：延迟直方图
+} gpio_pulse_status_t;
+
+// 分段脉冲串：每段边沿间隔恒定，用来近似加减速曲线
+#define GPIO_PULSE_MAX_SEGS 32
+// 驱动接受的最小边沿间隔（驱动中的 GPIO_PULSE_MIN_PERIOD_NS），更短的周期返回 EINVAL
+#define GPIO_PULSE_MIN_PERIOD_NS 5000
+
+typedef struct
+{
+	uint32_t pul_idx;
+	uint32_t dir_idx;
+	uint32_t en_idx;
+	uint32_t dir_value;
+	uint32_t en_value;
+	uint32_t nseg; // 有效分段数 1~GPIO_PULSE_MAX_SEGS
+	planner_chunk_t seg[GPIO_PULSE_MAX_SEGS];
+} gpio_pulse_profile_t;
+
+#define GPIO_PULSE_START _IOW(GPIO_IOC_MAGIC, 4, gpio_pulse_train_t)
+#define GPIO_PULSE_STOP _IO(GPIO_IOC_MAGIC, 5)
+#define GPIO_PULSE_STATUS _IOWR(GPIO_IOC_MAGIC, 6, gpio_pulse_status_t)
+#define GPIO_PULSE_PROFILE _IOW(GPIO_IOC_MAGIC, 7, gpio_pulse_profile_t)
+
+// 批量写：bit i 对应 GPIO 索引 i，只修改 mask 中置位的引脚
+typedef struct
+{
+	uint32_t mask;	// 需要修改的引脚
+	uint32_t value; // 对应引脚的电平
+} gpio_mask_t;
+
+#define SET_GPIO_MASK _IOW(GPIO_IOC_MAGIC, 8, gpio_mask_t)
+#define GPIO_BIT(idx) (1u << (idx))
+
+// gpio_write() 影子寄存器统计
+typedef struct
+{
+	uint64_t issued;	 // 实际写出的引脚次数
+	uint64_t suppressed; // 电平未变化而被跳过的次数
+	uint64_t syscalls;	 // 发起的 ioctl 次数
+} gpio_write_stats_t;
+
+// 规划失败时退回的固定边沿间隔
+#define PULSE_EDGE_INTERVAL_US 750
+// 到位通知 eventfd 不可用时的轮询周期
+#define MOTOR_DONE_FALLBACK_NS 10000000ull
+
 #define Motor_A 0
 #define Motor_B 1
 #define Motor_C 2
@@ -49,22 +123,69 @@ typedef enum
 	Disable = 0
 } Control;
 
+// 单次运动的边沿时序统计
+typedef struct
+{
+	uint32_t edges;				   // 统计的边沿数
+	uint64_t late_sum_ns;		   // 延迟总和
+	uint32_t late_max_ns;		   // 最大延迟
+	uint32_t missed;			   // 延迟超过一个边沿间隔的边沿数
+	uint32_t hist[JITTER_BUCKETS]; // 延迟直方图
+} motor_timing_t;
+
+// 对外发布的电机状态快照，读者用 Motor_Get_State() 获取，不需要加锁
+typedef struct
+{
+	Control EN;
+	Control DIR;
+	int32_t Current_Step;
+	int32_t Target_Step;
+	uint32_t Steps_Per_Circle; // 每圈PUL边沿数，见 Motor_Steps_Per_Circle()
+	uint8_t State;
+	uint8_t Process_Flag;
+	uint64_t Done_ns; // 最近一次 State 变为1的时间（monotonic_ns）
+} motor_state_t;
+
 typedef struct
 {
 	Control EN;
 	Control DIR;
-	float Current_Circle;
-	float Target_Circle;
+	int32_t Current_Step;		  // 当前位置（PUL边沿数）
+	int32_t Target_Step;		  // 目标位置（PUL边沿数）
+	uint16_t Steps_Per_Rev;		  // 每圈步数（细分前），一步是一个完整的PUL脉冲，即两个边沿
+	uint16_t Microstep;			  // 驱动器细分数
 	gpio_index_t EN_GPIO;
 	gpio_index_t DIR_GPIO;
 	gpio_index_t PUL_GPIO;
+	motion_limits_t Limits;		  // 速度/加速度/加加速度限制
+	motor_timing_t Timing;		  // 最近一次（或进行中）运动的时序统计，只由步进线程写
+	seqlock_t Timing_Seq;		  // 保护 Timing
+	motor_state_t Snapshot;		  // 持有 mutex 修改字段后发布的快照
+	seqlock_t State_Seq;		  // 保护 Snapshot
 	uint8_t State;				  // 0:未完成 1:完成
 	uint8_t Process_Flag;		  // 执行进程标志位
 	uint8_t Pro_flag_printf_once; // 新增：每个电机独有的打印标志
-	pthread_mutex_t mutex;		  // 线程互斥锁
+	pthread_mutex_t mutex;		  // 写者之间的互斥锁（优先级继承），读者不使用
 } motor;
 
-#define PLUSE 200
+// 每圈步数默认值。位置以PUL边沿计，原代码按每边沿0.002圈标定，即每圈500个边沿、250个脉冲
+#define PLUSE 250
+#define MICROSTEP 1
+
+// 默认运动限制（圈/秒、圈/秒²、圈/秒³），可用 Set_Motor_Limits() 或控制台 V: 命令调整
+#define MOTOR_DEFAULT_VELOCITY 4.0f
+#define MOTOR_C_DEFAULT_VELOCITY 8.0f
+#define MOTOR_DEFAULT_ACCEL 8.0f
+#define MOTOR_DEFAULT_JERK 80.0f
+
+// 仿真GPIO后端的单引脚记录
+typedef struct
+{
+	int level;
+	uint32_t edges;
+	uint64_t first_edge_ns;
+	uint64_t last_edge_ns;
+} gpio_sim_pin_t;
 
 extern motor motor_data_A;
 extern motor motor_data_B;
@@ -77,21 +198,47 @@ extern float Target_Circle_D; // 新增电机D目标
 extern int gpio_fd;			  // GPIO设备文件描述符
 
 // 函数声明
+void motor_gpio_use_sim(void);
+int motor_gpio_is_sim(void);
+void gpio_sim_get(gpio_index_t gpio_idx, gpio_sim_pin_t *pin);
 int motor_gpio_init(void);
 void motor_gpio_close(void);
 void Motor_Init(motor *motor_p, gpio_index_t en_gpio, gpio_index_t dir_gpio, gpio_index_t pul_gpio);
 void Set_EN_DIR(motor *motor_p);
-void Set_MOTOR_Target_Circle_and_DIR(motor *motor_p, uint16_t target_circle, Control EN);
-void Motor_Run_Circle(motor *motor_p, uint16_t target_circle, Control EN, const char *name);
+int Motor_Prepare_Move(motor *motor_p, float target_circle, const char *name);
+void Motor_Finish_Move(motor *motor_p, int32_t reached_step, int completed, int more_queued);
 int motor_io_init(void);
 void Print_Motor_IO_State(const char *name, motor *motor_p);
+void Print_Motor_Timing(const char *name, motor *motor_p);
+void motor_timing_record(motor_timing_t *timing, int64_t late_ns, int missed);
+void Motor_Publish_Timing(motor *motor_p, const motor_timing_t *timing);
+void Motor_Get_Timing(const motor *motor_p, motor_timing_t *timing);
+void Motor_Get_State(const motor *motor_p, motor_state_t *state);
 void Begin_Motor_flag(motor *motor_p);
 void STOP_MOTOR(motor *motor_p);
 void Set_Motor_Target(int motor_index, float target_value);
+void Set_Motor_Limits(int motor_index, float velocity, float accel, float jerk);
+void Set_Motor_Resolution(int motor_index, int steps_per_rev, int microstep);
+uint32_t Motor_Steps_Per_Circle(const motor *motor_p);
+int32_t Motor_Circle_To_Step(const motor *motor_p, float circle);
+float Motor_Step_To_Circle(const motor *motor_p, int32_t step);
 void motor_cleanup(void);
-void My_Motor_process(void);
+void Motor_Pump(int on);
+void Motor_Done_Notify(void);
+int Motor_Done_Wait(uint64_t timeout_ns);
 
 int gpio_toggle(gpio_index_t gpio_idx);
 int gpio_write(gpio_index_t gpio_idx, int value);
+int gpio_write_mask(uint32_t mask, uint32_t values);
+int gpio_toggle_mask(uint32_t mask);
+void gpio_get_write_stats(gpio_write_stats_t *stats);
+void Print_GPIO_Write_Stats(void);
+int gpio_pulse_train(motor *motor_p, uint32_t edges, uint32_t period_ns);
+int gpio_pulse_profile(motor *motor_p, const planner_chunk_t *chunks, int nseg);
+int gpio_pulse_wait(gpio_index_t pul_idx, uint32_t wait_ms, uint32_t *done);
+int gpio_pulse_timing(gpio_index_t pul_idx, motor_timing_t *timing);
+int gpio_pulse_stop(gpio_index_t pul_idx);
+void gpio_pulse_account(gpio_index_t pul_idx, uint32_t done);
+uint64_t monotonic_ns(void);
 
 #endif
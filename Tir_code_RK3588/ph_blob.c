@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ph_blob.h"
+
+/*
+ * 游程连通域标记
+ * 逐行扫描掩码图，每个像素只与左边的像素比较一次，掩码变化时按位打开或关闭各类别的游程；
+ * 游程关闭时与上一行同类别的游程比较（两行游程都按 x 递增，双指针推进），
+ * 相接的游程用并查集合并标号，统计量（像素数、坐标和、外接矩形）累加在根上。
+ * 只保留两行游程，内存访问按行顺序进行；一行结束时没有延续到本行的连通域已经封闭，
+ * 直接按阈值过滤后输出，标号回收给后面的行使用。
+ */
+
+static uint32_t label_find(ph_label_t *labels, uint32_t a)
+{
+    while (labels[a].parent != a)
+    {
+        labels[a].parent = labels[labels[a].parent].parent; // 路径减半
+        a = labels[a].parent;
+    }
+    return a;
+}
+
+// 合并两个连通域，序号小的作为根
+static uint32_t label_union(ph_label_t *labels, uint32_t a, uint32_t b)
+{
+    ph_label_t *ra, *rb;
+    uint32_t t;
+
+    a = label_find(labels, a);
+    b = label_find(labels, b);
+    if (a == b)
+        return a;
+    if (b < a)
+    {
+        t = a;
+        a = b;
+        b = t;
+    }
+    ra = &labels[a];
+    rb = &labels[b];
+    rb->parent = a;
+    ra->pixels += rb->pixels;
+    ra->sum_x += rb->sum_x;
+    ra->sum_y += rb->sum_y;
+    if (rb->x0 < ra->x0)
+        ra->x0 = rb->x0;
+    if (rb->y0 < ra->y0)
+        ra->y0 = rb->y0;
+    if (rb->x1 > ra->x1)
+        ra->x1 = rb->x1;
+    if (rb->y1 > ra->y1)
+        ra->y1 = rb->y1;
+    return a;
+}
+
+/*
+ * @description : 分配游程和标号缓冲区
+ * @param - max_width : 之后 ph_blob_find() 的最大图像宽度
+ * @return : 0 成功，-1 失败
+ */
+int ph_blob_init(ph_blob_ctx_t *ctx, int max_width)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    if (max_width <= 0 || max_width > INT16_MAX)
+        return -1;
+    ctx->max_width = max_width;
+    ctx->run_cap = max_width / 2 + 1;
+    ctx->rows[0] = malloc(sizeof(ph_run_t) * PH_CLASSES * ctx->run_cap);
+    ctx->rows[1] = malloc(sizeof(ph_run_t) * PH_CLASSES * ctx->run_cap);
+    ctx->label_cap = 2 * PH_CLASSES * ctx->run_cap;
+    ctx->labels = malloc(sizeof(ph_label_t) * ctx->label_cap);
+    ctx->active = malloc(sizeof(uint32_t) * ctx->label_cap);
+    ctx->free_ids = malloc(sizeof(uint32_t) * ctx->label_cap);
+    if (ctx->rows[0] == NULL || ctx->rows[1] == NULL || ctx->labels == NULL ||
+        ctx->active == NULL || ctx->free_ids == NULL)
+    {
+        ph_blob_free(ctx);
+        return -1;
+    }
+    return 0;
+}
+
+void ph_blob_free(ph_blob_ctx_t *ctx)
+{
+    free(ctx->rows[0]);
+    free(ctx->rows[1]);
+    free(ctx->labels);
+    free(ctx->active);
+    free(ctx->free_ids);
+    ctx->rows[0] = ctx->rows[1] = NULL;
+    ctx->labels = NULL;
+    ctx->active = ctx->free_ids = NULL;
+}
+
+// 当前行类别 k 的一个游程 [x0, x1) 结束
+static void run_close(ph_blob_ctx_t *ctx, int cur, int k, int x0, int x1, int y)
+{
+    const ph_run_t *prev = &ctx->rows[!cur][k * ctx->run_cap];
+    int nprev = ctx->count[!cur][k];
+    int p = ctx->scan[k];
+    uint32_t label = UINT32_MAX;
+    ph_label_t *root;
+    ph_run_t *run;
+    int q;
+
+    ctx->stats.runs++;
+
+    // 8 邻接：上一行游程 [a, b) 与 [x0, x1) 相接的条件是 b >= x0 且 a <= x1
+    while (p < nprev && prev[p].x1 < x0)
+        p++;
+    ctx->scan[k] = p;
+    for (q = p; q < nprev && prev[q].x0 <= x1; q++)
+    {
+        label = label == UINT32_MAX ? prev[q].label : label_union(ctx->labels, label, prev[q].label);
+    }
+
+    if (label == UINT32_MAX)
+    {
+        // 两行的游程数不超过 label_cap，总有空闲标号
+        label = ctx->nfree > 0 ? ctx->free_ids[--ctx->nfree] : ctx->next_id++;
+        ctx->active[ctx->nactive++] = label;
+        if (ctx->nactive > ctx->stats.peak_labels)
+            ctx->stats.peak_labels = ctx->nactive;
+        ctx->stats.labels++;
+        root = &ctx->labels[label];
+        memset(root, 0, sizeof(*root));
+        root->parent = label;
+        root->cls = k;
+        root->x0 = x0;
+        root->x1 = x1 - 1;
+        root->y0 = root->y1 = y;
+    }
+
+    run = &ctx->rows[cur][k * ctx->run_cap + ctx->count[cur][k]++];
+    run->x0 = x0;
+    run->x1 = x1;
+    run->label = label;
+
+    root = &ctx->labels[label_find(ctx->labels, label)];
+    root->pixels += x1 - x0;
+    root->sum_x += (uint64_t)(x0 + x1 - 1) * (x1 - x0) / 2;
+    root->sum_y += (uint64_t)y * (x1 - x0);
+    if (x0 < root->x0)
+        root->x0 = x0;
+    if (x1 - 1 > root->x1)
+        root->x1 = x1 - 1;
+    root->y1 = y;
+}
+
+static void blobs_merge(ph_blob_ctx_t *ctx);
+
+// 色块表中面积最小的一项，面积相同时取 pH 大的类别，与 ph_blob_best() 的选择相反
+static int blob_smallest(const ph_blob_ctx_t *ctx)
+{
+    int i, min = 0;
+
+    for (i = 1; i < ctx->nblobs; i++)
+    {
+        const ph_blob_t *a = &ctx->blobs[i], *m = &ctx->blobs[min];
+
+        if (ph_blob_area(a) < ph_blob_area(m) || (ph_blob_area(a) == ph_blob_area(m) && a->cls > m->cls))
+            min = i;
+    }
+    return min;
+}
+
+/*
+ * @description : 封闭的连通域按像素数和面积过滤后加入色块表
+ *                表满时先按 margin 合并；仍然满时去掉面积最小的一项（可能是新色块），
+ *                保证面积最大的色块不会因为在图像中靠后而被丢弃
+ */
+static void blob_emit(ph_blob_ctx_t *ctx, const ph_label_t *l)
+{
+    ph_blob_t *b;
+    int w = l->x1 - l->x0 + 1, h = l->y1 - l->y0 + 1;
+
+    if (l->pixels < PH_PIXEL_THRESHOLD || w * h < PH_MIN_BLOB_AREA)
+        return;
+    if (ctx->nblobs >= PH_BLOB_MAX)
+        blobs_merge(ctx);
+    if (ctx->nblobs >= PH_BLOB_MAX)
+    {
+        b = &ctx->blobs[blob_smallest(ctx)];
+        ctx->stats.dropped_blobs++;
+        if (w * h < ph_blob_area(b) || (w * h == ph_blob_area(b) && l->cls >= b->cls))
+            return;
+    }
+    else
+    {
+        b = &ctx->blobs[ctx->nblobs++];
+    }
+    b->cls = l->cls;
+    b->rect.x = l->x0;
+    b->rect.y = l->y0;
+    b->rect.w = l->x1 - l->x0 + 1;
+    b->rect.h = l->y1 - l->y0 + 1;
+    b->pixels = l->pixels;
+    b->cx = (float)l->sum_x / l->pixels;
+    b->cy = (float)l->sum_y / l->pixels;
+}
+
+/*
+ * @description : 第 y 行结束：本行游程的标号改为根，没有延续到本行的连通域输出，
+ *                不再被引用的标号（已封闭的根和被合并的子节点）回收
+ */
+static void row_end(ph_blob_ctx_t *ctx, int cur, int y)
+{
+    uint32_t i, n = 0;
+    int k, j;
+
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        ph_run_t *runs = &ctx->rows[cur][k * ctx->run_cap];
+
+        for (j = 0; j < ctx->count[cur][k]; j++)
+            runs[j].label = label_find(ctx->labels, runs[j].label);
+    }
+    for (i = 0; i < ctx->nactive; i++)
+    {
+        uint32_t id = ctx->active[i];
+        const ph_label_t *l = &ctx->labels[id];
+
+        if (l->parent == id && l->y1 == y)
+        {
+            ctx->active[n++] = id;
+            continue;
+        }
+        if (l->parent == id)
+            blob_emit(ctx, l);
+        ctx->free_ids[ctx->nfree++] = id;
+    }
+    ctx->nactive = n;
+}
+
+static int rect_near(const ph_rect_t *a, const ph_rect_t *b, int margin)
+{
+    return a->x - margin < b->x + b->w && b->x < a->x + a->w + margin &&
+           a->y - margin < b->y + b->h && b->y < a->y + a->h + margin;
+}
+
+// 同类别外接矩形相距不超过 PH_MERGE_MARGIN 的色块合并，直到没有可合并的
+static void blobs_merge(ph_blob_ctx_t *ctx)
+{
+    int i, j, merged;
+
+    do
+    {
+        merged = 0;
+        for (i = 0; i < ctx->nblobs; i++)
+        {
+            for (j = i + 1; j < ctx->nblobs; j++)
+            {
+                ph_blob_t *a = &ctx->blobs[i];
+                ph_blob_t *b = &ctx->blobs[j];
+                int x1, y1;
+
+                if (a->cls != b->cls || !rect_near(&a->rect, &b->rect, PH_MERGE_MARGIN))
+                    continue;
+                x1 = a->rect.x + a->rect.w > b->rect.x + b->rect.w ? a->rect.x + a->rect.w : b->rect.x + b->rect.w;
+                y1 = a->rect.y + a->rect.h > b->rect.y + b->rect.h ? a->rect.y + a->rect.h : b->rect.y + b->rect.h;
+                a->rect.x = a->rect.x < b->rect.x ? a->rect.x : b->rect.x;
+                a->rect.y = a->rect.y < b->rect.y ? a->rect.y : b->rect.y;
+                a->rect.w = x1 - a->rect.x;
+                a->rect.h = y1 - a->rect.y;
+                a->cx = (a->cx * a->pixels + b->cx * b->pixels) / (a->pixels + b->pixels);
+                a->cy = (a->cy * a->pixels + b->cy * b->pixels) / (a->pixels + b->pixels);
+                a->pixels += b->pixels;
+                ctx->blobs[j] = ctx->blobs[--ctx->nblobs];
+                ctx->stats.merged++;
+                merged = 1;
+                j--;
+            }
+        }
+    } while (merged);
+}
+
+/*
+ * @description : 在类别掩码图上提取全部类别的色块
+ * @param - mask : ph_classify() 的输出，width*height，按行存放
+ * @param - roi : 只处理该区域，NULL 为整帧；坐标超出图像时裁剪
+ * @return : 色块数，结果在 ctx->blobs；-1 表示宽度超过 ph_blob_init() 的 max_width
+ */
+int ph_blob_find(ph_blob_ctx_t *ctx, const uint16_t *mask, int width, int height, const ph_rect_t *roi)
+{
+    int x0 = 0, y0 = 0, x1 = width, y1 = height;
+    int cur = 0, x, y, k;
+
+    if (roi)
+    {
+        x0 = roi->x > 0 ? roi->x : 0;
+        y0 = roi->y > 0 ? roi->y : 0;
+        x1 = roi->x + roi->w < width ? roi->x + roi->w : width;
+        y1 = roi->y + roi->h < height ? roi->y + roi->h : height;
+    }
+    if (width > ctx->max_width)
+        return -1;
+
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    memset(ctx->count, 0, sizeof(ctx->count));
+    ctx->nactive = 0;
+    ctx->nfree = 0;
+    ctx->next_id = 0;
+    ctx->nblobs = 0;
+
+    for (y = y0; y < y1; y++)
+    {
+        const uint16_t *row = &mask[(long)y * width];
+        uint16_t prev = 0, diff;
+        int start[PH_CLASSES];
+
+        cur = !cur;
+        memset(ctx->count[cur], 0, sizeof(ctx->count[cur]));
+        memset(ctx->scan, 0, sizeof(ctx->scan));
+
+        for (x = x0; x <= x1; x++)
+        {
+            // 行尾之后按 0 处理，关闭所有游程
+            uint16_t m = x < x1 ? row[x] : 0;
+
+            diff = m ^ prev;
+            if (diff == 0)
+                continue;
+            while (diff)
+            {
+                k = __builtin_ctz(diff);
+                diff &= diff - 1;
+                if (m & (1u << k))
+                    start[k] = x;
+                else
+                    run_close(ctx, cur, k, start[k], x, y);
+            }
+            prev = m;
+        }
+        row_end(ctx, cur, y);
+    }
+    // 最后一行之后所有连通域都已封闭
+    row_end(ctx, cur, y1);
+    blobs_merge(ctx);
+    return ctx->nblobs;
+}
+
+int ph_blob_area(const ph_blob_t *blob)
+{
+    return blob->rect.w * blob->rect.h;
+}
+
+/*
+ * @description : 面积最大的色块，与 detect_ph_value() 的选择相同，面积相同时取 pH 小的类别
+ * @return : NULL 表示没有色块
+ */
+const ph_blob_t *ph_blob_best(const ph_blob_ctx_t *ctx)
+{
+    const ph_blob_t *best = NULL;
+    int i;
+
+    for (i = 0; i < ctx->nblobs; i++)
+    {
+        const ph_blob_t *b = &ctx->blobs[i];
+
+        if (best == NULL || ph_blob_area(b) > ph_blob_area(best) ||
+            (ph_blob_area(b) == ph_blob_area(best) && b->cls < best->cls))
+            best = b;
+    }
+    return best;
+}
@@ -0,0 +1,79 @@
+#ifndef __PH_BLOB_H
+#define __PH_BLOB_H
+
+#include <stdint.h>
+#include "ph_detect.h"
+
+/*
+ * pH 色块提取，对应 视觉代码.py 中每个类别一次的
+ * find_blobs(pixels_threshold=PIXEL_THRESHOLD, area_threshold=MIN_BLOB_AREA, merge=True, margin=MERGE_MARGIN)：
+ * 在 ph_classify() 输出的位掩码图上逐行提取游程，一遍扫描同时完成全部类别的连通域标记（8 邻接），
+ * 面积指外接矩形面积（与 blob.area() 相同），像素数和面积都达到阈值的色块再按 margin 合并。
+ * 每行结束时已封闭的连通域立即输出并回收标号，标号数只取决于两行的游程数。
+ */
+#define PH_MIN_BLOB_AREA 50     // MIN_BLOB_AREA：外接矩形面积下限
+#define PH_PIXEL_THRESHOLD 15   // PIXEL_THRESHOLD：像素数下限
+#define PH_MERGE_MARGIN 1       // MERGE_MARGIN：外接矩形相距不超过该值的同类色块合并
+#define PH_BLOB_MAX 64          // 每帧输出的色块上限，超出时保留面积大的
+
+typedef struct
+{
+    uint8_t cls;     // 类别序号，见 ph_class_get()
+    ph_rect_t rect;  // 外接矩形，整帧坐标
+    uint32_t pixels;
+    float cx, cy;    // 像素质心
+} ph_blob_t;
+
+// 一行中一个类别的游程 [x0, x1)
+typedef struct
+{
+    int16_t x0, x1;
+    uint32_t label;
+} ph_run_t;
+
+// 连通域，统计量只在并查集的根上有效
+typedef struct
+{
+    uint32_t parent;
+    uint8_t cls;
+    uint32_t pixels;
+    uint64_t sum_x, sum_y;
+    int16_t x0, y0, x1, y1; // 外接矩形，x1/y1 含
+} ph_label_t;
+
+typedef struct
+{
+    uint32_t runs;
+    uint32_t labels;        // 连通域数（合并前）
+    uint32_t peak_labels;   // 同时使用的标号数最大值
+    uint32_t merged;        // 按 margin 合并的色块
+    uint32_t dropped_blobs; // 合并后仍超出 PH_BLOB_MAX、因面积最小被丢弃的色块
+} ph_blob_stats_t;
+
+// 缓冲区在 ph_blob_init() 中按最大宽度一次分配，每帧不再分配
+typedef struct
+{
+    int max_width;
+    int run_cap;                   // 每个类别每行最多游程数
+    ph_run_t *rows[2];             // 上一行和当前行，按 [类别][run_cap] 排列
+    uint16_t count[2][PH_CLASSES];
+    uint16_t scan[PH_CLASSES];     // 上一行中下一个可能相接的游程
+    ph_label_t *labels;
+    uint32_t label_cap;            // 两行游程数之和，标号不会用完
+    uint32_t *active;              // 正在使用的标号
+    uint32_t nactive;
+    uint32_t *free_ids;            // 回收的标号
+    uint32_t nfree;
+    uint32_t next_id;              // 从未使用过的标号
+    ph_blob_t blobs[PH_BLOB_MAX];
+    int nblobs;
+    ph_blob_stats_t stats;
+} ph_blob_ctx_t;
+
+int ph_blob_init(ph_blob_ctx_t *ctx, int max_width);
+void ph_blob_free(ph_blob_ctx_t *ctx);
+int ph_blob_find(ph_blob_ctx_t *ctx, const uint16_t *mask, int width, int height, const ph_rect_t *roi);
+const ph_blob_t *ph_blob_best(const ph_blob_ctx_t *ctx);
+int ph_blob_area(const ph_blob_t *blob);
+
+#endif
@@ -0,0 +1,745 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "motor.h"
+#include "ph_detect.h"
+#include "ph_blob.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * pH 颜色分类
+ * 视觉代码.py 对每个类别调用一次 find_blobs，每帧把整幅图换算比较 14 遍；
+ * 这里每个像素只换算一次 LAB，在寄存器中与全部类别比较，输出位掩码。
+ * RK3588 上用 NEON 每次处理 8 个像素，其他平台（x86 调试）用标量实现，
+ * 两者运算顺序相同，结果应逐像素一致，--ph-image 会报告不一致的像素数。
+ * 输入只有 65536 种像素值，启动时把每个值的分类结果做成查找表，
+ * 之后每个像素只需一次查表；同时缓存每个值的 LAB，重新标定阈值时只重算该类别的一位。
+ */
+
+// 可由 ph_set_threshold() 重新标定
+static ph_class_t ph_classes[PH_CLASSES] = {
+    // 强酸性(pH1-3)：红色/橙色
+    {"pH1", "红", 25, 100, 25, 127, 10, 90},
+    {"pH2", "深红", 30, 95, 20, 120, 15, 100},
+    {"pH3", "橙红", 35, 90, 10, 110, 25, 110},
+    // 弱酸性(pH4-6)：橙黄到黄绿
+    {"pH4", "橙黄", 40, 85, 0, 100, 40, 120},
+    {"pH5", "黄", 45, 80, -10, 90, 50, 127}, // 脚本中 B 上限为130，超出 LAB 范围，等同127
+    {"pH6", "黄绿", 40, 75, -15, 40, 35, 110},
+    // 中性(pH7)
+    {"pH7", "绿", 35, 70, -25, 25, 25, 90},
+    // 弱碱性(pH8-10)：青到蓝
+    {"pH8", "青", 30, 65, -35, 15, 0, 80},
+    {"pH9", "蓝青", 25, 60, -45, 5, -15, 70},
+    {"pH10", "蓝", 20, 55, -55, -5, -25, 60},
+    // 强碱性(pH11-14)：紫
+    {"pH11", "紫蓝", 15, 50, -65, -15, -35, 50},
+    {"pH12", "紫", 10, 45, -75, -25, -45, 40},
+    {"pH13", "深紫", 5, 40, -85, -35, -55, 30},
+    {"pH14", "紫红", 0, 35, -95, -45, -65, 20},
+};
+
+/*
+ * RGB565 各通道的 sRGB 线性值，Q16（65535 = 1.0）
+ * 5/6 位先按 OpenMV 的方式扩展到 8 位：r8 = (r5 * 527 + 23) >> 6，g8 = (g6 * 259 + 33) >> 6
+ */
+static const uint16_t lin5[32] = {
+    0, 159, 340, 637, 997, 1453, 2013, 2773, 3570, 4488, 5530, 6700, 8177, 9635, 11235, 12980,
+    15122, 17187, 19407, 21787, 24658, 27386, 30282, 33350, 36591, 40449, 44069, 47871, 51858, 56567, 60955, 65535,
+};
+
+static const uint16_t lin6[64] = {
+    0, 80, 159, 241, 340, 458, 599, 761, 947, 1156, 1391, 1720, 2013, 2333, 2681, 3058,
+    3464, 3900, 4366, 4864, 5392, 5953, 6547, 7174, 7834, 8528, 9258, 10022, 10822, 11658, 12530, 13440,
+    14629, 15623, 16656, 17727, 18837, 19987, 21177, 22407, 23678, 24990, 26344, 27739, 29176, 30656, 32179, 33745,
+    35355, 37008, 38706, 40449, 42236, 44534, 46423, 48359, 50341, 52369, 54445, 56567, 58737, 60955, 63221, 65535,
+};
+
+// 线性 RGB（Q16）到 XYZ，已除以 D65 白点
+#define XR (0.4124f / 0.95047f / 65535.0f)
+#define XG (0.3576f / 0.95047f / 65535.0f)
+#define XB (0.1805f / 0.95047f / 65535.0f)
+#define YR (0.2126f / 65535.0f)
+#define YG (0.7152f / 65535.0f)
+#define YB (0.0722f / 65535.0f)
+#define ZR (0.0193f / 1.08883f / 65535.0f)
+#define ZG (0.1192f / 1.08883f / 65535.0f)
+#define ZB (0.9505f / 1.08883f / 65535.0f)
+
+#define LAB_EPSILON 0.008856f
+#define LAB_KAPPA 7.787037f
+#define LAB_OFFSET (16.0f / 116.0f)
+#define CBRT_MAGIC 0x2a508935u // 立方根初值：浮点位模式除以3加常数
+
+// 查找表和 LAB 缓存，每个 RGB565 值一项；重新标定只由一个线程进行
+static uint16_t lut[PH_LUT_SIZE];
+static int8_t lab_l[PH_LUT_SIZE], lab_a[PH_LUT_SIZE], lab_b[PH_LUT_SIZE];
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+static ph_lut_stats_t lut_stats;
+
+const ph_class_t *ph_class_get(int k)
+{
+    return k >= 0 && k < PH_CLASSES ? &ph_classes[k] : NULL;
+}
+
+// 立方根，t 在 (0.008856, 1.1)：位模式初值误差 <4%，三次牛顿迭代
+static inline float lab_cbrtf(float t)
+{
+    union
+    {
+        float f;
+        uint32_t i;
+    } u = {.f = t};
+    float y;
+    int k;
+
+    u.i = u.i / 3 + CBRT_MAGIC;
+    y = u.f;
+    for (k = 0; k < 3; k++)
+        y = (y + y + t / (y * y)) * (1.0f / 3.0f);
+    return y;
+}
+
+static inline float lab_f(float t)
+{
+    return t > LAB_EPSILON ? lab_cbrtf(t) : t * LAB_KAPPA + LAB_OFFSET;
+}
+
+/*
+ * @description : 单个 RGB565 像素换算为 LAB（标量参考实现）
+ */
+void ph_rgb565_to_lab(uint16_t pixel, ph_lab_t *lab)
+{
+    float r = lin5[pixel >> 11];
+    float g = lin6[(pixel >> 5) & 0x3F];
+    float b = lin5[pixel & 0x1F];
+    float x = lab_f(r * XR + g * XG + b * XB);
+    float y = lab_f(r * YR + g * YG + b * YB);
+    float z = lab_f(r * ZR + g * ZG + b * ZB);
+
+    lab->l = (int)floorf(116.0f * y) - 16;
+    lab->a = (int)floorf(500.0f * (x - y));
+    lab->b = (int)floorf(200.0f * (y - z));
+}
+
+// LAB 与全部类别比较，返回位掩码
+uint16_t ph_lab_classify(const ph_lab_t *lab)
+{
+    uint16_t mask = 0;
+    int k;
+
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        const ph_class_t *c = &ph_classes[k];
+
+        if (lab->l >= c->l_min && lab->l <= c->l_max &&
+            lab->a >= c->a_min && lab->a <= c->a_max &&
+            lab->b >= c->b_min && lab->b <= c->b_max)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+static void lab_convert_scalar(const uint16_t *pixels, int n, int8_t *l, int8_t *a, int8_t *b)
+{
+    ph_lab_t lab;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        ph_rgb565_to_lab(pixels[i], &lab);
+        l[i] = lab.l;
+        a[i] = lab.a;
+        b[i] = lab.b;
+    }
+}
+
+static void classify_scalar(const uint16_t *pixels, int n, uint16_t *mask)
+{
+    ph_lab_t lab;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        ph_rgb565_to_lab(pixels[i], &lab);
+        mask[i] = ph_lab_classify(&lab);
+    }
+}
+
+#ifdef __ARM_NEON
+// Q16 线性值表拆成低/高字节，用 TBL 指令按通道值查表
+typedef struct
+{
+    uint8x16x2_t lin5_lo, lin5_hi;
+    uint8x16x4_t lin6_lo, lin6_hi;
+} lin_tables_t;
+
+static void lin_tables_load(lin_tables_t *t)
+{
+    uint8x16x2_t v;
+    int k;
+
+    // 小端下 uint16 表按字节交错存放，LD2 直接分出低字节和高字节
+    for (k = 0; k < 2; k++)
+    {
+        v = vld2q_u8((const uint8_t *)&lin5[16 * k]);
+        t->lin5_lo.val[k] = v.val[0];
+        t->lin5_hi.val[k] = v.val[1];
+    }
+    for (k = 0; k < 4; k++)
+    {
+        v = vld2q_u8((const uint8_t *)&lin6[16 * k]);
+        t->lin6_lo.val[k] = v.val[0];
+        t->lin6_hi.val[k] = v.val[1];
+    }
+}
+
+static inline float32x4_t lab_f_neon(float32x4_t t)
+{
+    const uint32x2_t inv3 = vdup_n_u32(0xAAAAAAABu);
+    const float32x4_t third = vdupq_n_f32(1.0f / 3.0f);
+    uint32x4_t i = vreinterpretq_u32_f32(t);
+    uint32x4_t q;
+    float32x4_t y, lin;
+    int k;
+
+    // i / 3 = (i * 0xAAAAAAAB) >> 33，与标量的整数除法结果相同
+    q = vcombine_u32(vshrn_n_u64(vmull_u32(vget_low_u32(i), inv3), 32),
+                     vshrn_n_u64(vmull_u32(vget_high_u32(i), inv3), 32));
+    q = vshrq_n_u32(q, 1);
+    y = vreinterpretq_f32_u32(vaddq_u32(q, vdupq_n_u32(CBRT_MAGIC)));
+    for (k = 0; k < 3; k++)
+        y = vmulq_f32(vaddq_f32(vaddq_f32(y, y), vdivq_f32(t, vmulq_f32(y, y))), third);
+
+    lin = vaddq_f32(vmulq_f32(t, vdupq_n_f32(LAB_KAPPA)), vdupq_n_f32(LAB_OFFSET));
+    return vbslq_f32(vcgtq_f32(t, vdupq_n_f32(LAB_EPSILON)), y, lin);
+}
+
+static inline float32x4_t mix3(float32x4_t r, float32x4_t g, float32x4_t b, float cr, float cg, float cb)
+{
+    return vaddq_f32(vaddq_f32(vmulq_f32(r, vdupq_n_f32(cr)), vmulq_f32(g, vdupq_n_f32(cg))),
+                     vmulq_f32(b, vdupq_n_f32(cb)));
+}
+
+static inline int32x4_t floor_s32(float32x4_t v)
+{
+    return vcvtq_s32_f32(vrndmq_f32(v));
+}
+
+// 4 个像素的线性 RGB 换算为 LAB
+static inline void lab4_neon(uint16x4_t r16, uint16x4_t g16, uint16x4_t b16,
+                             int32x4_t *l, int32x4_t *a, int32x4_t *b)
+{
+    float32x4_t r = vcvtq_f32_u32(vmovl_u16(r16));
+    float32x4_t g = vcvtq_f32_u32(vmovl_u16(g16));
+    float32x4_t bl = vcvtq_f32_u32(vmovl_u16(b16));
+    float32x4_t fx = lab_f_neon(mix3(r, g, bl, XR, XG, XB));
+    float32x4_t fy = lab_f_neon(mix3(r, g, bl, YR, YG, YB));
+    float32x4_t fz = lab_f_neon(mix3(r, g, bl, ZR, ZG, ZB));
+
+    *l = vsubq_s32(floor_s32(vmulq_f32(fy, vdupq_n_f32(116.0f))), vdupq_n_s32(16));
+    *a = floor_s32(vmulq_f32(vsubq_f32(fx, fy), vdupq_n_f32(500.0f)));
+    *b = floor_s32(vmulq_f32(vsubq_f32(fy, fz), vdupq_n_f32(200.0f)));
+}
+
+// 8 个像素换算为 LAB，每个分量 8 个 int16
+static inline void lab8_neon(const lin_tables_t *t, uint16x8_t px, int16x8_t *l, int16x8_t *a, int16x8_t *b)
+{
+    uint8x8_t ri = vmovn_u16(vshrq_n_u16(px, 11));
+    uint8x8_t gi = vmovn_u16(vandq_u16(vshrq_n_u16(px, 5), vdupq_n_u16(0x3F)));
+    uint8x8_t bi = vmovn_u16(vandq_u16(px, vdupq_n_u16(0x1F)));
+    uint16x8_t r = vorrq_u16(vmovl_u8(vqtbl2_u8(t->lin5_lo, ri)), vshll_n_u8(vqtbl2_u8(t->lin5_hi, ri), 8));
+    uint16x8_t g = vorrq_u16(vmovl_u8(vqtbl4_u8(t->lin6_lo, gi)), vshll_n_u8(vqtbl4_u8(t->lin6_hi, gi), 8));
+    uint16x8_t bl = vorrq_u16(vmovl_u8(vqtbl2_u8(t->lin5_lo, bi)), vshll_n_u8(vqtbl2_u8(t->lin5_hi, bi), 8));
+    int32x4_t l0, a0, b0, l1, a1, b1;
+
+    lab4_neon(vget_low_u16(r), vget_low_u16(g), vget_low_u16(bl), &l0, &a0, &b0);
+    lab4_neon(vget_high_u16(r), vget_high_u16(g), vget_high_u16(bl), &l1, &a1, &b1);
+    *l = vcombine_s16(vmovn_s32(l0), vmovn_s32(l1));
+    *a = vcombine_s16(vmovn_s32(a0), vmovn_s32(a1));
+    *b = vcombine_s16(vmovn_s32(b0), vmovn_s32(b1));
+}
+
+static inline uint16x8_t in_range(int16x8_t v, int lo, int hi)
+{
+    return vandq_u16(vcgeq_s16(v, vdupq_n_s16(lo)), vcleq_s16(v, vdupq_n_s16(hi)));
+}
+
+static void classify_neon(const uint16_t *pixels, int n, uint16_t *mask)
+{
+    lin_tables_t t;
+    int i, k;
+
+    lin_tables_load(&t);
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        uint16x8_t m = vdupq_n_u16(0);
+        int16x8_t l, a, b;
+
+        lab8_neon(&t, vld1q_u16(&pixels[i]), &l, &a, &b);
+        for (k = 0; k < PH_CLASSES; k++)
+        {
+            const ph_class_t *c = &ph_classes[k];
+            uint16x8_t hit = vandq_u16(vandq_u16(in_range(l, c->l_min, c->l_max),
+                                                 in_range(a, c->a_min, c->a_max)),
+                                       in_range(b, c->b_min, c->b_max));
+
+            m = vorrq_u16(m, vandq_u16(hit, vdupq_n_u16(1u << k)));
+        }
+        vst1q_u16(&mask[i], m);
+    }
+    // 不足 8 个的尾部
+    classify_scalar(&pixels[i], n - i, &mask[i]);
+}
+
+static void lab_convert_neon(const uint16_t *pixels, int n, int8_t *l, int8_t *a, int8_t *b)
+{
+    lin_tables_t t;
+    int i;
+
+    lin_tables_load(&t);
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        int16x8_t vl, va, vb;
+
+        lab8_neon(&t, vld1q_u16(&pixels[i]), &vl, &va, &vb);
+        vst1_s8(&l[i], vmovn_s16(vl));
+        vst1_s8(&a[i], vmovn_s16(va));
+        vst1_s8(&b[i], vmovn_s16(vb));
+    }
+    lab_convert_scalar(&pixels[i], n - i, &l[i], &a[i], &b[i]);
+}
+#endif
+
+/*
+ * @description : 不用查找表，一遍完成换算和分类，用于建表和对照
+ * @param - mask : 输出，每个像素的类别位掩码，第 k 位对应 ph_class_get(k)
+ */
+void ph_classify_direct(const uint16_t *pixels, int n, uint16_t *mask)
+{
+#ifdef __ARM_NEON
+    classify_neon(pixels, n, mask);
+#else
+    classify_scalar(pixels, n, mask);
+#endif
+}
+
+static void lab_convert(const uint16_t *pixels, int n, int8_t *l, int8_t *a, int8_t *b)
+{
+#ifdef __ARM_NEON
+    lab_convert_neon(pixels, n, l, a, b);
+#else
+    lab_convert_scalar(pixels, n, l, a, b);
+#endif
+}
+
+// 按缓存的 LAB 重算查找表中类别 k 的一位，每项只写一次，读者看到的是旧值或新值
+static void lut_update_class(int k)
+{
+    const ph_class_t *c = &ph_classes[k];
+    const uint16_t bit = 1u << k;
+    int v;
+
+    for (v = 0; v < PH_LUT_SIZE; v++)
+    {
+        int hit = lab_l[v] >= c->l_min && lab_l[v] <= c->l_max &&
+                  lab_a[v] >= c->a_min && lab_a[v] <= c->a_max &&
+                  lab_b[v] >= c->b_min && lab_b[v] <= c->b_max;
+
+        lut[v] = (lut[v] & ~bit) | (hit ? bit : 0);
+    }
+}
+
+static void lut_build(void)
+{
+    uint16_t values[256];
+    uint64_t t0 = monotonic_ns();
+    int v, k;
+
+    for (v = 0; v < PH_LUT_SIZE; v += 256)
+    {
+        for (k = 0; k < 256; k++)
+            values[k] = v + k;
+        lab_convert(values, 256, &lab_l[v], &lab_a[v], &lab_b[v]);
+    }
+    for (k = 0; k < PH_CLASSES; k++)
+        lut_update_class(k);
+    lut_stats.build_ns = monotonic_ns() - t0;
+}
+
+// 建立查找表，只在第一次调用时执行
+void ph_lut_init(void)
+{
+    pthread_once(&lut_once, lut_build);
+}
+
+/*
+ * @description : 查表分类，第一次调用时建表
+ * @param - mask : 输出，每个像素的类别位掩码，第 k 位对应 ph_class_get(k)
+ */
+void ph_classify(const uint16_t *pixels, int n, uint16_t *mask)
+{
+    int i;
+
+    ph_lut_init();
+    for (i = 0; i < n; i++)
+        mask[i] = lut[pixels[i]];
+}
+
+/*
+ * @description : 重新标定类别 k 的阈值，只重算查找表中该类别的一位
+ * @param - th : L_min, L_max, A_min, A_max, B_min, B_max，与 PH_CONFIGS 顺序相同
+ * @return : 0 成功，-1 参数错误
+ */
+int ph_set_threshold(int k, const int th[6])
+{
+    ph_class_t *c;
+    uint64_t t0;
+
+    if (k < 0 || k >= PH_CLASSES || th[0] < 0 || th[1] > 100 || th[2] < -128 || th[3] > 127 ||
+        th[4] < -128 || th[5] > 127 || th[0] > th[1] || th[2] > th[3] || th[4] > th[5])
+        return -1;
+
+    ph_lut_init();
+    t0 = monotonic_ns();
+    c = &ph_classes[k];
+    c->l_min = th[0];
+    c->l_max = th[1];
+    c->a_min = th[2];
+    c->a_max = th[3];
+    c->b_min = th[4];
+    c->b_max = th[5];
+    lut_update_class(k);
+    lut_stats.rebuild_ns = monotonic_ns() - t0;
+    lut_stats.rebuilds++;
+    return 0;
+}
+
+/*
+ * @description : 解析 "pH7:35,70,-25,25,25,90" 并重新标定
+ * @return : 类别序号，-1 表示格式错误
+ */
+int ph_set_threshold_text(const char *text)
+{
+    const char *colon = strchr(text, ':');
+    int th[6], k;
+    char end;
+
+    if (colon == NULL || sscanf(colon + 1, "%d,%d,%d,%d,%d,%d%c",
+                                &th[0], &th[1], &th[2], &th[3], &th[4], &th[5], &end) != 6)
+        return -1;
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        if (strlen(ph_classes[k].label) == (size_t)(colon - text) &&
+            strncmp(ph_classes[k].label, text, colon - text) == 0)
+            return ph_set_threshold(k, th) < 0 ? -1 : k;
+    }
+    return -1;
+}
+
+void ph_lut_get_stats(ph_lut_stats_t *stats)
+{
+    *stats = lut_stats;
+}
+
+const char *ph_classify_impl(void)
+{
+#ifdef __ARM_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+// 与 视觉代码.py 相同的做法：每个类别把整幅图换算比较一遍，作为计时和结果对照
+static void classify_per_class(const uint16_t *pixels, int n, uint16_t *mask)
+{
+    ph_lab_t lab;
+    int i, k;
+
+    memset(mask, 0, n * sizeof(mask[0]));
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        const ph_class_t *c = &ph_classes[k];
+
+        for (i = 0; i < n; i++)
+        {
+            ph_rgb565_to_lab(pixels[i], &lab);
+            if (lab.l >= c->l_min && lab.l <= c->l_max &&
+                lab.a >= c->a_min && lab.a <= c->a_max &&
+                lab.b >= c->b_min && lab.b <= c->b_max)
+                mask[i] |= 1u << k;
+        }
+    }
+}
+
+static uint8_t *read_binary(const char *path, long *size)
+{
+    FILE *fp = fopen(path, "rb");
+    uint8_t *buf;
+
+    if (fp == NULL)
+        return NULL;
+    if (fseek(fp, 0, SEEK_END) != 0 || (*size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    buf = malloc(*size > 0 ? *size : 1);
+    if (buf && fread(buf, 1, *size, fp) != (size_t)*size)
+    {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+    return buf;
+}
+
+// PPM 文件头中的一个十进制数，跳过空白和 # 注释
+static int ppm_number(const uint8_t *buf, long size, long *pos, int *value)
+{
+    long p = *pos;
+    int v = 0;
+
+    while (p < size && (buf[p] == '#' || buf[p] == ' ' || buf[p] == '\t' || buf[p] == '\r' || buf[p] == '\n'))
+    {
+        if (buf[p] == '#')
+        {
+            while (p < size && buf[p] != '\n')
+                p++;
+        }
+        else
+        {
+            p++;
+        }
+    }
+    if (p >= size || buf[p] < '0' || buf[p] > '9')
+        return -1;
+    while (p < size && buf[p] >= '0' && buf[p] <= '9' && v < 100000)
+        v = v * 10 + (buf[p++] - '0');
+    *value = v;
+    *pos = p;
+    return 0;
+}
+
+/*
+ * @description : 读取一帧图像
+ * @param - spec : 二进制 PPM（P6，maxval 255）文件名，
+ *                 或 "文件名:宽x高" 表示小端 RGB565 原始数据
+ * @return : 0 成功，-1 失败
+ */
+int ph_image_load(const char *spec, ph_image_t *img)
+{
+    char path[256];
+    const char *colon = strrchr(spec, ':');
+    int w = 0, h = 0, maxval = 0, i, n;
+    uint8_t *buf;
+    long size, pos = 2;
+    char end;
+
+    memset(img, 0, sizeof(*img));
+    snprintf(path, sizeof(path), "%s", spec);
+    if (colon && sscanf(colon + 1, "%dx%d%c", &w, &h, &end) == 2)
+        path[colon - spec] = '\0';
+    else
+        w = h = 0;
+
+    buf = read_binary(path, &size);
+    if (buf == NULL)
+    {
+        printf("Cannot read image %s\n", path);
+        return -1;
+    }
+
+    if (size >= 2 && buf[0] == 'P' && buf[1] == '6')
+    {
+        if (ppm_number(buf, size, &pos, &w) < 0 || ppm_number(buf, size, &pos, &h) < 0 ||
+            ppm_number(buf, size, &pos, &maxval) < 0 || maxval != 255 || w <= 0 || h <= 0 ||
+            size - pos - 1 < (long)w * h * 3)
+        {
+            printf("%s: unsupported PPM (need P6, maxval 255)\n", path);
+            free(buf);
+            return -1;
+        }
+        pos++; // 文件头后的一个空白
+        n = w * h;
+        img->pixels = malloc(n * sizeof(uint16_t));
+        for (i = 0; img->pixels && i < n; i++)
+        {
+            const uint8_t *p = &buf[pos + 3 * i];
+
+            img->pixels[i] = ((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) | (p[2] >> 3);
+        }
+    }
+    else
+    {
+        if (w <= 0 || h <= 0 || size != (long)w * h * 2)
+        {
+            printf("%s: raw RGB565 needs :WxH matching the file size (%ld bytes)\n", path, size);
+            free(buf);
+            return -1;
+        }
+        n = w * h;
+        img->pixels = malloc(n * sizeof(uint16_t));
+        for (i = 0; img->pixels && i < n; i++)
+            img->pixels[i] = buf[2 * i] | (buf[2 * i + 1] << 8);
+    }
+    free(buf);
+    if (img->pixels == NULL)
+        return -1;
+    img->width = w;
+    img->height = h;
+    return 0;
+}
+
+void ph_image_free(ph_image_t *img)
+{
+    free(img->pixels);
+    img->pixels = NULL;
+}
+
+// 重复执行 PH_BENCH_RUNS 次，返回每帧 ms
+static double bench_ms(void (*classify)(const uint16_t *, int, uint16_t *),
+                       const uint16_t *pixels, int n, uint16_t *mask)
+{
+    uint64_t t0 = monotonic_ns();
+    int i;
+
+    for (i = 0; i < PH_BENCH_RUNS; i++)
+        classify(pixels, n, mask);
+    return (monotonic_ns() - t0) / 1e6 / PH_BENCH_RUNS;
+}
+
+static long count_mismatches(const uint16_t *a, const uint16_t *b, int n)
+{
+    long diff = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        diff += a[i] != b[i];
+    return diff;
+}
+
+// 打印色块，格式与视觉模块发送的 JSON 相同
+static void print_blob(const char *prefix, const ph_blob_t *b)
+{
+    const ph_class_t *c = &ph_classes[b->cls];
+
+    printf("%s{\"pH\": \"%s\", \"color\": \"%s\", \"position\": [%d, %d], \"area\": %d}"
+           "  rect (%d,%d,%d,%d), %u px\n",
+           prefix, c->label, c->name, (int)(b->cx + 0.5f), (int)(b->cy + 0.5f), ph_blob_area(b),
+           b->rect.x, b->rect.y, b->rect.w, b->rect.h, b->pixels);
+}
+
+/*
+ * @description : --ph-image：离线分类一帧图像并提取色块，打印各类别像素数、色块和计时
+ * @param - roi : 色块提取区域，NULL 为整帧
+ */
+int ph_image_run(const char *spec, const ph_rect_t *roi)
+{
+    ph_image_t img;
+    uint16_t *mask, *direct, *ref;
+    uint32_t count[PH_CLASSES] = {0};
+    ph_lut_stats_t lst;
+    ph_blob_ctx_t blob;
+    const ph_blob_t *best_blob;
+    uint64_t t0;
+    double lut_ms, direct_ms, per_class_ms, blob_ms;
+    long direct_diff, lut_diff;
+    int i, k, n, best = -1;
+    int th[6];
+
+    if (ph_image_load(spec, &img) < 0)
+        return -1;
+    n = img.width * img.height;
+    mask = malloc(n * sizeof(uint16_t));
+    direct = malloc(n * sizeof(uint16_t));
+    ref = malloc(n * sizeof(uint16_t));
+    if (mask == NULL || direct == NULL || ref == NULL || ph_blob_init(&blob, img.width) < 0)
+    {
+        free(mask);
+        free(direct);
+        free(ref);
+        ph_image_free(&img);
+        return -1;
+    }
+
+    ph_lut_init();
+    lut_ms = bench_ms(ph_classify, img.pixels, n, mask);
+    direct_ms = bench_ms(ph_classify_direct, img.pixels, n, direct);
+    per_class_ms = bench_ms(classify_per_class, img.pixels, n, ref);
+    direct_diff = count_mismatches(direct, ref, n);
+    lut_diff = count_mismatches(mask, ref, n);
+
+    // 用原值重新标定一个类别，测量增量重建耗时
+    th[0] = ph_classes[0].l_min;
+    th[1] = ph_classes[0].l_max;
+    th[2] = ph_classes[0].a_min;
+    th[3] = ph_classes[0].a_max;
+    th[4] = ph_classes[0].b_min;
+    th[5] = ph_classes[0].b_max;
+    ph_set_threshold(0, th);
+    ph_lut_get_stats(&lst);
+
+    for (i = 0; i < n; i++)
+    {
+        for (k = 0; k < PH_CLASSES; k++)
+            count[k] += (mask[i] >> k) & 1;
+    }
+
+    printf("pH image %s: %dx%d, LAB kernel %s\n", spec, img.width, img.height, ph_classify_impl());
+    printf("  lookup table: built in %.2f ms, one-class rebuild %.3f ms\n",
+           lst.build_ns / 1e6, lst.rebuild_ns / 1e6);
+    printf("  lookup:      %.3f ms/frame (%.1f Mpixel/s)\n", lut_ms, n / lut_ms / 1e3);
+    printf("  single pass: %.3f ms/frame (%.1f Mpixel/s), %.1fx slower\n",
+           direct_ms, n / direct_ms / 1e3, direct_ms / lut_ms);
+    printf("  per-class (%d passes): %.3f ms/frame, %.1fx slower\n",
+           PH_CLASSES, per_class_ms, per_class_ms / lut_ms);
+    printf("  pixels differing from scalar reference: lookup %ld, single pass %ld\n", lut_diff, direct_diff);
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        if (count[k] == 0)
+            continue;
+        printf("  %-4s %s: %u px (%.1f%%)\n", ph_classes[k].label, ph_classes[k].name,
+               count[k], count[k] * 100.0 / n);
+        if (best < 0 || count[k] > count[best])
+            best = k;
+    }
+    if (best >= 0)
+        printf("  most pixels: %s (%s)\n", ph_classes[best].label, ph_classes[best].name);
+    else
+        printf("  no pH color found\n");
+
+    t0 = monotonic_ns();
+    for (i = 0; i < PH_BENCH_RUNS; i++)
+        ph_blob_find(&blob, mask, img.width, img.height, roi);
+    blob_ms = (monotonic_ns() - t0) / 1e6 / PH_BENCH_RUNS;
+    if (roi)
+        printf("  ROI (%d,%d,%d,%d)\n", roi->x, roi->y, roi->w, roi->h);
+    printf("  blobs: %.3f ms/frame (%u runs, %u labels, peak %u live, %u merged), lookup + blobs %.3f ms/frame\n",
+           blob_ms, blob.stats.runs, blob.stats.labels, blob.stats.peak_labels, blob.stats.merged,
+           lut_ms + blob_ms);
+    if (blob.stats.dropped_blobs)
+        printf("  dropped: %u blobs\n", blob.stats.dropped_blobs);
+    for (i = 0; i < blob.nblobs && i < 10; i++)
+        print_blob("    ", &blob.blobs[i]);
+    if (blob.nblobs > 10)
+        printf("    ... %d more\n", blob.nblobs - 10);
+    best_blob = ph_blob_best(&blob);
+    if (best_blob)
+        print_blob("  result: ", best_blob);
+    else
+        printf("  result: no blob\n");
+    ph_blob_free(&blob);
+
+    free(mask);
+    free(direct);
+    free(ref);
+    ph_image_free(&img);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __PH_DETECT_H
+#define __PH_DETECT_H
+
+#include <stdint.h>
+
+/*
+ * pH 试纸颜色分类，与 视觉代码.py 的 PH_CONFIGS 相同的 LAB 阈值，
+ * LAB 换算与 OpenMV 相同（sRGB、D65，L 0~100，A/B -128~127，向下取整）。
+ * 每个像素一次换算后与全部类别比较，结果为位掩码：第 k 位对应 pH(k+1)，
+ * 阈值有重叠，一个像素可以同时属于多个类别。
+ * 分类通过 65536 项的查找表进行，阈值重新标定后只更新该类别的一位。
+ */
+#define PH_CLASSES 14
+#define PH_LUT_SIZE 65536 // 每个 RGB565 值一项
+#define PH_BENCH_RUNS 100 // --ph-image 计时的重复次数
+
+typedef struct
+{
+    const char *label; // "pH1"
+    const char *name;  // 颜色名
+    int8_t l_min, l_max, a_min, a_max, b_min, b_max;
+} ph_class_t;
+
+typedef struct
+{
+    int8_t l, a, b;
+} ph_lab_t;
+
+typedef struct
+{
+    uint64_t build_ns;   // 启动时建表（LAB 缓存 + 全部类别）耗时
+    uint64_t rebuild_ns; // 最近一次重新标定耗时
+    uint32_t rebuilds;
+} ph_lut_stats_t;
+
+typedef struct
+{
+    int x, y, w, h;
+} ph_rect_t;
+
+// RGB565 图像，像素按主机字节序存放
+typedef struct
+{
+    int width;
+    int height;
+    uint16_t *pixels;
+} ph_image_t;
+
+const ph_class_t *ph_class_get(int k);
+void ph_rgb565_to_lab(uint16_t pixel, ph_lab_t *lab);
+uint16_t ph_lab_classify(const ph_lab_t *lab);
+void ph_classify_direct(const uint16_t *pixels, int n, uint16_t *mask);
+const char *ph_classify_impl(void);
+void ph_lut_init(void);
+void ph_classify(const uint16_t *pixels, int n, uint16_t *mask);
+int ph_set_threshold(int k, const int th[6]);
+int ph_set_threshold_text(const char *text);
+void ph_lut_get_stats(ph_lut_stats_t *stats);
+
+int ph_image_load(const char *spec, ph_image_t *img);
+void ph_image_free(ph_image_t *img);
+int ph_image_run(const char *spec, const ph_rect_t *roi);
+
+#endif
@@ -0,0 +1,266 @@
+#include <math.h>
+#include <string.h>
+#include "planner.h"
+
+/*
+ * 运动曲线规划
+ * 把一次运动（边沿数 + 速度/加速度/加加速度限制）转换为分段三次多项式 s(t)，
+ * 加加速度为 0 时退化为梯形曲线。所有内部计算以“边沿”为单位。
+ */
+
+// 从静止加速到 v 所需的时间参数，返回加速段走过的距离
+static double accel_phase(double v, double a, double j, double *tj, double *ta)
+{
+	if (j > 0)
+	{
+		if (v * j < a * a)
+		{
+			// 达不到最大加速度，只有加加速和减加速两段
+			*tj = sqrt(v / j);
+			*ta = 0;
+		}
+		else
+		{
+			*tj = a / j;
+			*ta = v / a - *tj;
+		}
+	}
+	else
+	{
+		*tj = 0;
+		*ta = v / a;
+	}
+	// 加速段速度曲线关于中点对称，平均速度为 v/2
+	return v * (2 * *tj + *ta) / 2;
+}
+
+static double segment_position(const planner_segment_t *seg, double tau)
+{
+	return seg->s0 + seg->v0 * tau + seg->a0 * tau * tau / 2 + seg->j * tau * tau * tau / 6;
+}
+
+static double planner_position_at(const motion_plan_t *plan, double t)
+{
+	int i;
+
+	if (plan->segment_count == 0 || t <= 0)
+		return 0;
+	if (t >= plan->total_time)
+		return plan->steps;
+
+	for (i = plan->segment_count - 1; i > 0; i--)
+	{
+		if (plan->seg[i].t0 <= t)
+			break;
+	}
+	return segment_position(&plan->seg[i], t - plan->seg[i].t0);
+}
+
+/*
+ * @description : 规划一次从静止到静止的运动
+ * @param - plan   : 输出的规划结果
+ * @param - steps  : 需要输出的边沿数
+ * @param - limits : 以圈为单位的运动限制
+ * @param - steps_per_circle : 每圈边沿数
+ * @return : 0 成功，-1 参数错误
+ */
+int planner_plan(motion_plan_t *plan, uint32_t steps, const motion_limits_t *limits, float steps_per_circle)
+{
+	double d, v, a, j, tj, ta, tc, da, ap;
+	double s, vel, t;
+	int i;
+
+	memset(plan, 0, sizeof(*plan));
+	plan->steps = steps;
+	if (steps == 0)
+		return 0;
+
+	if (limits->max_velocity <= 0 || limits->acceleration <= 0 || steps_per_circle <= 0)
+		return -1;
+
+	d = steps;
+	v = limits->max_velocity * steps_per_circle;
+	a = limits->acceleration * steps_per_circle;
+	j = limits->jerk > 0 ? limits->jerk * steps_per_circle : 0;
+
+	da = accel_phase(v, a, j, &tj, &ta);
+	if (2 * da > d)
+	{
+		// 距离太短到不了最高速度，二分查找能达到的峰值速度
+		double lo = 0, hi = v;
+		for (i = 0; i < 60; i++)
+		{
+			double mid = (lo + hi) / 2;
+			if (2 * accel_phase(mid, a, j, &tj, &ta) > d)
+				hi = mid;
+			else
+				lo = mid;
+		}
+		v = lo;
+		da = accel_phase(v, a, j, &tj, &ta);
+	}
+	tc = (d - 2 * da) / v;
+	if (tc < 0)
+		tc = 0;
+	ap = j > 0 ? j * tj : a;
+
+	// 加加速、匀加速、减加速、匀速、加减速、匀减速、减减速
+	const double dur[PLANNER_MAX_SEGMENTS] = {tj, ta, tj, tc, tj, ta, tj};
+	const double jerk[PLANNER_MAX_SEGMENTS] = {j, 0, -j, 0, -j, 0, j};
+	const double acc[PLANNER_MAX_SEGMENTS] = {0, ap, ap, 0, 0, -ap, -ap};
+
+	s = 0;
+	vel = 0;
+	t = 0;
+	for (i = 0; i < PLANNER_MAX_SEGMENTS; i++)
+	{
+		planner_segment_t *seg;
+		double tau = dur[i];
+
+		if (tau <= 0)
+			continue;
+
+		seg = &plan->seg[plan->segment_count++];
+		seg->t0 = t;
+		seg->duration = tau;
+		seg->s0 = s;
+		seg->v0 = vel;
+		seg->a0 = acc[i];
+		seg->j = jerk[i];
+
+		s = segment_position(seg, tau);
+		vel += acc[i] * tau + jerk[i] * tau * tau / 2;
+		t += tau;
+	}
+
+	plan->total_time = t;
+	plan->peak_velocity = v;
+	return 0;
+}
+
+/*
+ * @description : 求曲线到达位置 s（边沿）的时刻
+ * @return : 时间 s
+ */
+double planner_time_at(const motion_plan_t *plan, double s)
+{
+	const planner_segment_t *seg;
+	double lo, hi;
+	int i;
+
+	if (s <= 0 || plan->segment_count == 0)
+		return 0;
+	if (s >= plan->steps)
+		return plan->total_time;
+
+	for (i = plan->segment_count - 1; i > 0; i--)
+	{
+		if (plan->seg[i].s0 <= s)
+			break;
+	}
+	seg = &plan->seg[i];
+
+	// 段内位置单调，二分即可
+	lo = 0;
+	hi = seg->duration;
+	for (i = 0; i < 48; i++)
+	{
+		double mid = (lo + hi) / 2;
+		if (segment_position(seg, mid) < s)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return seg->t0 + (lo + hi) / 2;
+}
+
+/*
+ * @description : 取下一个边沿与上一个边沿之间的间隔
+ * @return : 间隔 ns，0 表示运动已结束
+ */
+uint32_t planner_next_interval_ns(motion_plan_t *plan)
+{
+	double t, dt;
+
+	if (plan->next_step >= plan->steps)
+		return 0;
+
+	plan->next_step++;
+	t = planner_time_at(plan, plan->next_step);
+	dt = t - plan->last_time;
+	plan->last_time = t;
+
+	if (dt < 1e-9)
+		return 1;
+	if (dt > 4.0)
+		return 4000000000u;
+	return (uint32_t)(dt * 1e9 + 0.5);
+}
+
+/*
+ * @description : 把曲线量化为若干恒定周期的分段
+ *                加速段和减速段各按等时间切片，匀速段单独一段；
+ *                每段周期取段内平均间隔，保证每段结束时刻与曲线一致
+ * @param - min_period_ns : 周期下限（驱动拒绝更短的间隔），低于下限的分段按下限输出，运动相应变慢
+ * @return : 分段数
+ */
+int planner_to_chunks(const motion_plan_t *plan, planner_chunk_t *chunks, int max_chunks, uint32_t min_period_ns)
+{
+	uint32_t bounds[2 * 64 + 2];
+	double t_acc;
+	int ramp, nb, count, i;
+
+	if (plan->steps == 0 || max_chunks < 1)
+		return 0;
+
+	ramp = (max_chunks - 1) / 2;
+	if (ramp > 64)
+		ramp = 64;
+
+	// 加速段时长：第一个匀速段（或对称中点）之前的时间
+	t_acc = plan->total_time / 2;
+	for (i = 0; i < plan->segment_count; i++)
+	{
+		if (plan->seg[i].j == 0 && plan->seg[i].a0 == 0)
+		{
+			t_acc = plan->seg[i].t0;
+			break;
+		}
+	}
+
+	nb = 0;
+	bounds[nb++] = 0;
+	for (i = 1; i <= ramp; i++)
+		bounds[nb++] = (uint32_t)floor(planner_position_at(plan, t_acc * i / ramp));
+	for (i = ramp; i >= 1; i--)
+		bounds[nb++] = plan->steps - (uint32_t)floor(planner_position_at(plan, t_acc * i / ramp));
+	bounds[nb++] = plan->steps;
+
+	count = 0;
+	for (i = 1; i < nb && count < max_chunks; i++)
+	{
+		uint32_t from = bounds[i - 1];
+		uint32_t to = bounds[i];
+		double period;
+
+		if (to <= from)
+		{
+			bounds[i] = from;
+			continue;
+		}
+		if (count == max_chunks - 1)
+			to = plan->steps;
+
+		period = (planner_time_at(plan, to) - planner_time_at(plan, from)) / (to - from) * 1e9;
+		if (period > 4e9)
+			period = 4e9;
+		if (period < min_period_ns)
+			period = min_period_ns;
+
+		chunks[count].edges = to - from;
+		chunks[count].period_ns = (uint32_t)(period + 0.5);
+		count++;
+		bounds[i] = to;
+	}
+	return count;
+}
@@ -0,0 +1,53 @@
+#ifndef __PLANNER_H
+#define __PLANNER_H
+
+#include <stdint.h>
+
+// 单轴运动限制（圈为单位）
+typedef struct
+{
+	float max_velocity; // 最大速度 圈/秒
+	float acceleration; // 最大加速度 圈/秒²
+	float jerk;         // 最大加加速度 圈/秒³，<=0 表示梯形曲线
+} motion_limits_t;
+
+// 曲线的一段：加加速度恒定，位置是时间的三次多项式
+typedef struct
+{
+	double t0;       // 段起始时间 s
+	double duration; // 段持续时间 s
+	double s0;       // 段起始位置 边沿
+	double v0;       // 段起始速度 边沿/秒
+	double a0;       // 段起始加速度 边沿/秒²
+	double j;        // 段内加加速度 边沿/秒³
+} planner_segment_t;
+
+#define PLANNER_MAX_SEGMENTS 7
+
+// 规划结果：从静止到静止、走完 steps 个边沿的速度曲线
+typedef struct
+{
+	uint32_t steps;        // 总边沿数
+	double total_time;     // 总时间 s
+	double peak_velocity;  // 实际达到的最高速度 边沿/秒
+	int segment_count;
+	planner_segment_t seg[PLANNER_MAX_SEGMENTS];
+
+	// 逐边沿迭代游标
+	uint32_t next_step;
+	double last_time;
+} motion_plan_t;
+
+// 恒定周期的分段，用于下发给内核脉冲串
+typedef struct
+{
+	uint32_t edges;
+	uint32_t period_ns;
+} planner_chunk_t;
+
+int planner_plan(motion_plan_t *plan, uint32_t steps, const motion_limits_t *limits, float steps_per_circle);
+double planner_time_at(const motion_plan_t *plan, double s);
+uint32_t planner_next_interval_ns(motion_plan_t *plan);
+int planner_to_chunks(const motion_plan_t *plan, planner_chunk_t *chunks, int max_chunks, uint32_t min_period_ns);
+
+#endif
@@ -0,0 +1,223 @@
+#include <string.h>
+#include "protocol.h"
+
+/*
+ * 串口帧协议
+ * 接收字节先放入环形缓冲区，proto_next() 从中找同步字节、检查长度和CRC，
+ * 每次取出一个完整帧；不完整的帧留在缓冲区等待后续字节，帧外的字节交给文本解析器，
+ * 类型或长度不合理、CRC错误时把这个 0xA5 当作文本字节交出，从下一个字节重新查找，
+ * 因此读操作任意拆分或合并都不会丢帧，文本中夹杂的 0xA5 也不会吞掉后面的文本。
+ */
+
+#define RING_MASK (PROTO_RING_SIZE - 1)
+
+// CRC-16/CCITT-FALSE 查找表
+static const uint16_t crc_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint16_t crc16_update(uint16_t crc, uint8_t byte)
+{
+    return (uint16_t)(crc << 8) ^ crc_table[((crc >> 8) ^ byte) & 0xFF];
+}
+
+uint16_t proto_crc16(const uint8_t *data, int len)
+{
+    uint16_t crc = 0xFFFF;
+    int i;
+
+    for (i = 0; i < len; i++)
+        crc = crc16_update(crc, data[i]);
+    return crc;
+}
+
+/*
+ * @description : 初始化解析器
+ * @param - text : 帧外字节的接收者，NULL 表示丢弃
+ */
+void proto_parser_init(proto_parser_t *p, proto_text_cb_t text, void *text_ctx)
+{
+    memset(p, 0, sizeof(*p));
+    p->text = text;
+    p->text_ctx = text_ctx;
+}
+
+/*
+ * @description : 把收到的字节放入环形缓冲区
+ * @return : 实际放入的字节数，缓冲区满时多余字节丢弃并计入 overflows
+ */
+int proto_feed(proto_parser_t *p, const uint8_t *data, int len)
+{
+    uint32_t space = PROTO_RING_SIZE - (p->head - p->tail);
+    int n = len > (int)space ? (int)space : len;
+    int i;
+
+    for (i = 0; i < n; i++)
+        p->ring[(p->head + i) & RING_MASK] = data[i];
+    p->head += n;
+    p->stats.overflows += len - n;
+    return n;
+}
+
+static uint8_t ring_peek(const proto_parser_t *p, uint32_t offset)
+{
+    return p->ring[(p->tail + offset) & RING_MASK];
+}
+
+// 把 tail 处的字节交给文本解析器
+static void proto_skip(proto_parser_t *p)
+{
+    if (p->text)
+    {
+        p->text(ring_peek(p, 0), p->text_ctx);
+        p->stats.text++;
+    }
+    else
+    {
+        p->stats.discarded++;
+    }
+    p->tail++;
+}
+
+// tail 处的 0xA5 不是帧头：它本身属于文本，从下一个字节重新同步
+static void proto_resync(proto_parser_t *p)
+{
+    p->stats.resyncs++;
+    proto_skip(p);
+}
+
+/*
+ * @description : 取出下一个完整帧
+ * @return : 1 取到一帧，0 缓冲区中没有完整帧
+ */
+int proto_next(proto_parser_t *p, proto_frame_t *frame)
+{
+    while (p->head != p->tail)
+    {
+        uint32_t avail = p->head - p->tail;
+        uint16_t crc = 0xFFFF;
+        uint8_t len;
+        uint32_t i;
+
+        // 帧外字节直接从环形缓冲区交给文本解析器，不等凑够一个帧头
+        if (ring_peek(p, 0) != PROTO_SYNC)
+        {
+            proto_skip(p);
+            continue;
+        }
+        // 类型和长度一到就检查，文本中的 0xA5 不必等满一帧才被识别
+        if (avail < 2)
+            return 0;
+        if (!PROTO_TYPE_VALID(ring_peek(p, 1)))
+        {
+            proto_resync(p);
+            continue;
+        }
+        if (avail < 3)
+            return 0;
+        len = ring_peek(p, 2);
+        if (len > PROTO_MAX_PAYLOAD)
+        {
+            proto_resync(p);
+            continue;
+        }
+        if (avail < (uint32_t)PROTO_HEADER_LEN + len + PROTO_CRC_LEN)
+            return 0;
+
+        for (i = 1; i < (uint32_t)PROTO_HEADER_LEN + len; i++)
+            crc = crc16_update(crc, ring_peek(p, i));
+        if ((crc & 0xFF) != ring_peek(p, PROTO_HEADER_LEN + len) ||
+            (crc >> 8) != ring_peek(p, PROTO_HEADER_LEN + len + 1))
+        {
+            // 可能是文本或负载中的 0xA5 被当成了帧头
+            p->stats.crc_errors++;
+            proto_resync(p);
+            continue;
+        }
+
+        frame->type = ring_peek(p, 1);
+        frame->len = len;
+        frame->seq = ring_peek(p, 3);
+        for (i = 0; i < len; i++)
+            frame->payload[i] = ring_peek(p, PROTO_HEADER_LEN + i);
+        p->tail += PROTO_HEADER_LEN + len + PROTO_CRC_LEN;
+        p->stats.frames++;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * @description : 组帧
+ * @param - buf  : 输出缓冲区，至少 PROTO_HEADER_LEN + len + PROTO_CRC_LEN 字节
+ * @return : 帧长度，-1 表示负载过长或缓冲区不足
+ */
+int proto_encode(uint8_t type, uint8_t seq, const void *payload, int len, uint8_t *buf, int size)
+{
+    uint16_t crc;
+
+    if (len < 0 || len > PROTO_MAX_PAYLOAD || size < PROTO_HEADER_LEN + len + PROTO_CRC_LEN)
+        return -1;
+    buf[0] = PROTO_SYNC;
+    buf[1] = type;
+    buf[2] = (uint8_t)len;
+    buf[3] = seq;
+    if (len > 0)
+        memcpy(buf + PROTO_HEADER_LEN, payload, len);
+    crc = proto_crc16(buf + 1, PROTO_HEADER_LEN - 1 + len);
+    buf[PROTO_HEADER_LEN + len] = crc & 0xFF;
+    buf[PROTO_HEADER_LEN + len + 1] = crc >> 8;
+    return PROTO_HEADER_LEN + len + PROTO_CRC_LEN;
+}
+
+// 小端 IEEE754 单精度，与主机字节序无关
+float proto_get_f32(const uint8_t *p)
+{
+    uint32_t bits = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void proto_put_f32(uint8_t *p, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    p[0] = bits & 0xFF;
+    p[1] = (bits >> 8) & 0xFF;
+    p[2] = (bits >> 16) & 0xFF;
+    p[3] = bits >> 24;
+}
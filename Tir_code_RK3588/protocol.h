@@ -0,0 +1,82 @@
+#ifndef __PROTOCOL_H
+#define __PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * 串口帧格式（/dev/ttyS9，多字节数值均为小端）：
+ *   0xA5 | type | len | seq | payload[len] | crc16 低字节 | crc16 高字节
+ * crc16 为 CRC-16/CCITT-FALSE（多项式0x1021，初值0xFFFF），覆盖 type 到 payload 末尾
+ * 帧之外的字节（不以 0xA5 开头）交给文本命令解析器，文本命令见 usart_me_Recive.h
+ * 帧类型不使用可打印 ASCII（0x20~0x7E），文本中偶然出现的 0xA5 后面跟着文本字符时立即判定不是帧头，
+ * 长度非法或CRC错误的 0xA5 同样作为文本字节交出，从下一个字节重新同步
+ */
+#define PROTO_SYNC 0xA5
+#define PROTO_HEADER_LEN 4
+#define PROTO_CRC_LEN 2
+#define PROTO_MAX_PAYLOAD 64
+#define PROTO_MAX_FRAME (PROTO_HEADER_LEN + PROTO_MAX_PAYLOAD + PROTO_CRC_LEN)
+#define PROTO_RING_SIZE 1024 // 接收环形缓冲区，必须为2的幂
+
+// 帧类型，不能落在可打印 ASCII 范围内
+#define PROTO_TYPE_VALID(t) ((t) < 0x20 || (t) > 0x7E)
+enum
+{
+    PROTO_PH_RESULT = 0x01, // float pH
+    PROTO_MOTION = 0x02,    // uint8 轴掩码, uint8 标志, 掩码中每个轴一个 float 目标圈数（A~D 顺序）
+    PROTO_ACK = 0x80,       // uint8 被应答帧的 seq, uint8 状态 PROTO_ACK_*
+};
+
+// PROTO_MOTION 标志
+#define PROTO_MOTION_QUEUE 0x01 // 排入各轴运动队列，否则作为协调运动立即执行
+
+// ACK 状态
+enum
+{
+    PROTO_ACK_OK = 0,
+    PROTO_ACK_UNSUPPORTED = 1, // 未知帧类型
+    PROTO_ACK_INVALID = 2,     // 负载长度或内容错误
+    PROTO_ACK_BUSY = 3,        // 运动队列已满
+};
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t len;
+    uint8_t seq;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+} proto_frame_t;
+
+typedef struct
+{
+    uint64_t frames;      // 校验通过的帧
+    uint64_t crc_errors;
+    uint64_t discarded;   // 没有文本解析器时丢弃的帧外字节
+    uint64_t resyncs;     // 帧头不合理或CRC错误，0xA5 作为文本交出后重新同步
+    uint64_t text;        // 帧外交给文本解析器的字节
+    uint64_t overflows;   // 缓冲区满丢弃的字节
+} proto_stats_t;
+
+// 帧外字节的接收者，例如串口文本命令解析器
+typedef void (*proto_text_cb_t)(uint8_t byte, void *ctx);
+
+// 增量解析器，字节可以按任意分段送入
+typedef struct
+{
+    uint8_t ring[PROTO_RING_SIZE];
+    uint32_t head; // 写入位置，自由增长，取模使用
+    uint32_t tail; // 读取位置
+    proto_text_cb_t text;
+    void *text_ctx;
+    proto_stats_t stats;
+} proto_parser_t;
+
+uint16_t proto_crc16(const uint8_t *data, int len);
+void proto_parser_init(proto_parser_t *p, proto_text_cb_t text, void *text_ctx);
+int proto_feed(proto_parser_t *p, const uint8_t *data, int len);
+int proto_next(proto_parser_t *p, proto_frame_t *frame);
+int proto_encode(uint8_t type, uint8_t seq, const void *payload, int len, uint8_t *buf, int size);
+float proto_get_f32(const uint8_t *p);
+void proto_put_f32(uint8_t *p, float value);
+
+#endif
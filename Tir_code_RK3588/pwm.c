@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "motor.h"
+#include "pwm.h"
+
+/*
+ * sysfs PWM 后端
+ * 每个通道的 period / duty_cycle / enable 文件在 pwm_open() 时打开一次，
+ * 之后每次修改只是一次 pwrite，不再通过 system() 启动 shell。
+ */
+
+typedef struct
+{
+	int used;
+	int exported; // 由本程序 export，关闭时 unexport
+	int period_fd;
+	int duty_fd;
+	int enable_fd;
+	pwm_status_t st;
+} pwm_channel_t;
+
+static pwm_channel_t channels[PWM_MAX_CHANNELS];
+static char sysfs_root[128] = "";
+static pthread_mutex_t pwm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 指定 sysfs 根目录，NULL 恢复默认
+void pwm_set_root(const char *root)
+{
+	snprintf(sysfs_root, sizeof(sysfs_root), "%s", root ? root : "");
+}
+
+const char *pwm_get_root(void)
+{
+	const char *env;
+
+	if (sysfs_root[0])
+		return sysfs_root;
+	env = getenv("PWM_SYSFS_ROOT");
+	return env && env[0] ? env : PWM_SYSFS_ROOT;
+}
+
+// 写一个整数到已打开的属性文件，带换行，文件偏移始终为0
+static int pwm_write_value(pwm_channel_t *ch, int fd, uint32_t value)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%u\n", value);
+	uint64_t t0 = monotonic_ns();
+	uint64_t dt;
+	ssize_t n = pwrite(fd, buf, len, 0);
+
+	dt = monotonic_ns() - t0;
+	ch->st.writes++;
+	if (dt > ch->st.write_ns_max)
+		ch->st.write_ns_max = dt;
+	return n == len ? 0 : -1;
+}
+
+// 一次性写文件，用于 export/unexport
+static int pwm_write_file(const char *path, int value)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d\n", value);
+	int fd = open(path, O_WRONLY | O_CLOEXEC);
+	int ret;
+
+	if (fd < 0)
+		return -1;
+	ret = write(fd, buf, len) == len ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+static int pwm_open_attr(int chip, int channel, const char *attr)
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/pwmchip%d/pwm%d/%s", pwm_get_root(), chip, channel, attr);
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		printf("PWM: cannot open %s: %s\n", path, strerror(errno));
+	return fd;
+}
+
+static void pwm_close_fds(pwm_channel_t *ch)
+{
+	if (ch->period_fd >= 0)
+		close(ch->period_fd);
+	if (ch->duty_fd >= 0)
+		close(ch->duty_fd);
+	if (ch->enable_fd >= 0)
+		close(ch->enable_fd);
+	ch->period_fd = ch->duty_fd = ch->enable_fd = -1;
+}
+
+/*
+ * @description : 导出并打开一个PWM通道，默认1kHz、占空比0、已使能
+ * @param - chip    : pwmchip 编号
+ * @param - channel : 通道编号
+ * @return : 句柄（>=0），-1 表示失败
+ */
+int pwm_open(int chip, int channel)
+{
+	char dir[200], path[256];
+	pwm_channel_t *ch = NULL;
+	int handle, waited;
+
+	pthread_mutex_lock(&pwm_lock);
+	for (handle = 0; handle < PWM_MAX_CHANNELS; handle++)
+	{
+		if (channels[handle].used && channels[handle].st.chip == chip && channels[handle].st.channel == channel)
+		{
+			pthread_mutex_unlock(&pwm_lock);
+			return handle;
+		}
+	}
+	for (handle = 0; handle < PWM_MAX_CHANNELS && ch == NULL; handle++)
+	{
+		if (!channels[handle].used)
+			ch = &channels[handle];
+	}
+	if (ch == NULL)
+	{
+		pthread_mutex_unlock(&pwm_lock);
+		printf("PWM: no free channel slot for pwmchip%d/pwm%d\n", chip, channel);
+		return -1;
+	}
+	handle = ch - channels;
+	memset(ch, 0, sizeof(*ch));
+	ch->period_fd = ch->duty_fd = ch->enable_fd = -1;
+	ch->st.chip = chip;
+	ch->st.channel = channel;
+
+	// 已导出时 pwmN 目录已存在，不再写 export
+	snprintf(dir, sizeof(dir), "%s/pwmchip%d/pwm%d", pwm_get_root(), chip, channel);
+	if (access(dir, F_OK) != 0)
+	{
+		snprintf(path, sizeof(path), "%s/pwmchip%d/export", pwm_get_root(), chip);
+		if (pwm_write_file(path, channel) < 0)
+			printf("Warning: PWM export of %s failed: %s\n", dir, strerror(errno));
+		else
+			ch->exported = 1;
+		// 等待 udev 创建属性文件，最多 PWM_EXPORT_TIMEOUT_MS
+		for (waited = 0; waited < PWM_EXPORT_TIMEOUT_MS && access(dir, F_OK) != 0; waited++)
+			usleep(1000);
+	}
+
+	ch->period_fd = pwm_open_attr(chip, channel, "period");
+	ch->duty_fd = pwm_open_attr(chip, channel, "duty_cycle");
+	ch->enable_fd = pwm_open_attr(chip, channel, "enable");
+	if (ch->period_fd < 0 || ch->duty_fd < 0 || ch->enable_fd < 0)
+	{
+		pwm_close_fds(ch);
+		pthread_mutex_unlock(&pwm_lock);
+		return -1;
+	}
+
+	// 先清占空比再设周期，避免旧占空比大于新周期被驱动拒绝
+	if (pwm_write_value(ch, ch->duty_fd, 0) < 0 ||
+		pwm_write_value(ch, ch->period_fd, PWM_DEFAULT_PERIOD_NS) < 0 ||
+		pwm_write_value(ch, ch->enable_fd, 1) < 0)
+	{
+		printf("PWM: failed to configure pwmchip%d/pwm%d: %s\n", chip, channel, strerror(errno));
+		pwm_close_fds(ch);
+		pthread_mutex_unlock(&pwm_lock);
+		return -1;
+	}
+	ch->st.period_ns = PWM_DEFAULT_PERIOD_NS;
+	ch->st.enabled = 1;
+	ch->used = 1;
+	pthread_mutex_unlock(&pwm_lock);
+	return handle;
+}
+
+static pwm_channel_t *pwm_channel(int handle)
+{
+	if (handle < 0 || handle >= PWM_MAX_CHANNELS || !channels[handle].used)
+		return NULL;
+	return &channels[handle];
+}
+
+static uint32_t pwm_duty_for(uint32_t period_ns, int duty_percent)
+{
+	return (uint32_t)((uint64_t)period_ns * duty_percent / 100);
+}
+
+/*
+ * @description : 修改周期，保持占空比百分比不变
+ *                sysfs 要求 duty_cycle <= period，按变化方向决定写入顺序
+ */
+int pwm_set_period(int handle, uint32_t period_ns)
+{
+	pwm_channel_t *ch;
+	uint32_t duty_ns;
+	int ret;
+
+	pthread_mutex_lock(&pwm_lock);
+	ch = pwm_channel(handle);
+	if (ch == NULL || period_ns == 0)
+	{
+		pthread_mutex_unlock(&pwm_lock);
+		return -1;
+	}
+	duty_ns = pwm_duty_for(period_ns, ch->st.duty_percent);
+	if (period_ns < ch->st.period_ns)
+		ret = pwm_write_value(ch, ch->duty_fd, duty_ns) || pwm_write_value(ch, ch->period_fd, period_ns);
+	else
+		ret = pwm_write_value(ch, ch->period_fd, period_ns) || pwm_write_value(ch, ch->duty_fd, duty_ns);
+	if (ret == 0)
+	{
+		ch->st.period_ns = period_ns;
+		ch->st.duty_ns = duty_ns;
+	}
+	pthread_mutex_unlock(&pwm_lock);
+	return ret ? -1 : 0;
+}
+
+// 设置占空比百分比 0~100，超出范围截断
+int pwm_set_percent(int handle, int duty_percent)
+{
+	pwm_channel_t *ch;
+	uint32_t duty_ns;
+	int ret;
+
+	if (duty_percent < 0)
+		duty_percent = 0;
+	if (duty_percent > 100)
+		duty_percent = 100;
+
+	pthread_mutex_lock(&pwm_lock);
+	ch = pwm_channel(handle);
+	if (ch == NULL)
+	{
+		pthread_mutex_unlock(&pwm_lock);
+		return -1;
+	}
+	duty_ns = pwm_duty_for(ch->st.period_ns, duty_percent);
+	ret = pwm_write_value(ch, ch->duty_fd, duty_ns);
+	if (ret == 0)
+	{
+		ch->st.duty_percent = duty_percent;
+		ch->st.duty_ns = duty_ns;
+	}
+	pthread_mutex_unlock(&pwm_lock);
+	return ret;
+}
+
+int pwm_enable(int handle, int on)
+{
+	pwm_channel_t *ch;
+	int ret;
+
+	pthread_mutex_lock(&pwm_lock);
+	ch = pwm_channel(handle);
+	if (ch == NULL)
+	{
+		pthread_mutex_unlock(&pwm_lock);
+		return -1;
+	}
+	ret = pwm_write_value(ch, ch->enable_fd, on ? 1 : 0);
+	if (ret == 0)
+		ch->st.enabled = on ? 1 : 0;
+	pthread_mutex_unlock(&pwm_lock);
+	return ret;
+}
+
+int pwm_get_status(int handle, pwm_status_t *status)
+{
+	pwm_channel_t *ch;
+
+	pthread_mutex_lock(&pwm_lock);
+	ch = pwm_channel(handle);
+	if (ch)
+		*status = ch->st;
+	pthread_mutex_unlock(&pwm_lock);
+	return ch ? 0 : -1;
+}
+
+// 关闭输出并释放通道；由本程序导出的通道同时 unexport
+void pwm_close(int handle)
+{
+	char path[256];
+	pwm_channel_t *ch;
+
+	pthread_mutex_lock(&pwm_lock);
+	ch = pwm_channel(handle);
+	if (ch)
+	{
+		pwm_write_value(ch, ch->enable_fd, 0);
+		pwm_close_fds(ch);
+		if (ch->exported)
+		{
+			snprintf(path, sizeof(path), "%s/pwmchip%d/unexport", pwm_get_root(), ch->st.chip);
+			pwm_write_file(path, ch->st.channel);
+		}
+		ch->used = 0;
+	}
+	pthread_mutex_unlock(&pwm_lock);
+}
+
+void pwm_close_all(void)
+{
+	int handle;
+
+	for (handle = 0; handle < PWM_MAX_CHANNELS; handle++)
+		pwm_close(handle);
+}
@@ -0,0 +1,38 @@
+#ifndef __PWM_H
+#define __PWM_H
+
+#include <stdint.h>
+
+// sysfs 根目录，可用环境变量 PWM_SYSFS_ROOT 或 --pwm-root 指向临时目录离线验证
+#define PWM_SYSFS_ROOT "/sys/class/pwm"
+#define PWM_MAX_CHANNELS 4
+#define PWM_EXPORT_TIMEOUT_MS 100 // export 后等待 pwmN 目录出现的最长时间
+#define PWM_DEFAULT_PERIOD_NS 1000000 // 1kHz
+
+// 主PWM输出（原 pwmchip0/pwm0）
+#define PWM_MAIN_CHIP 0
+#define PWM_MAIN_CHANNEL 0
+
+typedef struct
+{
+	int chip;
+	int channel;
+	uint32_t period_ns;
+	uint32_t duty_ns;
+	int duty_percent;
+	int enabled;
+	uint64_t writes;       // pwrite 次数
+	uint64_t write_ns_max; // 单次 pwrite 最长耗时
+} pwm_status_t;
+
+void pwm_set_root(const char *root);
+const char *pwm_get_root(void);
+int pwm_open(int chip, int channel);
+int pwm_set_period(int handle, uint32_t period_ns);
+int pwm_set_percent(int handle, int duty_percent);
+int pwm_enable(int handle, int on);
+int pwm_get_status(int handle, pwm_status_t *status);
+void pwm_close(int handle);
+void pwm_close_all(void);
+
+#endif
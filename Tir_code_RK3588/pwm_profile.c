@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "motor.h"
+#include "pwm_profile.h"
+
+/*
+ * PWM 曲线引擎
+ * 调用者用 pwm_profile_start() 提交一条曲线（斜坡、保持、脉冲串）后立即返回，
+ * 事件循环在新曲线提交（pwm_profile_fd() 可读）或定时器到期时调用 pwm_profile_poll()，
+ * 按绝对时间计算每个通道当前应有的占空比，只在占空比变化时写 sysfs，
+ * 并返回下一个更新时刻用于设置定时器。
+ * 曲线结束时调用 Motor_Done_Notify() 唤醒 process_task，配方步骤据此判断完成。
+ */
+
+typedef struct
+{
+	pwm_profile_t profile;
+	int active;
+	int seg;
+	uint64_t seg_start_ns;
+	int from;             // 当前段开始时的占空比
+	int duty;             // 最近写入的占空比，-1 表示未知
+	uint64_t next_ns;     // 下一次更新的计划时间
+	uint32_t seq;         // 最近提交的曲线编号
+	uint32_t done_seq;    // 最近结束的曲线编号
+	uint64_t done_ns;
+	pwm_profile_stats_t stats;
+} pwm_engine_t;
+
+static pwm_engine_t engines[PWM_MAX_CHANNELS];
+static pthread_mutex_t engine_lock = PTHREAD_MUTEX_INITIALIZER;
+static int wake_fd = -1;
+
+static int parse_uint(const char **p, uint32_t *value)
+{
+	char *end;
+	unsigned long v = strtoul(*p, &end, 10);
+
+	if (end == *p || **p == '-')
+		return -1;
+	*value = (uint32_t)v;
+	*p = end;
+	return 0;
+}
+
+// 解析 ":a:b..."，返回读到的数值个数
+static int parse_args(const char *p, uint32_t *args, int max)
+{
+	int n = 0;
+
+	while (*p == ':' && n < max)
+	{
+		p++;
+		if (parse_uint(&p, &args[n]) < 0)
+			return -1;
+		n++;
+	}
+	return *p == '\0' ? n : -1;
+}
+
+/*
+ * @description : 解析曲线文本，段之间用逗号分隔
+ *                RAMP:80:300 在300ms内变到80%，SET:80 直接设置，HOLD:1000 保持1s，
+ *                BURST:80:50:50:10 10个脉冲，80%保持50ms、0保持50ms
+ * @return : 段数，-1 表示格式错误
+ */
+int pwm_profile_parse(const char *text, pwm_profile_t *profile)
+{
+	char buf[128], *item, *save;
+
+	memset(profile, 0, sizeof(*profile));
+	if (snprintf(buf, sizeof(buf), "%s", text) >= (int)sizeof(buf))
+		return -1;
+
+	for (item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save))
+	{
+		pwm_segment_t *seg = &profile->seg[profile->count];
+		size_t len = strcspn(item, ":");
+		uint32_t args[4] = {0};
+		int n = parse_args(item + len, args, 4);
+
+		if (profile->count >= PWM_PROFILE_MAX_SEGS || n < 0)
+			return -1;
+		if (len == 4 && strncasecmp(item, "RAMP", 4) == 0 && n == 2)
+		{
+			seg->type = PWM_SEG_RAMP;
+			seg->ms = args[1];
+		}
+		else if (len == 3 && strncasecmp(item, "SET", 3) == 0 && n == 1)
+		{
+			seg->type = PWM_SEG_RAMP;
+		}
+		else if (len == 4 && strncasecmp(item, "HOLD", 4) == 0 && n == 1)
+		{
+			seg->type = PWM_SEG_HOLD;
+			seg->ms = args[0];
+			args[0] = 0;
+		}
+		else if (len == 5 && strncasecmp(item, "BURST", 5) == 0 && n == 4 && args[3] > 0 && args[1] + args[2] > 0)
+		{
+			seg->type = PWM_SEG_BURST;
+			seg->ms = args[1];
+			seg->off_ms = args[2];
+			seg->count = args[3] > 65535 ? 65535 : args[3];
+		}
+		else
+		{
+			return -1;
+		}
+		if (args[0] > 100)
+			return -1;
+		seg->duty = args[0];
+		profile->count++;
+	}
+	return profile->count > 0 ? profile->count : -1;
+}
+
+// 单段斜坡：ms 内从当前占空比变到 duty
+void pwm_profile_ramp(pwm_profile_t *profile, int duty, uint32_t ms)
+{
+	memset(profile, 0, sizeof(*profile));
+	profile->seg[0].type = PWM_SEG_RAMP;
+	profile->seg[0].duty = duty < 0 ? 0 : duty > 100 ? 100 : duty;
+	profile->seg[0].ms = ms;
+	profile->count = 1;
+}
+
+static uint64_t seg_duration_ns(const pwm_segment_t *seg)
+{
+	if (seg->type == PWM_SEG_BURST)
+		return (uint64_t)seg->count * (seg->ms + seg->off_ms) * 1000000ull;
+	return seg->ms * 1000000ull;
+}
+
+uint32_t pwm_profile_duration_ms(const pwm_profile_t *profile)
+{
+	uint64_t ns = 0;
+	int i;
+
+	for (i = 0; i < profile->count; i++)
+		ns += seg_duration_ns(&profile->seg[i]);
+	return (uint32_t)(ns / 1000000ull);
+}
+
+// 段结束时的占空比
+static int seg_end_duty(const pwm_segment_t *seg, int from)
+{
+	switch (seg->type)
+	{
+	case PWM_SEG_RAMP:
+		return seg->duty;
+	case PWM_SEG_BURST:
+		return 0;
+	default:
+		return from;
+	}
+}
+
+int pwm_profile_init(void)
+{
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0)
+	{
+		printf("PWM profile: eventfd failed, polling every %llu ms\n", PWM_PROFILE_TICK_NS / 1000000ull);
+		return -1;
+	}
+	return 0;
+}
+
+static void engine_kick(void)
+{
+	uint64_t one = 1;
+
+	if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		perror("pwm_profile: eventfd");
+}
+
+/*
+ * @description : 提交一条曲线，替换该通道上正在执行的曲线，不等待执行
+ * @param - handle : pwm_open() 返回的句柄
+ * @return : 曲线编号（>0），用于 pwm_profile_done()；0 表示失败
+ */
+uint32_t pwm_profile_start(int handle, const pwm_profile_t *profile)
+{
+	pwm_status_t st;
+	pwm_engine_t *e;
+	uint32_t seq;
+
+	if (handle < 0 || handle >= PWM_MAX_CHANNELS || profile->count <= 0 || pwm_get_status(handle, &st) < 0)
+		return 0;
+
+	pthread_mutex_lock(&engine_lock);
+	e = &engines[handle];
+	if (e->active)
+		e->stats.aborted++;
+	e->profile = *profile;
+	e->active = 1;
+	e->seg = 0;
+	e->seg_start_ns = monotonic_ns();
+	e->from = st.duty_percent;
+	e->duty = st.duty_percent;
+	e->next_ns = e->seg_start_ns;
+	seq = ++e->seq;
+	e->stats.started++;
+	pthread_mutex_unlock(&engine_lock);
+
+	engine_kick();
+	return seq;
+}
+
+// 停止曲线，占空比保持在当前值
+void pwm_profile_stop(int handle)
+{
+	if (handle < 0 || handle >= PWM_MAX_CHANNELS)
+		return;
+	pthread_mutex_lock(&engine_lock);
+	if (engines[handle].active)
+	{
+		engines[handle].active = 0;
+		engines[handle].stats.aborted++;
+	}
+	pthread_mutex_unlock(&engine_lock);
+}
+
+/*
+ * @description : 曲线 seq 是否已结束（完成或被后来的曲线替换）
+ * @param - done_ns : 结束时间，被替换时为当前时间
+ */
+int pwm_profile_done(int handle, uint32_t seq, uint64_t *done_ns)
+{
+	pwm_engine_t *e;
+	int done;
+
+	if (handle < 0 || handle >= PWM_MAX_CHANNELS)
+		return 1;
+	pthread_mutex_lock(&engine_lock);
+	e = &engines[handle];
+	done = !e->active || e->seq != seq;
+	if (done_ns)
+		*done_ns = e->done_seq == seq ? e->done_ns : monotonic_ns();
+	pthread_mutex_unlock(&engine_lock);
+	return done;
+}
+
+static void engine_write(int handle, pwm_engine_t *e, int duty)
+{
+	if (duty == e->duty)
+		return;
+	if (pwm_set_percent(handle, duty) == 0)
+	{
+		e->duty = duty;
+		e->stats.updates++;
+	}
+}
+
+// 推进一个通道，返回下一次更新时间，曲线结束时返回0
+static uint64_t engine_step(int handle, pwm_engine_t *e, uint64_t now)
+{
+	while (e->active)
+	{
+		const pwm_segment_t *seg = &e->profile.seg[e->seg];
+		uint64_t dur = seg_duration_ns(seg);
+		uint64_t t, end = e->seg_start_ns + dur;
+		int duty;
+
+		if (now >= end)
+		{
+			// 段结束，下一段从本段的计划结束时间开始，不累计调度误差
+			e->from = seg_end_duty(seg, e->from);
+			e->seg_start_ns = end;
+			if (++e->seg < e->profile.count)
+				continue;
+			engine_write(handle, e, e->from);
+			e->active = 0;
+			e->done_seq = e->seq;
+			e->done_ns = now;
+			e->stats.completed++;
+			return 0;
+		}
+
+		t = now - e->seg_start_ns;
+		if (seg->type == PWM_SEG_RAMP)
+		{
+			duty = e->from + (int)(((int64_t)seg->duty - e->from) * (int64_t)t / (int64_t)dur);
+			e->next_ns = e->seg_start_ns + (t / PWM_PROFILE_TICK_NS + 1) * PWM_PROFILE_TICK_NS;
+		}
+		else if (seg->type == PWM_SEG_BURST)
+		{
+			uint64_t period = (seg->ms + seg->off_ms) * 1000000ull;
+			uint64_t phase = t % period;
+			uint64_t on = seg->ms * 1000000ull;
+
+			duty = phase < on ? seg->duty : 0;
+			e->next_ns = e->seg_start_ns + (t - phase) + (phase < on ? on : period);
+		}
+		else
+		{
+			duty = e->from;
+			e->next_ns = end;
+		}
+		if (e->next_ns > end)
+			e->next_ns = end;
+		engine_write(handle, e, duty);
+		return e->next_ns;
+	}
+	return 0;
+}
+
+/*
+ * @description : 推进所有通道的曲线，由 pwm_task 调用
+ * @return : 最早的下一次更新时间，0 表示没有曲线在执行
+ */
+uint64_t pwm_profile_poll(uint64_t now)
+{
+	uint64_t next = 0;
+	int finished = 0;
+	int handle;
+
+	pthread_mutex_lock(&engine_lock);
+	for (handle = 0; handle < PWM_MAX_CHANNELS; handle++)
+	{
+		pwm_engine_t *e = &engines[handle];
+		uint64_t d;
+
+		if (!e->active)
+			continue;
+		if (now > e->next_ns && now - e->next_ns > e->stats.late_ns_max)
+			e->stats.late_ns_max = now - e->next_ns;
+		d = engine_step(handle, e, now);
+		if (d == 0)
+			finished = 1;
+		else if (next == 0 || d < next)
+			next = d;
+	}
+	pthread_mutex_unlock(&engine_lock);
+
+	// 唤醒 process_task，等待曲线结束的配方步骤可以完成
+	if (finished)
+		Motor_Done_Notify();
+	return next;
+}
+
+// 提交新曲线时可读的 eventfd，由事件循环监听；-1 表示不可用，需按 PWM_PROFILE_TICK_NS 轮询
+int pwm_profile_fd(void)
+{
+	return wake_fd;
+}
+
+int pwm_profile_get_stats(int handle, pwm_profile_stats_t *stats)
+{
+	pwm_engine_t *e;
+
+	if (handle < 0 || handle >= PWM_MAX_CHANNELS)
+		return -1;
+	pthread_mutex_lock(&engine_lock);
+	e = &engines[handle];
+	*stats = e->stats;
+	stats->active = e->active;
+	stats->segment = e->seg;
+	stats->duty = e->duty;
+	pthread_mutex_unlock(&engine_lock);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef __PWM_PROFILE_H
+#define __PWM_PROFILE_H
+
+#include <stdint.h>
+#include "pwm.h"
+
+#define PWM_PROFILE_MAX_SEGS 8
+#define PWM_PROFILE_TICK_NS 10000000ull  // 斜坡更新周期 10ms，占空比不变时不写 sysfs
+
+// 曲线段，从上一段结束时的占空比开始
+typedef enum
+{
+	PWM_SEG_RAMP = 0, // 在 ms 内线性变化到 duty，ms=0 为直接设置
+	PWM_SEG_HOLD,     // 保持当前占空比 ms
+	PWM_SEG_BURST,    // count 个脉冲：duty 保持 ms，0 保持 off_ms，结束时为 0
+} pwm_seg_type_t;
+
+typedef struct
+{
+	uint8_t type;    // pwm_seg_type_t
+	uint8_t duty;    // 0~100
+	uint16_t count;
+	uint32_t ms;
+	uint32_t off_ms;
+} pwm_segment_t;
+
+typedef struct
+{
+	pwm_segment_t seg[PWM_PROFILE_MAX_SEGS];
+	int count;
+} pwm_profile_t;
+
+typedef struct
+{
+	int active;
+	int segment;          // 正在执行的段
+	int duty;             // 最近写入的占空比
+	uint32_t started;
+	uint32_t completed;
+	uint32_t aborted;     // 被新曲线或手动设置打断
+	uint64_t updates;     // 占空比写入次数
+	uint64_t late_ns_max; // 更新时刻相对计划时间的最大延迟
+} pwm_profile_stats_t;
+
+int pwm_profile_parse(const char *text, pwm_profile_t *profile);
+void pwm_profile_ramp(pwm_profile_t *profile, int duty, uint32_t ms);
+uint32_t pwm_profile_duration_ms(const pwm_profile_t *profile);
+int pwm_profile_init(void);
+uint32_t pwm_profile_start(int handle, const pwm_profile_t *profile);
+void pwm_profile_stop(int handle);
+int pwm_profile_done(int handle, uint32_t seq, uint64_t *done_ns);
+uint64_t pwm_profile_poll(uint64_t now);
+int pwm_profile_fd(void);
+int pwm_profile_get_stats(int handle, pwm_profile_stats_t *stats);
+
+#endif
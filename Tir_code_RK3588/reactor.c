@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "motor.h"
+#include "reactor.h"
+
+/*
+ * epoll 事件循环
+ * 串口、控制台、PWM曲线和状态打印共用一个线程，只在 fd 有事件时醒来：
+ * 普通 fd 由回调自己读取，eventfd/timerfd 由事件循环读空计数后再回调；
+ * 定时器用 timerfd 的绝对时间（CLOCK_MONOTONIC，与 monotonic_ns() 相同）。
+ * reactor_stop() 只写 eventfd，可以在信号处理函数中调用。
+ */
+
+typedef struct
+{
+	int fd;
+	int counter; // 1：eventfd/timerfd，回调前读空
+	int timer;   // 1：由 reactor_add_timer 创建，reactor_close 时关闭
+	reactor_cb_t cb;
+	void *ctx;
+} reactor_source_t;
+
+static int epoll_fd = -1;
+static volatile int stop_fd = -1;
+static reactor_source_t sources[REACTOR_MAX_SOURCES];
+// 统计只在事件循环线程内更新和读取
+static reactor_stats_t stats;
+
+int reactor_init(void)
+{
+	struct epoll_event ev = {.events = EPOLLIN, .data.u32 = REACTOR_MAX_SOURCES};
+	int fd;
+
+	memset(&stats, 0, sizeof(stats));
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0)
+	{
+		perror("reactor_init: epoll_create1");
+		return -1;
+	}
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+	{
+		perror("reactor_init: eventfd");
+		if (fd >= 0)
+			close(fd);
+		close(epoll_fd);
+		epoll_fd = -1;
+		return -1;
+	}
+	stop_fd = fd;
+	return 0;
+}
+
+/*
+ * @description : 注册一个 fd
+ * @param - events : EPOLLIN 等，EPOLLERR/EPOLLHUP 总会报告
+ * @param - name   : 统计中显示的名称
+ * @return : 0 成功，-1 失败（例如普通文件不支持 epoll，errno 为 EPERM）
+ */
+int reactor_add_fd(int fd, uint32_t events, reactor_cb_t cb, void *ctx, const char *name)
+{
+	struct epoll_event ev = {.events = events};
+	int i = stats.count;
+
+	if (i >= REACTOR_MAX_SOURCES)
+	{
+		errno = ENOSPC;
+		return -1;
+	}
+	ev.data.u32 = i;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -1;
+	sources[i] = (reactor_source_t){.fd = fd, .cb = cb, .ctx = ctx};
+	snprintf(stats.source[i].name, sizeof(stats.source[i].name), "%s", name);
+	stats.count++;
+	return 0;
+}
+
+// 注册 eventfd 之类的计数 fd，回调前读空
+int reactor_add_counter(int fd, reactor_cb_t cb, void *ctx, const char *name)
+{
+	if (reactor_add_fd(fd, EPOLLIN, cb, ctx, name) < 0)
+		return -1;
+	sources[stats.count - 1].counter = 1;
+	return 0;
+}
+
+/*
+ * @description : 创建一个未启动的定时器，用 reactor_timer_arm() 设置触发时间
+ * @return : timerfd，-1 表示失败
+ */
+int reactor_add_timer(reactor_cb_t cb, void *ctx, const char *name)
+{
+	int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (tfd < 0)
+		return -1;
+	if (reactor_add_counter(tfd, cb, ctx, name) < 0)
+	{
+		close(tfd);
+		return -1;
+	}
+	sources[stats.count - 1].timer = 1;
+	return tfd;
+}
+
+// 在绝对时间 deadline_ns 触发一次，0 取消；已过去的时间立即触发
+int reactor_timer_arm(int tfd, uint64_t deadline_ns)
+{
+	struct itimerspec its = {0};
+
+	if (tfd < 0)
+		return -1;
+	// it_value 全为0表示取消
+	its.it_value.tv_sec = deadline_ns / 1000000000ull;
+	its.it_value.tv_nsec = deadline_ns % 1000000000ull;
+	return timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// 注销 fd，不关闭；用于 EOF 之后的 stdin 等
+void reactor_del_fd(int fd)
+{
+	int i;
+
+	for (i = 0; i < stats.count; i++)
+	{
+		if (sources[i].fd == fd && sources[i].cb)
+		{
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+			sources[i].cb = NULL;
+		}
+	}
+}
+
+static void reactor_dispatch(reactor_source_t *src, reactor_source_stats_t *st, uint32_t events)
+{
+	uint64_t count, t0, dt;
+
+	if (src->cb == NULL)
+		return;
+	if (src->counter && read(src->fd, &count, sizeof(count)) < 0 && errno == EAGAIN)
+		return; // 计数已被别处读走（例如定时器重新设置）
+	t0 = monotonic_ns();
+	src->cb(src->fd, events, src->ctx);
+	dt = monotonic_ns() - t0;
+	st->events++;
+	if (dt > st->handler_ns_max)
+		st->handler_ns_max = dt;
+}
+
+// 执行事件循环，直到 reactor_stop()
+void reactor_run(void)
+{
+	struct epoll_event ev[REACTOR_MAX_EVENTS];
+	int n, i;
+
+	for (;;)
+	{
+		n = epoll_wait(epoll_fd, ev, REACTOR_MAX_EVENTS, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("reactor_run: epoll_wait");
+			return;
+		}
+		stats.wakeups++;
+		for (i = 0; i < n; i++)
+		{
+			uint32_t k = ev[i].data.u32;
+			if (k == REACTOR_MAX_SOURCES)
+				return;
+			reactor_dispatch(&sources[k], &stats.source[k], ev[i].events);
+		}
+	}
+}
+
+// 让 reactor_run() 返回；只写 eventfd，可在信号处理函数中调用
+void reactor_stop(void)
+{
+	uint64_t one = 1;
+	int fd = stop_fd;
+	ssize_t ret;
+
+	// 写失败只可能是计数溢出，说明已经请求过停止
+	if (fd >= 0)
+	{
+		ret = write(fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+// 关闭 epoll 和定时器，注册的其他 fd 由调用者关闭
+void reactor_close(void)
+{
+	int fd = stop_fd;
+	int i;
+
+	for (i = 0; i < stats.count; i++)
+	{
+		if (sources[i].timer)
+			close(sources[i].fd);
+	}
+	stop_fd = -1;
+	if (fd >= 0)
+		close(fd);
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	epoll_fd = -1;
+}
+
+void reactor_get_stats(reactor_stats_t *out)
+{
+	*out = stats;
+}
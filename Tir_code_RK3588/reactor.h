@@ -0,0 +1,38 @@
+#ifndef __REACTOR_H
+#define __REACTOR_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#define REACTOR_MAX_SOURCES 16
+#define REACTOR_MAX_EVENTS 8 // 一次 epoll_wait 取回的最大事件数
+
+// fd 可读/出错时调用；计数类 fd（eventfd、timerfd）在回调前已读空
+typedef void (*reactor_cb_t)(int fd, uint32_t events, void *ctx);
+
+typedef struct
+{
+	char name[16];
+	uint64_t events;         // 回调次数
+	uint64_t handler_ns_max; // 单次回调最长耗时
+} reactor_source_stats_t;
+
+typedef struct
+{
+	uint64_t wakeups; // epoll_wait 返回次数
+	int count;
+	reactor_source_stats_t source[REACTOR_MAX_SOURCES];
+} reactor_stats_t;
+
+int reactor_init(void);
+int reactor_add_fd(int fd, uint32_t events, reactor_cb_t cb, void *ctx, const char *name);
+int reactor_add_counter(int fd, reactor_cb_t cb, void *ctx, const char *name);
+int reactor_add_timer(reactor_cb_t cb, void *ctx, const char *name);
+int reactor_timer_arm(int tfd, uint64_t deadline_ns);
+void reactor_del_fd(int fd);
+void reactor_run(void);
+void reactor_stop(void);
+void reactor_close(void);
+void reactor_get_stats(reactor_stats_t *stats);
+
+#endif
@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "motor.h"
+#include "task.h"
+#include "recipe.h"
+
+/*
+ * 工艺配方引擎
+ * 配方在启动时解析为步骤表，每步声明占用的资源（轴、泵、PWM），
+ * 与前面某步占用相同资源的步骤要等那一步完成，互不相干的步骤同时执行。
+ * 每个样品是配方的一次执行（recipe_run_t），由 sample.c 调度，
+ * 在电机到位通知后调用 recipe_run_poll() 推进：
+ * 依赖完成 -> 等待 -> 泵/PWM曲线 -> 协调运动 -> 所有轴到位且PWM曲线结束。
+ */
+
+// recipe.txt 不存在或解析失败时使用的内置配方，构建时由 recipe.txt 生成（见 makefile）
+static const char builtin_recipe[] =
+#include "recipe_builtin.h"
+	;
+
+// 已加载的配方表，追加后只读；recipe_count 发布后其中的配方可被 process_task 使用
+static recipe_t recipes[RECIPE_MAX_RECIPES];
+static int recipe_count = 0;
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 最近完成的一次循环，print_task 读取
+static recipe_stats_t last_stats;
+static char last_name[16];
+static const recipe_t *last_recipe;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+	return s;
+}
+
+// 解析 HOLD= 的资源列表，例如 A,B,PUMP
+static int parse_resources(char *list, uint8_t *res)
+{
+	char *name, *save;
+
+	for (name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save))
+	{
+		if (strlen(name) == 1 && name[0] >= 'A' && name[0] < 'A' + STEP_AXES)
+			*res |= RECIPE_RES_AXIS(name[0] - 'A');
+		else if (strcasecmp(name, "PUMP") == 0)
+			*res |= RECIPE_RES_PUMP | RECIPE_RES_AXIS(Motor_D);
+		else if (strcasecmp(name, "PWM") == 0)
+			*res |= RECIPE_RES_PWM;
+		else
+			return -1;
+	}
+	return 0;
+}
+
+// 解析一个 KEY=VALUE 字段，返回0成功
+static int parse_field(recipe_step_t *step, char *field)
+{
+	char *value = strchr(field, '=');
+	char *end;
+
+	if (value == NULL)
+	{
+		// SYNC：等前面所有步骤完成，后面所有步骤等它完成
+		if (strcasecmp(field, "SYNC") != 0)
+			return -1;
+		step->res = RECIPE_RES_ALL;
+		return 0;
+	}
+	*value++ = '\0';
+
+	if (strlen(field) == 1 && field[0] >= 'A' && field[0] < 'A' + STEP_AXES)
+	{
+		int axis = field[0] - 'A';
+		step->target[axis] = strtof(value, &end);
+		if (end == value || *end != '\0' || step->target[axis] < 0)
+			return -1;
+		step->mask |= 1u << axis;
+		return 0;
+	}
+	if (strcasecmp(field, "PUMP") == 0)
+	{
+		if (strcasecmp(value, "ON") == 0 || strcmp(value, "1") == 0)
+			step->pump = 1;
+		else if (strcasecmp(value, "OFF") == 0 || strcmp(value, "0") == 0)
+			step->pump = 0;
+		else
+			return -1;
+		return 0;
+	}
+	if (strcasecmp(field, "PWM") == 0)
+	{
+		long duty = strtol(value, &end, 10);
+		if (end == value || *end != '\0' || duty < 0 || duty > 100)
+			return -1;
+		step->pwm = (int16_t)duty;
+		return 0;
+	}
+	if (strcasecmp(field, "RAMP") == 0)
+	{
+		long ms = strtol(value, &end, 10);
+		if (end == value || *end != '\0' || ms < 0)
+			return -1;
+		step->pwm_ramp_ms = (uint32_t)ms;
+		return 0;
+	}
+	if (strcasecmp(field, "PROFILE") == 0)
+		return pwm_profile_parse(value, &step->pwm_profile) < 0 ? -1 : 0;
+	if (strcasecmp(field, "WAIT") == 0)
+	{
+		long ms = strtol(value, &end, 10);
+		if (end == value || *end != '\0' || ms < 0)
+			return -1;
+		step->wait_ms = (uint32_t)ms;
+		return 0;
+	}
+	if (strcasecmp(field, "HOLD") == 0)
+		return parse_resources(value, &step->res);
+	return -1;
+}
+
+/*
+ * @description : 把配方文本解析为步骤表并建立依赖关系
+ * @param - text   : 配方文本，每行一个步骤
+ * @param - source : 来源名称，用于打印
+ * @return : 步骤数，<0 表示解析失败（已打印出错行）
+ */
+int recipe_parse(recipe_t *r, const char *text, const char *source)
+{
+	char line[256];
+	const char *p = text;
+	int lineno = 0;
+	int i;
+
+	memset(r, 0, sizeof(*r));
+	snprintf(r->source, sizeof(r->source), "%s", source);
+
+	while (*p)
+	{
+		size_t len = strcspn(p, "\n");
+		char *comment, *body, *field, *save;
+		recipe_step_t *step;
+
+		lineno++;
+		if (len >= sizeof(line))
+		{
+			printf("Recipe %s:%d: line too long\n", source, lineno);
+			return -1;
+		}
+		memcpy(line, p, len);
+		line[len] = '\0';
+		p += len;
+		if (*p == '\n')
+			p++;
+
+		comment = strchr(line, '#');
+		if (comment)
+			*comment++ = '\0';
+		body = trim(line);
+		if (*body == '\0')
+			continue;
+
+		if (r->count >= RECIPE_MAX_STEPS)
+		{
+			printf("Recipe %s:%d: more than %d steps\n", source, lineno, RECIPE_MAX_STEPS);
+			return -1;
+		}
+		step = &r->step[r->count];
+		memset(step, 0, sizeof(*step));
+		step->pump = -1;
+		step->pwm = -1;
+		if (comment)
+			snprintf(step->label, sizeof(step->label), "%s", trim(comment));
+
+		for (field = strtok_r(body, " \t\r", &save); field; field = strtok_r(NULL, " \t\r", &save))
+		{
+			if (parse_field(step, field) < 0)
+			{
+				printf("Recipe %s:%d: invalid field '%s'\n", source, lineno, field);
+				return -1;
+			}
+		}
+		if (step->pump >= 0 && (step->mask & RECIPE_RES_AXIS(Motor_D)))
+		{
+			printf("Recipe %s:%d: PUMP and D share the same pins\n", source, lineno);
+			return -1;
+		}
+		if (step->pwm >= 0 && step->pwm_profile.count > 0)
+		{
+			printf("Recipe %s:%d: PWM and PROFILE are exclusive\n", source, lineno);
+			return -1;
+		}
+		if (step->pwm >= 0)
+			pwm_profile_ramp(&step->pwm_profile, step->pwm, step->pwm_ramp_ms);
+		if (step->res == RECIPE_RES_ALL && step->label[0] == '\0')
+			snprintf(step->label, sizeof(step->label), "SYNC");
+
+		step->res |= step->mask;
+		if (step->pump >= 0)
+			step->res |= RECIPE_RES_PUMP | RECIPE_RES_AXIS(Motor_D);
+		if (step->pwm_profile.count > 0)
+			step->res |= RECIPE_RES_PWM;
+		// 什么都不占用的步骤（只有 WAIT）按顺序执行，相当于 SYNC 后等待
+		if (step->res == 0)
+			step->res = RECIPE_RES_ALL;
+
+		for (i = 0; i < r->count; i++)
+		{
+			if (r->step[i].res & step->res)
+				step->deps |= 1ull << i;
+		}
+		r->count++;
+	}
+	return r->count;
+}
+
+static char *read_file(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char *buf;
+	long size;
+
+	if (fp == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0)
+	{
+		fclose(fp);
+		return NULL;
+	}
+	buf = malloc(size + 1);
+	if (buf && fread(buf, 1, size, fp) != (size_t)size)
+	{
+		free(buf);
+		buf = NULL;
+	}
+	if (buf)
+		buf[size] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+// 把配方放到配方表中，返回编号
+static int recipe_add(const char *text, const char *source)
+{
+	int n = recipe_count;
+
+	if (n >= RECIPE_MAX_RECIPES)
+	{
+		printf("Recipe table full, %s not loaded\n", source);
+		return -1;
+	}
+	if (recipe_parse(&recipes[n], text, source) <= 0)
+		return -1;
+	__atomic_store_n(&recipe_count, n + 1, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * @description : 启动时加载默认配方（0号）；path 为 NULL 时读取 recipe.txt
+ *                文件不存在或有错误时使用内置配方
+ * @return : 步骤数
+ */
+int recipe_init(const char *path)
+{
+	const char *file = path ? path : RECIPE_DEFAULT_FILE;
+	char *text = read_file(file);
+	int idx = -1;
+
+	pthread_mutex_lock(&load_mutex);
+	if (text == NULL)
+	{
+		printf("Recipe file %s not found, using built-in recipe\n", file);
+	}
+	else
+	{
+		idx = recipe_add(text, file);
+		free(text);
+		if (idx >= 0)
+			printf("Recipe loaded from %s: %d steps\n", file, recipes[idx].count);
+		else
+			printf("Recipe %s rejected, using built-in recipe\n", file);
+	}
+	if (idx < 0)
+		idx = recipe_add(builtin_recipe, "built-in");
+	pthread_mutex_unlock(&load_mutex);
+	return idx < 0 ? -1 : recipes[idx].count;
+}
+
+/*
+ * @description : 按文件名加载配方，已加载过的直接返回原编号
+ * @param - path : 配方文件，NULL 表示默认配方
+ * @return : 配方编号，-1 表示加载失败
+ */
+int recipe_load(const char *path)
+{
+	char *text;
+	int i, idx = -1;
+
+	if (path == NULL)
+		return recipe_count > 0 ? 0 : -1;
+
+	pthread_mutex_lock(&load_mutex);
+	for (i = 0; i < recipe_count; i++)
+	{
+		if (strcmp(recipes[i].source, path) == 0)
+		{
+			pthread_mutex_unlock(&load_mutex);
+			return i;
+		}
+	}
+	text = read_file(path);
+	if (text == NULL)
+	{
+		printf("Recipe file %s not found\n", path);
+	}
+	else
+	{
+		idx = recipe_add(text, path);
+		free(text);
+		if (idx >= 0)
+			printf("Recipe loaded from %s: %d steps\n", path, recipes[idx].count);
+	}
+	pthread_mutex_unlock(&load_mutex);
+	return idx;
+}
+
+const recipe_t *recipe_get(int index)
+{
+	if (index < 0 || index >= __atomic_load_n(&recipe_count, __ATOMIC_ACQUIRE))
+		return NULL;
+	return &recipes[index];
+}
+
+static void print_step_name(const recipe_run_t *run, int idx)
+{
+	const recipe_step_t *step = &run->recipe->step[idx];
+
+	if (step->label[0])
+		printf("Recipe %s step %d (%s)", run->name, idx + 1, step->label);
+	else
+		printf("Recipe %s step %d", run->name, idx + 1);
+}
+
+// 执行步骤的泵、PWM和运动动作
+static void step_actions(recipe_run_t *run, int idx)
+{
+	const recipe_step_t *step = &run->recipe->step[idx];
+	double planned = 0;
+
+	if (step->pump >= 0)
+		Motor_Pump(step->pump);
+	// PWM 曲线交给 pwm_task 执行，不阻塞本线程；本步在曲线结束后才算完成
+	if (step->pwm_profile.count > 0)
+		run->step[idx].pwm_seq = pwm_start_profile(&step->pwm_profile);
+	if (step->mask)
+		planned = step_sched_move_coordinated(step->target, step->mask);
+	run->stats.step_planned[idx] = planned;
+	run->step[idx].state = STEP_MOVING;
+}
+
+// 动作提交之后再打印，不计入步骤之间的空闲时间
+static void print_step_started(const recipe_run_t *run, int idx)
+{
+	print_step_name(run, idx);
+	if (run->step[idx].state == STEP_WAIT)
+	{
+		printf(" waiting %u ms\n", run->recipe->step[idx].wait_ms);
+		return;
+	}
+	printf(" started, planned move %.3f s", run->stats.step_planned[idx]);
+	if (run->step[idx].pwm_seq)
+		printf(", PWM profile %u ms", pwm_profile_duration_ms(&run->recipe->step[idx].pwm_profile));
+	printf("\n");
+}
+
+// 依赖全部完成后开始一步，记录依赖完成到开始之间的空闲时间
+static void step_begin(recipe_run_t *run, int idx, uint64_t now)
+{
+	uint64_t deps = run->recipe->step[idx].deps;
+	uint64_t ready = run->start_ns;
+	double dead;
+	int i;
+
+	for (i = 0; i < idx; i++)
+	{
+		if ((deps & (1ull << i)) && run->step[i].done_ns > ready)
+			ready = run->step[i].done_ns;
+	}
+
+	run->step[idx].start_ns = now;
+	if (run->recipe->step[idx].wait_ms > 0)
+	{
+		run->step[idx].wait_until_ns = now + run->recipe->step[idx].wait_ms * 1000000ull;
+		run->step[idx].state = STEP_WAIT;
+	}
+	else
+	{
+		step_actions(run, idx);
+	}
+
+	// 依赖之外被其他样品占用资源而推迟的时间也计入空闲
+	now = monotonic_ns();
+	dead = deps && now > ready ? (now - ready) / 1e9 : 0;
+	run->stats.step_start[idx] = (run->step[idx].start_ns - run->start_ns) / 1e9;
+	run->stats.dead_time[idx] = dead;
+	run->stats.dead_total += dead;
+	if (dead > run->stats.dead_max)
+		run->stats.dead_max = dead;
+}
+
+// 本步的所有轴是否到位、PWM曲线是否结束，完成时 *done_ns 为最后一个动作的完成时间
+static int step_done(const recipe_run_t *run, int idx, uint64_t now, uint64_t *done_ns)
+{
+	motor *motors[STEP_AXES] = {&motor_data_A, &motor_data_B, &motor_data_C, &motor_data_D};
+	motor_state_t st;
+	uint64_t last = 0;
+	int i;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (!(run->recipe->step[idx].mask & (1u << i)))
+			continue;
+		Motor_Get_State(motors[i], &st);
+		if (st.State != 1)
+			return 0;
+		if (st.Done_ns > last)
+			last = st.Done_ns;
+	}
+	if (run->step[idx].pwm_seq)
+	{
+		uint64_t pwm_done;
+		if (!pwm_profile_finished(run->step[idx].pwm_seq, &pwm_done))
+			return 0;
+		if (pwm_done > last)
+			last = pwm_done;
+	}
+	// 没有运动的步骤（只有泵/PWM/等待）以当前时间为完成时间
+	*done_ns = last >= run->step[idx].start_ns ? last : now;
+	return 1;
+}
+
+static void step_finish(recipe_run_t *run, int idx, uint64_t done_ns)
+{
+	double elapsed = (done_ns - run->step[idx].start_ns) / 1e9;
+
+	run->step[idx].done_ns = done_ns;
+	run->step[idx].state = STEP_DONE;
+	run->done_set |= 1ull << idx;
+	run->stats.step_time[idx] = elapsed;
+	run->stats.serial_time += elapsed;
+	run->stats.steps++;
+	print_step_name(run, idx);
+	printf(" finished in %.3f s\n", elapsed);
+}
+
+/*
+ * @description : 开始一次配方循环，之后由 recipe_run_poll() 推进
+ * @param - name : 打印前缀
+ */
+void recipe_run_start(recipe_run_t *run, const recipe_t *recipe, const char *name, uint64_t now)
+{
+	memset(run, 0, sizeof(*run));
+	run->recipe = recipe;
+	run->start_ns = now;
+	snprintf(run->name, sizeof(run->name), "%s", name);
+	printf("Recipe %s cycle started (%s, %d steps)\n", run->name, recipe->source, recipe->count);
+}
+
+// 还未完成的步骤占用的资源，排在后面的循环不能使用
+uint8_t recipe_run_outstanding(const recipe_run_t *run)
+{
+	uint8_t res = 0;
+	int i;
+
+	for (i = 0; i < run->recipe->count; i++)
+	{
+		if (run->step[i].state != STEP_DONE)
+			res |= run->recipe->step[i].res;
+	}
+	return res;
+}
+
+// 正在等待或运动的步骤占用的资源
+uint8_t recipe_run_in_use(const recipe_run_t *run)
+{
+	uint8_t res = 0;
+	int i;
+
+	for (i = 0; i < run->recipe->count; i++)
+	{
+		if (run->step[i].state == STEP_WAIT || run->step[i].state == STEP_MOVING)
+			res |= run->recipe->step[i].res;
+	}
+	return res;
+}
+
+// 下一次需要推进的时间点，0 表示只等电机到位通知
+uint64_t recipe_run_deadline(const recipe_run_t *run)
+{
+	uint64_t next = 0;
+	int i;
+
+	for (i = 0; i < run->recipe->count; i++)
+	{
+		if (run->step[i].state == STEP_WAIT && (next == 0 || run->step[i].wait_until_ns < next))
+			next = run->step[i].wait_until_ns;
+	}
+	return next;
+}
+
+/*
+ * @description : 推进一次循环，在电机到位通知或等待到期后调用
+ *                反复扫描步骤表，直到没有步骤能再推进
+ * @param - blocked : 被其他循环占用的资源，使用这些资源的步骤暂不开始
+ * @return : 1 表示循环仍在进行，0 表示本次调用完成了整个循环
+ */
+int recipe_run_poll(recipe_run_t *run, uint8_t blocked, uint64_t now)
+{
+	const recipe_t *recipe = run->recipe;
+	uint64_t all = recipe->count >= 64 ? ~0ull : (1ull << recipe->count) - 1;
+	uint64_t done_ns;
+	int progress;
+	int i;
+
+	do
+	{
+		progress = 0;
+		for (i = 0; i < recipe->count; i++)
+		{
+			const recipe_step_t *step = &recipe->step[i];
+
+			switch (run->step[i].state)
+			{
+			case STEP_PENDING:
+				if ((step->deps & ~run->done_set) == 0 && !(step->res & blocked) &&
+					!(run->pause && step->res == RECIPE_RES_ALL))
+				{
+					step_begin(run, i, now);
+					print_step_started(run, i);
+					progress = 1;
+				}
+				break;
+			case STEP_WAIT:
+				if (now >= run->step[i].wait_until_ns)
+				{
+					step_actions(run, i);
+					print_step_started(run, i);
+					progress = 1;
+				}
+				break;
+			case STEP_MOVING:
+				if (step_done(run, i, now, &done_ns))
+				{
+					step_finish(run, i, done_ns);
+					progress = 1;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		now = monotonic_ns();
+	} while (progress && run->done_set != all);
+
+	if (run->done_set != all)
+		return 1;
+
+	run->stats.cycle_time = (now - run->start_ns) / 1e9;
+	pthread_mutex_lock(&stats_mutex);
+	last_stats.cycles++;
+	run->stats.cycles = last_stats.cycles;
+	last_stats = run->stats;
+	last_recipe = recipe;
+	snprintf(last_name, sizeof(last_name), "%s", run->name);
+	pthread_mutex_unlock(&stats_mutex);
+	printf("Recipe %s cycle finished in %.3f s (sequential %.3f s)\n",
+		   run->name, run->stats.cycle_time, run->stats.serial_time);
+	return 0;
+}
+
+// 最近完成的一次循环
+void recipe_get_stats(recipe_stats_t *out)
+{
+	pthread_mutex_lock(&stats_mutex);
+	*out = last_stats;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+// 打印最近完成的一次循环每步的启动时刻、实际/规划时间和等待依赖后的空闲时间
+void recipe_print_stats(void)
+{
+	const recipe_t *recipe;
+	recipe_stats_t st;
+	char name[16];
+	int i;
+
+	pthread_mutex_lock(&stats_mutex);
+	st = last_stats;
+	recipe = last_recipe;
+	memcpy(name, last_name, sizeof(name));
+	pthread_mutex_unlock(&stats_mutex);
+
+	if (recipe == NULL)
+	{
+		printf("Recipe: no cycle finished yet\n");
+		return;
+	}
+	printf("Recipe %s (%s): %d steps, cycles=%u, cycle %.3f s (sequential %.3f s), dead time total %.3f ms max %.3f ms\n",
+		   name, recipe->source, recipe->count, st.cycles, st.cycle_time, st.serial_time,
+		   st.dead_total * 1e3, st.dead_max * 1e3);
+	for (i = 0; i < recipe->count; i++)
+	{
+		const recipe_step_t *step = &recipe->step[i];
+
+		if (step->label[0])
+			printf("  step %d (%s)", i + 1, step->label);
+		else
+			printf("  step %d", i + 1);
+		printf(": +%.3f s, %.3f s (move planned %.3f s, dead %.1f us)\n",
+			   st.step_start[i], st.step_time[i], st.step_planned[i], st.dead_time[i] * 1e6);
+	}
+}
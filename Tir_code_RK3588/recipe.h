@@ -0,0 +1,100 @@
+#ifndef __RECIPE_H
+#define __RECIPE_H
+
+#include <stdint.h>
+#include "step_sched.h"
+#include "pwm_profile.h"
+
+#define RECIPE_DEFAULT_FILE "recipe.txt"
+#define RECIPE_MAX_STEPS 64
+#define RECIPE_LABEL_LEN 32
+#define RECIPE_MAX_RECIPES 4 // 同时加载的配方数，0号为启动时加载的默认配方
+
+// 步骤占用的资源：bit0~bit3 为 A~D 轴，之后是泵和PWM
+// 泵接在D轴驱动器的EN和PUL上，占用泵同时占用D轴
+#define RECIPE_RES_AXIS(i) (1u << (i))
+#define RECIPE_RES_PUMP (1u << STEP_AXES)
+#define RECIPE_RES_PWM (1u << (STEP_AXES + 1))
+#define RECIPE_RES_ALL ((1u << (STEP_AXES + 2)) - 1)
+
+// 步骤动作：未设置的字段为 -1
+typedef struct
+{
+	float target[STEP_AXES]; // 轴目标圈数，mask 中的轴有效
+	uint8_t mask;            // 本步需要运动的轴，bit0~bit3 对应 A~D
+	int8_t pump;             // 泵（D轴EN+PUL）1开 0关
+	int16_t pwm;             // PWM 占空比 0~100
+	uint32_t pwm_ramp_ms;    // PWM 变化的斜坡时间，0 为直接设置
+	pwm_profile_t pwm_profile; // 由 PWM=/RAMP= 或 PROFILE= 生成，count 为0表示不改变PWM
+	uint32_t wait_ms;        // 执行动作前的等待时间
+	uint8_t res;             // 占用的资源，RECIPE_RES_*
+	uint64_t deps;           // 必须先完成的步骤，bit i 对应第 i 步
+	char label[RECIPE_LABEL_LEN];
+} recipe_step_t;
+
+typedef struct
+{
+	recipe_step_t step[RECIPE_MAX_STEPS];
+	int count;
+	char source[64]; // 文件名或 "built-in"
+} recipe_t;
+
+// 一次循环的计时
+typedef struct
+{
+	uint32_t cycles;      // 完成的循环数（仅 recipe_get_stats 返回的汇总有效）
+	int steps;            // 已完成的步骤数
+	double step_time[RECIPE_MAX_STEPS];    // 每步实际耗时 s（含等待）
+	double step_planned[RECIPE_MAX_STEPS]; // 每步规划的运动时间 s
+	double cycle_time;    // 循环总时间 s
+	double serial_time;   // 各步耗时之和，即按顺序执行所需时间 s
+	double step_start[RECIPE_MAX_STEPS]; // 每步相对循环开始的启动时间 s
+	double dead_time[RECIPE_MAX_STEPS];  // 依赖的步骤全部完成到本步开始的空闲时间 s
+	double dead_max;      // 最大空闲时间 s
+	double dead_total;    // 空闲时间合计 s
+} recipe_stats_t;
+
+typedef enum
+{
+	STEP_PENDING = 0, // 等待依赖的步骤完成
+	STEP_WAIT,        // 步骤开头的等待
+	STEP_MOVING,      // 等待本步所有轴到位
+	STEP_DONE,
+} recipe_step_state_t;
+
+typedef struct
+{
+	recipe_step_state_t state;
+	uint64_t start_ns;
+	uint64_t wait_until_ns;
+	uint64_t done_ns;
+	uint32_t pwm_seq;     // 本步提交的PWM曲线，0 表示没有或提交失败
+} recipe_step_run_t;
+
+// 配方的一次执行，多个样品各有一个，只由 process_task 访问
+typedef struct
+{
+	const recipe_t *recipe;
+	char name[16];        // 打印前缀，例如样品编号
+	recipe_step_run_t step[RECIPE_MAX_STEPS];
+	uint64_t done_set;    // 已完成的步骤
+	uint64_t start_ns;
+	uint8_t pause;        // 1：不开始 SYNC 步骤，停在下一个安全点
+	recipe_stats_t stats;
+} recipe_run_t;
+
+int recipe_parse(recipe_t *recipe, const char *text, const char *source);
+int recipe_init(const char *path);
+int recipe_load(const char *path);
+const recipe_t *recipe_get(int index);
+
+void recipe_run_start(recipe_run_t *run, const recipe_t *recipe, const char *name, uint64_t now);
+int recipe_run_poll(recipe_run_t *run, uint8_t blocked, uint64_t now);
+uint8_t recipe_run_outstanding(const recipe_run_t *run);
+uint8_t recipe_run_in_use(const recipe_run_t *run);
+uint64_t recipe_run_deadline(const recipe_run_t *run);
+
+void recipe_get_stats(recipe_stats_t *stats);
+void recipe_print_stats(void);
+
+#endif
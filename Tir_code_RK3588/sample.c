@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "motor.h"
+#include "sample.h"
+
+/*
+ * 多样品调度
+ * 控制台把样品装入常规队列或 STAT 队列，process_task 调用 sample_poll() 执行：
+ * - 最多 SAMPLE_MAX_INFLIGHT 个常规样品同时执行，按装载顺序排列，
+ *   后面的样品只能使用前面样品以后不再需要的资源，每个资源上的步骤顺序不变；
+ * - STAT 样品到达后，正在执行的样品不再开始 SYNC 步骤，停在下一个安全点，
+ *   全部停稳（没有步骤在等待或运动）后 STAT 排到最前面执行，完成后其他样品继续。
+ */
+
+typedef struct
+{
+	sample_req_t req[SAMPLE_QUEUE_DEPTH];
+	int head, count;
+} sample_fifo_t;
+
+// 控制台线程装载，process_task 取出
+static sample_fifo_t fifo[2];
+static uint32_t next_id = 1;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 正在执行的样品，只由 process_task 访问；order 按执行优先级排列
+typedef struct
+{
+	sample_req_t req;
+	uint64_t start_ns;
+	recipe_run_t run;
+} sample_slot_t;
+
+static sample_slot_t slots[SAMPLE_MAX_INFLIGHT + 1];
+static sample_slot_t *order[SAMPLE_MAX_INFLIGHT + 1];
+static int norder = 0;
+static uint64_t batch_start_ns = 0;
+
+static sample_stats_t stats;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * @description : 装载一个样品
+ * @param - stat        : SAMPLE_STAT 表示急诊样品
+ * @param - recipe_path : 配方文件，NULL 使用默认配方
+ * @return : 样品编号，-1 表示配方无效或队列已满
+ */
+int sample_enqueue(int stat, const char *recipe_path)
+{
+	int recipe = recipe_load(recipe_path);
+	sample_fifo_t *q = &fifo[stat ? SAMPLE_STAT : SAMPLE_ROUTINE];
+	sample_req_t *req;
+	int id;
+
+	if (recipe < 0)
+		return -1;
+
+	pthread_mutex_lock(&queue_mutex);
+	if (q->count >= SAMPLE_QUEUE_DEPTH)
+	{
+		pthread_mutex_unlock(&queue_mutex);
+		return -1;
+	}
+	req = &q->req[(q->head + q->count) % SAMPLE_QUEUE_DEPTH];
+	req->id = next_id++;
+	req->stat = stat ? SAMPLE_STAT : SAMPLE_ROUTINE;
+	req->recipe = recipe;
+	req->enqueue_ns = monotonic_ns();
+	q->count++;
+	id = req->id;
+	pthread_mutex_unlock(&queue_mutex);
+
+	pthread_mutex_lock(&stats_mutex);
+	stats.loaded++;
+	pthread_mutex_unlock(&stats_mutex);
+
+	// 唤醒 process_task
+	Motor_Done_Notify();
+	return id;
+}
+
+static int fifo_pop(int kind, sample_req_t *out)
+{
+	sample_fifo_t *q = &fifo[kind];
+	int ok = 0;
+
+	pthread_mutex_lock(&queue_mutex);
+	if (q->count > 0)
+	{
+		*out = q->req[q->head];
+		q->head = (q->head + 1) % SAMPLE_QUEUE_DEPTH;
+		q->count--;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&queue_mutex);
+	return ok;
+}
+
+static int fifo_depth(int kind)
+{
+	int n;
+
+	pthread_mutex_lock(&queue_mutex);
+	n = fifo[kind].count;
+	pthread_mutex_unlock(&queue_mutex);
+	return n;
+}
+
+// 把样品放进执行表，front 为1时排在最前
+static void sample_admit(const sample_req_t *req, int front, uint64_t now)
+{
+	sample_slot_t *slot = NULL;
+	char name[16];
+	int i;
+
+	for (i = 0; i < SAMPLE_MAX_INFLIGHT + 1 && slot == NULL; i++)
+	{
+		int used = 0, k;
+		for (k = 0; k < norder; k++)
+			used |= order[k] == &slots[i];
+		if (!used)
+			slot = &slots[i];
+	}
+
+	if (batch_start_ns == 0)
+	{
+		batch_start_ns = now;
+		pthread_mutex_lock(&stats_mutex);
+		stats.batch_count = 0;
+		stats.batch_time = 0;
+		pthread_mutex_unlock(&stats_mutex);
+	}
+	slot->req = *req;
+	slot->start_ns = now;
+	snprintf(name, sizeof(name), req->stat ? "S%u(STAT)" : "S%u", req->id);
+	recipe_run_start(&slot->run, recipe_get(req->recipe), name, now);
+
+	if (front)
+	{
+		memmove(&order[1], &order[0], norder * sizeof(order[0]));
+		order[0] = slot;
+	}
+	else
+	{
+		order[norder] = slot;
+	}
+	norder++;
+}
+
+static void sample_complete(int k, uint64_t now)
+{
+	sample_slot_t *slot = order[k];
+	int kind = slot->req.stat;
+	double turnaround = (now - slot->req.enqueue_ns) / 1e9;
+	vision_result_t vr;
+	// 只采用该样品开始执行以后的视觉结果
+	int has_ph = vision_get_latest(&vr) && vr.stamp_ns >= slot->start_ns;
+
+	pthread_mutex_lock(&stats_mutex);
+	stats.completed[kind]++;
+	stats.turnaround_sum[kind] += turnaround;
+	if (turnaround > stats.turnaround_max[kind])
+		stats.turnaround_max[kind] = turnaround;
+	stats.wait_sum[kind] += (slot->start_ns - slot->req.enqueue_ns) / 1e9;
+	stats.batch_count++;
+	stats.batch_time = (now - batch_start_ns) / 1e9;
+	stats.last_id = slot->req.id;
+	stats.last_turnaround = turnaround;
+	if (has_ph)
+		memcpy(stats.last_ph, vr.label, sizeof(stats.last_ph));
+	else
+		stats.last_ph[0] = '\0';
+	pthread_mutex_unlock(&stats_mutex);
+	if (has_ph)
+		printf("Sample %s done, turnaround %.3f s, %s (%s)\n", slot->run.name, turnaround, vr.label, vr.color);
+	else
+		printf("Sample %s done, turnaround %.3f s\n", slot->run.name, turnaround);
+
+	memmove(&order[k], &order[k + 1], (norder - k - 1) * sizeof(order[0]));
+	norder--;
+}
+
+// 推进所有正在执行的样品，返回是否有样品完成
+static int sample_advance(uint64_t now)
+{
+	uint8_t outstanding = 0;
+	int finished = 0;
+	int k, j;
+
+	for (k = 0; k < norder; k++)
+	{
+		uint8_t blocked = outstanding;
+
+		for (j = 0; j < norder; j++)
+		{
+			if (j != k)
+				blocked |= recipe_run_in_use(&order[j]->run);
+		}
+		if (!recipe_run_poll(&order[k]->run, blocked, now))
+		{
+			sample_complete(k, monotonic_ns());
+			k--;
+			finished = 1;
+			continue;
+		}
+		outstanding |= recipe_run_outstanding(&order[k]->run);
+	}
+	return finished;
+}
+
+// 发布正在执行的样品，供其他线程查看
+static void sample_publish_running(void)
+{
+	int k, i;
+
+	pthread_mutex_lock(&stats_mutex);
+	stats.running = norder;
+	for (k = 0; k < norder; k++)
+	{
+		const recipe_run_t *run = &order[k]->run;
+		sample_status_t *s = &stats.run[k];
+
+		s->id = order[k]->req.id;
+		s->stat = order[k]->req.stat;
+		s->paused = run->pause;
+		s->in_use = recipe_run_in_use(run);
+		s->steps = run->recipe->count;
+		s->steps_started = s->steps_done = 0;
+		for (i = 0; i < run->recipe->count; i++)
+		{
+			s->steps_started += run->step[i].state != STEP_PENDING;
+			s->steps_done += run->step[i].state == STEP_DONE;
+		}
+		s->start_ns = order[k]->start_ns;
+	}
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+/*
+ * @description : 调度样品，在电机到位通知、等待到期或装载新样品后调用
+ * @return : 正在执行和排队的样品数
+ */
+int sample_poll(uint64_t now)
+{
+	sample_req_t req;
+	int changed;
+	int stat_running, routine_running;
+	int k;
+
+	do
+	{
+		changed = sample_advance(now);
+		now = monotonic_ns();
+
+		stat_running = 0;
+		for (k = 0; k < norder; k++)
+			stat_running |= order[k]->req.stat;
+		routine_running = norder - stat_running;
+
+		if (!stat_running && fifo_depth(SAMPLE_STAT) > 0)
+		{
+			// 常规样品停在下一个安全点，全部停稳后 STAT 插到最前
+			uint8_t in_use = 0;
+			for (k = 0; k < norder; k++)
+			{
+				order[k]->run.pause = 1;
+				in_use |= recipe_run_in_use(&order[k]->run);
+			}
+			if (in_use == 0 && fifo_pop(SAMPLE_STAT, &req))
+			{
+				if (routine_running)
+				{
+					pthread_mutex_lock(&stats_mutex);
+					stats.preemptions++;
+					pthread_mutex_unlock(&stats_mutex);
+					printf("Sample S%u(STAT) pre-empts %d running sample(s)\n", req.id, routine_running);
+				}
+				sample_admit(&req, 1, now);
+				changed = 1;
+			}
+		}
+		else if (!stat_running)
+		{
+			for (k = 0; k < norder; k++)
+				order[k]->run.pause = 0;
+			if (routine_running < SAMPLE_MAX_INFLIGHT && fifo_pop(SAMPLE_ROUTINE, &req))
+			{
+				sample_admit(&req, 0, now);
+				changed = 1;
+			}
+		}
+	} while (changed);
+	sample_publish_running();
+
+	if (norder == 0 && fifo_depth(SAMPLE_ROUTINE) == 0 && fifo_depth(SAMPLE_STAT) == 0)
+	{
+		// 本批结束，下一个样品开始新的一批
+		batch_start_ns = 0;
+		return 0;
+	}
+	return norder + fifo_depth(SAMPLE_ROUTINE) + fifo_depth(SAMPLE_STAT);
+}
+
+// 下一次需要推进的时间点，0 表示只等电机到位通知
+uint64_t sample_next_deadline(void)
+{
+	uint64_t next = 0;
+	int k;
+
+	for (k = 0; k < norder; k++)
+	{
+		uint64_t d = recipe_run_deadline(&order[k]->run);
+		if (d && (next == 0 || d < next))
+			next = d;
+	}
+	return next;
+}
+
+void sample_get_stats(sample_stats_t *out)
+{
+	pthread_mutex_lock(&stats_mutex);
+	*out = stats;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+// 打印吞吐量和两类样品的周转时间
+void sample_print_stats(void)
+{
+	static const char *const kind_name[2] = {"routine", "STAT"};
+	sample_stats_t st;
+	int kind, k;
+
+	sample_get_stats(&st);
+	printf("Samples: loaded=%u queued=%d+%d STAT, pre-emptions=%u\n", st.loaded,
+		   fifo_depth(SAMPLE_ROUTINE), fifo_depth(SAMPLE_STAT), st.preemptions);
+	if (st.batch_count > 0 && st.batch_time > 0)
+		printf("  batch: %u samples in %.3f s = %.1f samples/h\n",
+			   st.batch_count, st.batch_time, st.batch_count * 3600.0 / st.batch_time);
+	if (st.last_ph[0])
+		printf("  last: S%u %s\n", st.last_id, st.last_ph);
+	for (k = 0; k < st.running; k++)
+		printf("  running: S%u%s step %u/%u%s\n", st.run[k].id, st.run[k].stat ? "(STAT)" : "",
+			   st.run[k].steps_done, st.run[k].steps, st.run[k].paused ? ", paused at SYNC" : "");
+	for (kind = 0; kind < 2; kind++)
+	{
+		if (st.completed[kind] == 0)
+			continue;
+		printf("  %s: %u done, turnaround avg %.3f s max %.3f s, queue wait avg %.3f s\n",
+			   kind_name[kind], st.completed[kind],
+			   st.turnaround_sum[kind] / st.completed[kind], st.turnaround_max[kind],
+			   st.wait_sum[kind] / st.completed[kind]);
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef __SAMPLE_H
+#define __SAMPLE_H
+
+#include <stdint.h>
+#include "recipe.h"
+#include "vision.h"
+
+#define SAMPLE_QUEUE_DEPTH 32      // 每类样品最多排队数
+#define SAMPLE_MAX_INFLIGHT 2      // 同时执行的常规样品数，后一个按资源顺序跟在前一个后面
+#define SAMPLE_IDLE_WAIT_NS 100000000ull // 没有到期事件时 process_task 最长等待时间，用于检查退出
+
+enum
+{
+	SAMPLE_ROUTINE = 0,
+	SAMPLE_STAT = 1, // 急诊样品，在其他样品的下一个安全点（SYNC）插入
+};
+
+typedef struct
+{
+	uint32_t id;
+	uint8_t stat;
+	int recipe;          // 配方编号，见 recipe_load()
+	uint64_t enqueue_ns;
+} sample_req_t;
+
+// 正在执行的一个样品，sample_poll() 结束时发布
+typedef struct
+{
+	uint32_t id;
+	uint8_t stat;
+	uint8_t paused;                // 为 STAT 停在安全点，不开始 SYNC 步骤
+	uint8_t in_use;                // 正在等待或运动的步骤占用的资源，RECIPE_RES_*
+	uint8_t steps_started;         // 已开始（含已完成）的步骤数
+	uint8_t steps_done;
+	uint8_t steps;
+	uint64_t start_ns;             // 开始执行的时间
+} sample_status_t;
+
+typedef struct
+{
+	uint32_t loaded;               // 装载的样品数
+	uint32_t completed[2];         // 完成数，[SAMPLE_ROUTINE] / [SAMPLE_STAT]
+	double turnaround_sum[2];      // 装载到完成 s
+	double turnaround_max[2];
+	double wait_sum[2];            // 装载到开始执行 s
+	uint32_t preemptions;          // STAT 插入时有常规样品被暂停的次数
+	uint32_t batch_count;          // 本批（从空闲开始）完成的样品数
+	double batch_time;             // 本批第一个样品开始到最近一个完成 s
+	uint32_t last_id;
+	double last_turnaround;
+	char last_ph[VISION_LABEL_MAX]; // 最近完成的样品执行期间收到的视觉结果，空表示没有
+	int running;                   // 正在执行的样品数，run[] 按执行优先级排列
+	sample_status_t run[SAMPLE_MAX_INFLIGHT + 1];
+} sample_stats_t;
+
+int sample_enqueue(int stat, const char *recipe_path);
+int sample_poll(uint64_t now);
+uint64_t sample_next_deadline(void);
+void sample_get_stats(sample_stats_t *stats);
+void sample_print_stats(void);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __SEQLOCK_H
+#define __SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * 顺序锁：写者在修改前后各把序号加一（写入期间为奇数），
+ * 读者拷贝数据后检查序号是否变化，变化则重读。
+ * 读者从不阻塞写者，适合高优先级线程发布、低优先级线程读取的状态。
+ * 多个写者之间需要调用者自己互斥。
+ */
+typedef struct
+{
+    uint32_t seq;
+} seqlock_t;
+
+#define SEQLOCK_INIT {0}
+
+static inline void seqlock_write_begin(seqlock_t *sl)
+{
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *sl)
+{
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *sl)
+{
+    uint32_t seq;
+
+    while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+    return seq;
+}
+
+static inline int seqlock_read_retry(const seqlock_t *sl, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq;
+}
+
+// 写：把 src 整体发布到 dst
+static inline void seqlock_publish(seqlock_t *sl, void *dst, const void *src, size_t size)
+{
+    seqlock_write_begin(sl);
+    memcpy(dst, src, size);
+    seqlock_write_end(sl);
+}
+
+// 读：拷贝出 src 的一致快照
+static inline void seqlock_snapshot(const seqlock_t *sl, void *dst, const void *src, size_t size)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = seqlock_read_begin(sl);
+        memcpy(dst, src, size);
+    } while (seqlock_read_retry(sl, seq));
+}
+
+#endif
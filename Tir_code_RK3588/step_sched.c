@@ -0,0 +1,851 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "motor.h"
+#include "task.h"
+#include "step_sched.h"
+
+/*
+ * 单线程步进调度器
+ * 四个轴共用一个实时线程：每个运动中的轴在小顶堆里保存下一个事件的绝对时间，
+ * 线程用 clock_nanosleep(TIMER_ABSTIME) 睡到最早的截止时间再处理。
+ * 驱动支持脉冲串时整段运动交给内核，堆里只保留状态查询事件。
+ *
+ * 协调运动：多个轴作为一组同时启动、同时到达。用户态用 DDA（Bresenham）
+ * 插补，由组长轴按“节拍”曲线推进，其余轴按比例在节拍上输出边沿；
+ * 内核脉冲串模式下各轴曲线按同一总时长缩放后分别下发。
+ */
+
+typedef enum
+{
+	AXIS_IDLE = 0,
+	AXIS_USER,   // 用户态逐边沿翻转
+	AXIS_KERNEL, // 内核hrtimer脉冲串
+	AXIS_GROUP,  // 协调运动组长，负责DDA节拍
+	AXIS_FOLLOW, // 协调运动组员，由组长输出边沿
+} axis_mode_t;
+
+// DDA插补状态
+typedef struct
+{
+	uint32_t ticks; // 总节拍数 = 组内最大边沿数
+	uint32_t tick;  // 已执行节拍
+	unsigned mask;  // 参与的轴
+	uint32_t accum[STEP_AXES];
+} step_group_t;
+
+typedef struct
+{
+	motor *motor_p;
+	float *target;    // 目标圈数（Target_Circle_X）
+	const char *name;
+	axis_mode_t mode;
+	motion_plan_t plan;
+	int32_t start_step;  // 起点（边沿）
+	int32_t move_target; // 终点（边沿）
+	uint32_t total;   // 本次运动边沿数
+	uint32_t done;    // 已输出边沿数
+	uint64_t start_ns;
+	uint64_t deadline; // 下一事件的绝对时间
+	step_group_t group; // 仅组长使用
+	motion_queue_t queue; // 排队等待执行的运动
+	int from_queue;       // 当前运动取自队列
+	uint64_t drained_ns;  // 排队运动结束时队列为空的时刻，0 表示未发生
+	motor_timing_t timing; // 本次运动的边沿延迟统计
+	step_axis_stats_t stats;
+} step_axis_t;
+
+static step_axis_t axes[STEP_AXES] = {
+	{.motor_p = &motor_data_A, .target = &Target_Circle_A, .name = "A", .queue = MOTION_QUEUE_INIT},
+	{.motor_p = &motor_data_B, .target = &Target_Circle_B, .name = "B", .queue = MOTION_QUEUE_INIT},
+	{.motor_p = &motor_data_C, .target = &Target_Circle_C, .name = "C", .queue = MOTION_QUEUE_INIT},
+	{.motor_p = &motor_data_D, .target = &Target_Circle_D, .name = "D", .queue = MOTION_QUEUE_INIT},
+};
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 协调运动请求，调度线程只用trylock访问，不会被低优先级线程阻塞
+static pthread_mutex_t coord_mutex = PTHREAD_MUTEX_INITIALIZER;
+// 轴互不相交的多个协调运动可以同时等待启动，各自独立成组；轴数即最大组数
+static unsigned coord_groups[STEP_AXES]; // 每个等待启动的协调运动包含的轴
+static int coord_count = 0;
+static float coord_targets[STEP_AXES];
+
+// 唤醒调度线程的 eventfd；kick_ns 记录第一次未处理通知的时间，用于统计启动延迟
+static int wake_fd = -1;
+static uint64_t kick_ns = 0;
+static step_wake_stats_t wake_stats;
+static __thread int in_sched_thread = 0; // 调度线程自己修改状态时不需要唤醒自己
+
+// 按deadline排序的小顶堆，元素最多为轴数
+static step_axis_t *heap[STEP_AXES];
+static int heap_size = 0;
+
+static void heap_push(step_axis_t *ax)
+{
+	int i = heap_size++;
+
+	while (i > 0)
+	{
+		int parent = (i - 1) / 2;
+		if (heap[parent]->deadline <= ax->deadline)
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = ax;
+}
+
+static step_axis_t *heap_pop(void)
+{
+	step_axis_t *top = heap[0];
+	step_axis_t *last = heap[--heap_size];
+	int i = 0;
+
+	while (1)
+	{
+		int child = 2 * i + 1;
+		if (child >= heap_size)
+			break;
+		if (child + 1 < heap_size && heap[child + 1]->deadline < heap[child]->deadline)
+			child++;
+		if (last->deadline <= heap[child]->deadline)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	if (heap_size > 0)
+		heap[i] = last;
+	return top;
+}
+
+// 轴是否仍处于执行状态；其他线程可随时清零 Process_Flag 来中止运动
+static int axis_armed(const step_axis_t *ax)
+{
+	return __atomic_load_n(&ax->motor_p->Process_Flag, __ATOMIC_ACQUIRE) == 1;
+}
+
+static void sleep_until(uint64_t deadline)
+{
+	struct timespec ts;
+
+	ts.tv_sec = deadline / 1000000000ull;
+	ts.tv_nsec = deadline % 1000000000ull;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0 && running)
+		;
+}
+
+/*
+ * @description : 等待到 deadline 或被 step_sched_kick() 唤醒
+ *                远处的截止时间用 ppoll 等 eventfd，最后 STEP_PRECISE_SLEEP_NS 用绝对时间睡眠保证精度
+ * @return : 1 表示被唤醒，0 表示到达截止时间
+ */
+static int wait_until(uint64_t deadline)
+{
+	uint64_t now = monotonic_ns();
+
+	if (wake_fd >= 0 && deadline > now + STEP_PRECISE_SLEEP_NS)
+	{
+		struct pollfd pfd = {.fd = wake_fd, .events = POLLIN};
+		uint64_t rel = deadline - now - STEP_PRECISE_SLEEP_NS;
+		struct timespec ts = {.tv_sec = rel / 1000000000ull, .tv_nsec = rel % 1000000000ull};
+
+		if (ppoll(&pfd, 1, &ts, NULL) > 0)
+		{
+			uint64_t count;
+			if (read(wake_fd, &count, sizeof(count)) == sizeof(count))
+				wake_stats.kicks++;
+			return 1;
+		}
+		if (!running)
+			return 0;
+	}
+	sleep_until(deadline);
+	return 0;
+}
+
+static void axis_finish(step_axis_t *ax, uint64_t now, int completed)
+{
+	int32_t reached;
+	uint64_t elapsed = now - ax->start_ns;
+	int more = 0;
+
+	if (ax->mode == AXIS_KERNEL)
+		gpio_pulse_timing(ax->motor_p->PUL_GPIO, &ax->timing);
+	Motor_Publish_Timing(ax->motor_p, &ax->timing);
+
+	if (completed)
+		reached = ax->move_target;
+	else
+		reached = ax->motor_p->DIR == Forward ? ax->start_step + (int32_t)ax->done : ax->start_step - (int32_t)ax->done;
+
+	if (ax->from_queue)
+	{
+		// 中止时丢弃后续排队运动；正常结束且队列为空则记录，用于统计欠载
+		if (!completed)
+			motion_queue_flush(&ax->queue);
+		more = completed && motion_queue_depth(&ax->queue) > 0;
+		ax->drained_ns = completed && !more ? now : 0;
+	}
+	Motor_Finish_Move(ax->motor_p, reached, completed, more);
+
+	pthread_mutex_lock(&stats_mutex);
+	ax->stats.edges += ax->done;
+	ax->stats.active_ns += elapsed;
+	ax->stats.moves++;
+	if (!completed)
+		ax->stats.aborted++;
+	ax->stats.last_time = elapsed / 1e9;
+	ax->stats.last_rate = elapsed > 0 ? ax->done / (elapsed / 1e9) : 0;
+	pthread_mutex_unlock(&stats_mutex);
+	ax->mode = AXIS_IDLE;
+}
+
+/*
+ * @description : 规划协调运动的节拍曲线
+ *                以单独运动耗时最长的轴为基准，把它的曲线按距离比例映射到
+ *                ticks个节拍上；再按各轴的速度/加速度/加加速度限制把时间整体拉长，
+ *                保证每个轴按比例分到的速度都不超限
+ * @param - edges : 各轴边沿数
+ * @param - tick_limits : 输出，节拍曲线使用的限制（边沿单位）
+ * @return : 节拍数，0 表示没有需要运动的轴
+ */
+static uint32_t group_plan(const uint32_t edges[STEP_AXES], unsigned mask,
+						   motion_plan_t *tick_plan, motion_limits_t *tick_limits)
+{
+	motion_plan_t plan;
+	motion_limits_t base;
+	double longest = -1, scale = 1, vpeak;
+	uint32_t ticks = 0;
+	int i, k = -1;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (!(mask & (1u << i)) || edges[i] == 0)
+			continue;
+		if (edges[i] > ticks)
+			ticks = edges[i];
+		if (planner_plan(&plan, edges[i], &axes[i].motor_p->Limits, Motor_Steps_Per_Circle(axes[i].motor_p)) == 0 &&
+			plan.total_time > longest)
+		{
+			longest = plan.total_time;
+			k = i;
+		}
+	}
+	if (ticks == 0 || k < 0)
+		return 0;
+
+	// 基准轴的曲线换算到边沿单位后映射到节拍上：距离放大 ticks/edges[k] 倍，时间不变
+	scale = (double)ticks / edges[k] * Motor_Steps_Per_Circle(axes[k].motor_p);
+	base.max_velocity = axes[k].motor_p->Limits.max_velocity * scale;
+	base.acceleration = axes[k].motor_p->Limits.acceleration * scale;
+	base.jerk = axes[k].motor_p->Limits.jerk > 0 ? axes[k].motor_p->Limits.jerk * scale : 0;
+	planner_plan(&plan, ticks, &base, 1);
+	vpeak = plan.peak_velocity;
+
+	// 时间拉长 s 倍时速度、加速度、加加速度分别缩小 s、s²、s³ 倍
+	scale = 1;
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		const motion_limits_t *lim = &axes[i].motor_p->Limits;
+		double r, spc;
+
+		if (!(mask & (1u << i)) || edges[i] == 0)
+			continue;
+		r = (double)edges[i] / ticks;
+		spc = Motor_Steps_Per_Circle(axes[i].motor_p);
+		scale = fmax(scale, r * vpeak / (lim->max_velocity * spc));
+		scale = fmax(scale, sqrt(r * base.acceleration / (lim->acceleration * spc)));
+		if (base.jerk > 0 && lim->jerk > 0)
+			scale = fmax(scale, cbrt(r * base.jerk / (lim->jerk * spc)));
+	}
+
+	tick_limits->max_velocity = base.max_velocity / scale;
+	tick_limits->acceleration = base.acceleration / (scale * scale);
+	tick_limits->jerk = base.jerk / (scale * scale * scale);
+	planner_plan(tick_plan, ticks, tick_limits, 1);
+	return ticks;
+}
+
+// 记录一次运动的起点和终点（Motor_Prepare_Move 已写入），运动模式由调用者设置
+static void axis_begin(step_axis_t *ax, uint32_t edges, uint64_t now)
+{
+	ax->start_step = ax->motor_p->Current_Step;
+	ax->move_target = ax->motor_p->Target_Step;
+	ax->total = edges;
+	ax->done = 0;
+	ax->start_ns = now;
+	memset(&ax->timing, 0, sizeof(ax->timing));
+}
+
+/*
+ * @description : 推进到下一个截止时间并记录本边沿的延迟
+ *                正常情况下在上一个截止时间上累加间隔（无漂移）；
+ *                落后超过一个间隔时视为丢失，从当前时间重新对齐，避免补发成串边沿
+ * @param - now : 本边沿实际输出的时间
+ * @return : 下一个截止时间
+ */
+static uint64_t advance_deadline(motion_plan_t *plan, uint64_t deadline, uint64_t now,
+								 motor_timing_t *timings[], int count)
+{
+	int64_t late = (int64_t)(now - deadline);
+	uint32_t interval = planner_next_interval_ns(plan);
+	int missed = late >= (int64_t)interval;
+	int i;
+
+	for (i = 0; i < count; i++)
+		motor_timing_record(timings[i], late, missed);
+	return missed ? now + interval : deadline + interval;
+}
+
+/*
+ * @description : 启动协调运动，要求组内各轴都已空闲
+ *                驱动支持脉冲串时各轴按同一时长缩放后分别下发，否则用DDA插补
+ */
+static void group_start(const float targets[STEP_AXES], unsigned mask, uint64_t now)
+{
+	planner_chunk_t chunks[GPIO_PULSE_MAX_SEGS];
+	motion_plan_t tick_plan;
+	motion_limits_t tick_limits;
+	uint32_t edges[STEP_AXES] = {0};
+	unsigned started = 0;
+	uint32_t ticks;
+	step_axis_t *leader = NULL;
+	int i;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		int n = Motor_Prepare_Move(axes[i].motor_p, targets[i], axes[i].name);
+		if (n > 0)
+			edges[i] = n;
+		else
+			mask &= ~(1u << i);
+	}
+
+	ticks = group_plan(edges, mask, &tick_plan, &tick_limits);
+	if (ticks == 0)
+		return;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (mask & (1u << i))
+		{
+			if (leader == NULL)
+				leader = &axes[i];
+			axis_begin(&axes[i], edges[i], now);
+		}
+	}
+
+	// 内核模式：每个轴的曲线是节拍曲线按距离比例缩小，总时长相同
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		motion_limits_t lim;
+		double r;
+
+		if (!(mask & (1u << i)))
+			continue;
+		r = (double)edges[i] / ticks;
+		lim.max_velocity = tick_limits.max_velocity * r;
+		lim.acceleration = tick_limits.acceleration * r;
+		lim.jerk = tick_limits.jerk * r;
+		planner_plan(&axes[i].plan, edges[i], &lim, 1);
+		if (gpio_pulse_profile(axes[i].motor_p, chunks, planner_to_chunks(&axes[i].plan, chunks, GPIO_PULSE_MAX_SEGS, GPIO_PULSE_MIN_PERIOD_NS)) < 0)
+			break;
+		started |= 1u << i;
+	}
+	if (started == mask)
+	{
+		for (i = 0; i < STEP_AXES; i++)
+		{
+			if (!(mask & (1u << i)))
+				continue;
+			axes[i].mode = AXIS_KERNEL;
+			axes[i].deadline = now + STEP_KERNEL_POLL_NS;
+			heap_push(&axes[i]);
+		}
+		return;
+	}
+
+	// 有轴下发失败：撤回已启动的脉冲串，整组改用DDA
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (started & (1u << i))
+		{
+			uint32_t done = 0;
+			gpio_pulse_stop(axes[i].motor_p->PUL_GPIO);
+			gpio_pulse_wait(axes[i].motor_p->PUL_GPIO, 0, &done);
+			gpio_pulse_account(axes[i].motor_p->PUL_GPIO, done);
+			axes[i].done = done;
+		}
+	}
+	if (started != 0)
+	{
+		// 已经走出去的边沿无法收回，按中止处理，等待下一次启动
+		for (i = 0; i < STEP_AXES; i++)
+		{
+			if (mask & (1u << i))
+				axis_finish(&axes[i], now, 0);
+		}
+		return;
+	}
+
+	leader->plan = tick_plan;
+	leader->group.ticks = ticks;
+	leader->group.tick = 0;
+	leader->group.mask = mask;
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		leader->group.accum[i] = ticks / 2;
+		if ((mask & (1u << i)) && &axes[i] != leader)
+			axes[i].mode = AXIS_FOLLOW;
+	}
+	leader->mode = AXIS_GROUP;
+	leader->deadline = now + planner_next_interval_ns(&leader->plan);
+	heap_push(leader);
+}
+
+// 协调运动的一个节拍
+static int group_service(step_axis_t *leader, uint64_t now)
+{
+	step_group_t *g = &leader->group;
+	int i;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if ((g->mask & (1u << i)) && !axis_armed(&axes[i]))
+		{
+			for (i = 0; i < STEP_AXES; i++)
+			{
+				if (g->mask & (1u << i))
+					axis_finish(&axes[i], now, 0);
+			}
+			return 0;
+		}
+	}
+
+	motor_timing_t *fired[STEP_AXES];
+	int nfired = 0;
+	uint32_t pul_mask = 0;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (!(g->mask & (1u << i)))
+			continue;
+		g->accum[i] += axes[i].total;
+		if (g->accum[i] >= g->ticks)
+		{
+			g->accum[i] -= g->ticks;
+			pul_mask |= GPIO_BIT(axes[i].motor_p->PUL_GPIO);
+			axes[i].done++;
+			fired[nfired++] = &axes[i].timing;
+		}
+	}
+	// 同一节拍的边沿一次写出
+	gpio_toggle_mask(pul_mask);
+
+	if (++g->tick == g->ticks)
+	{
+		for (i = 0; i < nfired; i++)
+			motor_timing_record(fired[i], (int64_t)(now - leader->deadline), 0);
+		for (i = 0; i < STEP_AXES; i++)
+		{
+			if (g->mask & (1u << i))
+				axis_finish(&axes[i], now, 1);
+		}
+		return 0;
+	}
+
+	leader->deadline = advance_deadline(&leader->plan, leader->deadline, now, fired, nfired);
+	if ((g->tick & 63) == 0)
+	{
+		for (i = 0; i < STEP_AXES; i++)
+		{
+			if (g->mask & (1u << i))
+				Motor_Publish_Timing(axes[i].motor_p, &axes[i].timing);
+		}
+	}
+	return 1;
+}
+
+// 空闲轴检查是否有新运动（优先取运动队列），有则规划并启动；返回1表示已启动
+static int axis_try_start(step_axis_t *ax, uint64_t now)
+{
+	planner_chunk_t chunks[GPIO_PULSE_MAX_SEGS];
+	uint32_t spc = Motor_Steps_Per_Circle(ax->motor_p);
+	motion_cmd_t cmd;
+	int edges, fallback;
+
+	ax->from_queue = 0;
+	while (motion_queue_pop(&ax->queue, &cmd, now))
+	{
+		if (ax->drained_ns)
+		{
+			__atomic_add_fetch(&ax->queue.underruns, 1, __ATOMIC_RELAXED);
+			ax->drained_ns = 0;
+		}
+		// 排队的运动自带执行许可；同步全局目标，避免空闲检查把目标改回去
+		*ax->target = cmd.target;
+		Begin_Motor_flag(ax->motor_p);
+		edges = Motor_Prepare_Move(ax->motor_p, cmd.target, ax->name);
+		if (edges > 0)
+		{
+			ax->from_queue = 1;
+			break;
+		}
+	}
+	if (!ax->from_queue)
+		edges = Motor_Prepare_Move(ax->motor_p, *ax->target, ax->name);
+
+	if (edges <= 0)
+		return 0;
+
+	// 本线程是实时线程，不在这里打印；计划参数和异常计数记入统计，由 step_sched_print_stats() 输出
+	fallback = planner_plan(&ax->plan, edges, &ax->motor_p->Limits, spc) < 0;
+	if (fallback)
+	{
+		motion_limits_t fixed = {1000000.0f / PULSE_EDGE_INTERVAL_US, 1e9f, 0};
+		planner_plan(&ax->plan, edges, &fixed, 1);
+	}
+	pthread_mutex_lock(&stats_mutex);
+	ax->stats.fallbacks += fallback;
+	// 优先交给驱动按分段曲线产生整段脉冲；超过驱动边沿频率上限的分段按上限输出
+	ax->stats.capped += !motor_gpio_is_sim() && ax->plan.peak_velocity * GPIO_PULSE_MIN_PERIOD_NS > 1e9;
+	ax->stats.last_edges = edges;
+	ax->stats.last_peak = ax->plan.peak_velocity;
+	ax->stats.last_planned = ax->plan.total_time;
+	pthread_mutex_unlock(&stats_mutex);
+
+	axis_begin(ax, edges, now);
+
+	if (gpio_pulse_profile(ax->motor_p, chunks, planner_to_chunks(&ax->plan, chunks, GPIO_PULSE_MAX_SEGS, GPIO_PULSE_MIN_PERIOD_NS)) == 0)
+	{
+		ax->mode = AXIS_KERNEL;
+		ax->deadline = now + STEP_KERNEL_POLL_NS;
+	}
+	else
+	{
+		ax->mode = AXIS_USER;
+		ax->deadline = now + planner_next_interval_ns(&ax->plan);
+	}
+	heap_push(ax);
+	return 1;
+}
+
+// 处理一个到期事件，返回1表示该轴仍在运动
+static int axis_service(step_axis_t *ax, uint64_t now)
+{
+	if (ax->mode == AXIS_GROUP)
+		return group_service(ax, now);
+
+	if (ax->mode == AXIS_KERNEL)
+	{
+		int ret = gpio_pulse_wait(ax->motor_p->PUL_GPIO, 0, &ax->done);
+
+		if (ret > 0 && axis_armed(ax))
+		{
+			if (gpio_pulse_timing(ax->motor_p->PUL_GPIO, &ax->timing) == 0)
+				Motor_Publish_Timing(ax->motor_p, &ax->timing);
+			ax->deadline = now + STEP_KERNEL_POLL_NS;
+			return 1;
+		}
+		if (ret != 0)
+		{
+			gpio_pulse_stop(ax->motor_p->PUL_GPIO);
+			gpio_pulse_wait(ax->motor_p->PUL_GPIO, 0, &ax->done);
+		}
+		gpio_pulse_account(ax->motor_p->PUL_GPIO, ax->done);
+		axis_finish(ax, now, ax->done == ax->total);
+		return 0;
+	}
+
+	if (!axis_armed(ax))
+	{
+		axis_finish(ax, now, 0);
+		return 0;
+	}
+
+	gpio_toggle(ax->motor_p->PUL_GPIO);
+	if (++ax->done == ax->total)
+	{
+		motor_timing_record(&ax->timing, (int64_t)(now - ax->deadline), 0);
+		axis_finish(ax, now, 1);
+		return 0;
+	}
+
+	motor_timing_t *timing = &ax->timing;
+	ax->deadline = advance_deadline(&ax->plan, ax->deadline, now, &timing, 1);
+	if ((ax->done & 63) == 0)
+		Motor_Publish_Timing(ax->motor_p, &ax->timing);
+	return 1;
+}
+
+void *step_sched_task(void *arg __attribute__((unused)))
+{
+	cpu_set_t cpus;
+	uint64_t next_check = 0;
+	int i;
+
+	printf("Step scheduler task started\n");
+
+	in_sched_thread = 1;
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0)
+		printf("Step scheduler: eventfd failed, polling every %llu ms\n", STEP_RETRY_NS / 1000000ull);
+
+	CPU_ZERO(&cpus);
+	CPU_SET(STEP_SCHED_CPU, &cpus);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+		printf("Step scheduler: CPU%d not available, running unpinned\n", STEP_SCHED_CPU);
+
+	while (running)
+	{
+		uint64_t now = monotonic_ns();
+		uint64_t wake;
+
+		wake_stats.wakeups++;
+		// 低优先级线程正在提交协调运动时跳过本次检查，1ms后再试
+		if (now >= next_check && pthread_mutex_trylock(&coord_mutex) != 0)
+		{
+			next_check = now + STEP_RETRY_NS;
+		}
+		else if (now >= next_check)
+		{
+			uint64_t kicked = __atomic_exchange_n(&kick_ns, 0, __ATOMIC_ACQ_REL);
+			int started = 0;
+			unsigned pending = 0; // 仍在等待的协调运动包含的轴
+			int g = 0;
+
+			for (i = 0; i < STEP_AXES; i++)
+				started -= axes[i].mode != AXIS_IDLE;
+			while (g < coord_count)
+			{
+				int idle = 1;
+				for (i = 0; i < STEP_AXES; i++)
+				{
+					if ((coord_groups[g] & (1u << i)) && axes[i].mode != AXIS_IDLE)
+						idle = 0;
+				}
+				if (idle)
+				{
+					group_start(coord_targets, coord_groups[g], now);
+					coord_groups[g] = coord_groups[--coord_count];
+				}
+				else
+				{
+					pending |= coord_groups[g++];
+				}
+			}
+			for (i = 0; i < STEP_AXES; i++)
+			{
+				if (axes[i].mode == AXIS_IDLE && !(pending & (1u << i)))
+					axis_try_start(&axes[i], now);
+			}
+			pthread_mutex_unlock(&coord_mutex);
+
+			for (i = 0; i < STEP_AXES; i++)
+				started += axes[i].mode != AXIS_IDLE;
+			if (kicked && started > 0)
+			{
+				uint64_t latency = monotonic_ns() - kicked;
+				__atomic_add_fetch(&wake_stats.starts, 1, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&wake_stats.latency_sum_ns, latency, __ATOMIC_RELAXED);
+				if (latency > wake_stats.latency_max_ns)
+					__atomic_store_n(&wake_stats.latency_max_ns, latency, __ATOMIC_RELAXED);
+			}
+			next_check = wake_fd >= 0 ? now + STEP_IDLE_POLL_NS : now + STEP_RETRY_NS;
+		}
+
+		// 处理所有已到期的边沿
+		while (heap_size > 0 && heap[0]->deadline <= now)
+		{
+			step_axis_t *ax = heap_pop();
+			if (axis_service(ax, now))
+				heap_push(ax);
+			else if (ax->mode == AXIS_IDLE && motion_queue_depth(&ax->queue) > 0)
+				axis_try_start(ax, now); // 队列中的下一条运动立即启动，不等空闲轮询
+			now = monotonic_ns();
+		}
+
+		wake = next_check;
+		if (heap_size > 0 && heap[0]->deadline < wake)
+			wake = heap[0]->deadline;
+		if (wait_until(wake))
+			next_check = 0;
+	}
+
+	// 退出时停止仍在运行的内核脉冲串
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (axes[i].mode == AXIS_KERNEL)
+			gpio_pulse_stop(axes[i].motor_p->PUL_GPIO);
+	}
+
+	if (wake_fd >= 0)
+	{
+		close(wake_fd);
+		wake_fd = -1;
+	}
+	printf("Step scheduler task stopped\n");
+	return NULL;
+}
+
+/*
+ * @description : 提交协调运动：mask中的轴同时启动、同时到达
+ *                目标同时写入 Set_Motor_Target()，并在持有 coord_mutex 时置执行许可，
+ *                避免调度线程在请求登记前按旧目标启动这些轴
+ * @param - targets : 四个轴的目标圈数，按 Motor_A~Motor_D 排列
+ * @param - mask    : 参与的轴，bit0~bit3 对应 A~D
+ * @return : 按当前位置估算的运动时长 s
+ */
+double step_sched_move_coordinated(const float targets[STEP_AXES], unsigned mask)
+{
+	motion_plan_t plan;
+	motion_limits_t lim;
+	motor_state_t st;
+	uint32_t edges[STEP_AXES] = {0};
+	int i;
+
+	mask &= (1u << STEP_AXES) - 1;
+
+	pthread_mutex_lock(&coord_mutex);
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		if (!(mask & (1u << i)))
+			continue;
+		coord_targets[i] = targets[i];
+		Set_Motor_Target(i, targets[i]);
+		Begin_Motor_flag(axes[i].motor_p);
+		Motor_Get_State(axes[i].motor_p, &st);
+		edges[i] = (uint32_t)abs(Motor_Circle_To_Step(axes[i].motor_p, targets[i]) - st.Current_Step);
+	}
+	// 新请求覆盖还未启动的旧请求中的同名轴
+	for (i = 0; i < coord_count;)
+	{
+		coord_groups[i] &= ~mask;
+		if (coord_groups[i] == 0)
+			coord_groups[i] = coord_groups[--coord_count];
+		else
+			i++;
+	}
+	if (mask)
+		coord_groups[coord_count++] = mask;
+	pthread_mutex_unlock(&coord_mutex);
+	step_sched_kick();
+
+	if (group_plan(edges, mask, &plan, &lim) == 0)
+		return 0;
+	return plan.total_time;
+}
+
+/*
+ * @description : 通知调度线程有新的运动请求（目标、执行标志、队列或协调运动变化）
+ *                可在任意线程调用，不阻塞
+ */
+void step_sched_kick(void)
+{
+	uint64_t zero = 0, one = 1;
+
+	if (in_sched_thread)
+		return;
+	__atomic_compare_exchange_n(&kick_ns, &zero, monotonic_ns(), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+	if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		perror("step_sched_kick");
+}
+
+void step_sched_get_wake_stats(step_wake_stats_t *stats)
+{
+	stats->wakeups = __atomic_load_n(&wake_stats.wakeups, __ATOMIC_RELAXED);
+	stats->kicks = __atomic_load_n(&wake_stats.kicks, __ATOMIC_RELAXED);
+	stats->starts = __atomic_load_n(&wake_stats.starts, __ATOMIC_RELAXED);
+	stats->latency_sum_ns = __atomic_load_n(&wake_stats.latency_sum_ns, __ATOMIC_RELAXED);
+	stats->latency_max_ns = __atomic_load_n(&wake_stats.latency_max_ns, __ATOMIC_RELAXED);
+}
+
+/*
+ * @description : 把一条运动追加到轴的运动队列，前一条结束后立即执行
+ *                排队的运动不需要单独置 Process_Flag；轴被中止时队列清空
+ * @param - axis   : Motor_A~Motor_D
+ * @param - target : 目标圈数
+ * @return : 0 成功，-1 参数错误或队列已满
+ */
+int step_sched_enqueue(int axis, float target)
+{
+	if (axis < 0 || axis >= STEP_AXES)
+		return -1;
+	if (motion_queue_push(&axes[axis].queue, target, monotonic_ns()) < 0)
+		return -1;
+	step_sched_kick();
+	return 0;
+}
+
+void step_sched_get_queue_stats(int axis, motion_queue_stats_t *stats)
+{
+	if (axis < 0 || axis >= STEP_AXES)
+	{
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	motion_queue_get_stats(&axes[axis].queue, stats);
+}
+
+void step_sched_get_stats(int axis, step_axis_stats_t *stats)
+{
+	if (axis < 0 || axis >= STEP_AXES)
+	{
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	pthread_mutex_lock(&stats_mutex);
+	*stats = axes[axis].stats;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+// 打印每个轴实际达到的边沿频率
+void step_sched_print_stats(void)
+{
+	step_axis_stats_t st;
+	step_wake_stats_t w;
+	int i;
+
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		step_sched_get_stats(i, &st);
+		printf("%s: moves=%u edges=%llu avg=%.0f edges/s last=%.0f edges/s (%.3f s)\r\n",
+			   axes[i].name, st.moves, (unsigned long long)st.edges,
+			   st.active_ns > 0 ? st.edges / (st.active_ns / 1e9) : 0.0,
+			   st.last_rate, st.last_time);
+		if (st.moves == 0)
+			continue;
+		printf("%s: last planned %u edges, peak %.0f edges/s, %.3f s; aborted=%u fallbacks=%u capped=%u\r\n",
+			   axes[i].name, st.last_edges, st.last_peak, st.last_planned, st.aborted, st.fallbacks, st.capped);
+	}
+	step_sched_get_wake_stats(&w);
+	printf("Scheduler: wakeups=%llu kicks=%llu start latency avg=%.1fus max=%.1fus (%llu starts)\r\n",
+		   (unsigned long long)w.wakeups, (unsigned long long)w.kicks,
+		   w.starts ? w.latency_sum_ns / 1e3 / w.starts : 0.0, w.latency_max_ns / 1e3,
+		   (unsigned long long)w.starts);
+	for (i = 0; i < STEP_AXES; i++)
+	{
+		motion_queue_stats_t q;
+
+		motion_queue_get_stats(&axes[i].queue, &q);
+		if (q.enqueued == 0)
+			continue;
+		printf("%s queue: depth=%u max=%u enqueued=%llu started=%llu rejected=%llu flushed=%llu "
+			   "underruns=%llu wait avg=%.2fms max=%.2fms\r\n",
+			   axes[i].name, q.depth, q.max_depth, (unsigned long long)q.enqueued,
+			   (unsigned long long)q.started, (unsigned long long)q.rejected,
+			   (unsigned long long)q.flushed, (unsigned long long)q.underruns,
+			   q.started ? q.wait_sum_ns / 1e6 / q.started : 0.0, q.wait_max_ns / 1e6);
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef __STEP_SCHED_H
+#define __STEP_SCHED_H
+
+#include <stdint.h>
+#include "motion_queue.h"
+
+#define STEP_AXES 4
+
+// 步进调度线程绑定的CPU（RK3588 的 4~7 为 A76 大核）
+#define STEP_SCHED_CPU 7
+
+// 新目标通过 step_sched_kick() 唤醒调度线程；空闲时只做低频兜底检查，
+// 照顾直接改写 Target_Circle_X 而不通知的代码
+#define STEP_IDLE_POLL_NS 100000000ull
+// 协调运动提交中（coord_mutex 被占用）时的重试间隔
+#define STEP_RETRY_NS 1000000ull
+// 距截止时间不足该值时改用 clock_nanosleep 精确等待，不再响应唤醒
+#define STEP_PRECISE_SLEEP_NS 200000ull
+// 内核脉冲串运行期间查询状态的周期
+#define STEP_KERNEL_POLL_NS 5000000ull
+
+// 单轴统计
+typedef struct
+{
+	uint64_t edges;      // 累计输出边沿数
+	uint64_t active_ns;  // 累计运动时间
+	uint32_t moves;      // 完成（含中止）的运动次数
+	uint32_t aborted;    // 未走完就停止的运动次数
+	uint32_t fallbacks;  // 限制参数无效、改用固定边沿间隔的运动次数
+	uint32_t capped;     // 峰值超过驱动边沿频率上限、内核曲线被限速的运动次数
+	uint32_t last_edges; // 最近一次运动的计划边沿数
+	double last_peak;    // 最近一次运动的计划峰值 边沿/秒
+	double last_planned; // 最近一次运动的计划耗时 s
+	double last_rate;    // 最近一次运动的平均边沿频率 边沿/秒
+	double last_time;    // 最近一次运动的实际耗时 s
+} step_axis_stats_t;
+
+// 唤醒与启动延迟统计
+typedef struct
+{
+	uint64_t wakeups;        // 调度线程醒来的次数
+	uint64_t kicks;          // 被 step_sched_kick() 唤醒的次数
+	uint64_t starts;         // 由唤醒触发启动的运动次数
+	uint64_t latency_sum_ns; // 通知到运动启动的延迟总和
+	uint64_t latency_max_ns;
+} step_wake_stats_t;
+
+void *step_sched_task(void *arg);
+void step_sched_kick(void);
+void step_sched_get_wake_stats(step_wake_stats_t *stats);
+double step_sched_move_coordinated(const float targets[STEP_AXES], unsigned mask);
+int step_sched_enqueue(int axis, float target);
+void step_sched_get_queue_stats(int axis, motion_queue_stats_t *stats);
+void step_sched_get_stats(int axis, step_axis_stats_t *stats);
+void step_sched_print_stats(void);
+
+#endif
@@ -2,6 +2,14 @@
 #include "task.h"
 #include "motor.h"
 #include "serial.h"
+#include "step_sched.h"
+#include "sample.h"
+#include "pwm.h"
+#include "pwm_profile.h"
+#include "reactor.h"
+#include "protocol.h"
+#include "usart_me_Recive.h"
+#include "vision.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -10,8 +18,6 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <errno.h>
-#include <sys/select.h>
-#include <sys/time.h>
 #include <sys/types.h>
 
 // ============================================================================
@@ -19,17 +25,27 @@
 // ============================================================================
 volatile int running = 1;
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
-volatile int Printf_Flag = 1;
-volatile int Process_continue_flag = 0;
+static int print_timer = -1;  // 状态打印定时器，控制台命令后触发
+static int print_pending = 0; // 定时器已设置，只由 I/O 线程访问
 
 // 串口相关全局变量
 static int serial_fd = -1;
 static pthread_mutex_t serial_mutex = PTHREAD_MUTEX_INITIALIZER;
+static proto_parser_t serial_rx;  // 只由 I/O 线程访问
+static usart_parser_t serial_cmd; // 帧外的文本命令，由 serial_rx 直接送入
+static vision_parser_t serial_vision; // 帧外以 { 开头的行：视觉结果 JSON
+static uint8_t serial_text_bol = 1;   // 下一个文本字节在行首
+static uint8_t serial_text_json = 0;  // 当前文本行交给 serial_vision
+static uint8_t serial_tx_seq = 0;
+static uint64_t serial_acks_tx = 0, serial_acks_rx = 0;
+
+static motor *const axis_motor[STEP_AXES] = {&motor_data_A, &motor_data_B, &motor_data_C, &motor_data_D};
+// 各轴最大目标圈数，0 表示不限制
+static const float axis_max_circle[STEP_AXES] = {10.5f, 9.0f, 18.0f, 0.0f};
 
 // PWM 相关全局变量
 static pthread_mutex_t pwm_mutex = PTHREAD_MUTEX_INITIALIZER;
-static int current_period_ns = 1000000; // 当前周期（ns），默认1kHz
-static int current_duty_percent = 0;    // 当前占空比百分比
+static int pwm_main = -1; // 主PWM通道句柄，见 pwm.h
 
 // ============================================================================
 // 信号处理函数
@@ -40,6 +56,9 @@ void signal_handler(int sig)
     {
         printf("\nReceived signal %d, shutting down...\n", sig);
         running = 0;
+        // 只写 eventfd，立即唤醒事件循环和 process_task
+        reactor_stop();
+        Motor_Done_Notify();
     }
 }
 
@@ -49,6 +68,17 @@ void setup_signal_handlers(void)
     signal(SIGTERM, signal_handler);
 }
 
+// 目标圈数限制在该轴行程内
+static float clamp_axis_target(int axis, float value)
+{
+    if (axis_max_circle[axis] > 0 && value > axis_max_circle[axis])
+    {
+        printf("%c电机最大值为%.1f\n", 'A' + axis, axis_max_circle[axis]);
+        value = axis_max_circle[axis];
+    }
+    return value;
+}
+
 // ============================================================================
 // 串口相关函数
 // ============================================================================
@@ -90,34 +120,13 @@ int serial_send_data(const unsigned char *data, int len)
 // ============================================================================
 // PWM 相关函数
 // ============================================================================
-// 初始化函数
+// 初始化函数：导出并打开主PWM通道，1kHz、占空比0
 int init_pwm(void)
 {
-
-    if (system("echo 0 > /sys/class/pwm/pwmchip0/export") != 0)
-    {
-        printf("Warning: PWM export may have failed (possibly already exported)\n");
-    }
-    usleep(100000);
-    // 设置 PWM 周期为1000000 ns (1kHz)
-    current_period_ns = 1000000;
-    if (system("echo 1000000 > /sys/class/pwm/pwmchip0/pwm0/period") != 0)
-    {
-        printf("Failed to set PWM period\n");
-        return -1;
-    }
-
-    // 设置 PWM 占空比为0% (0 ns)
-    current_duty_percent = 0;
-    if (system("echo 0 > /sys/class/pwm/pwmchip0/pwm0/duty_cycle") != 0)
-    {
-        printf("Failed to set PWM duty cycle\n");
-        return -1;
-    }
-
-    if (system("echo 1 > /sys/class/pwm/pwmchip0/pwm0/enable") != 0)
+    pwm_main = pwm_open(PWM_MAIN_CHIP, PWM_MAIN_CHANNEL);
+    if (pwm_main < 0)
     {
-        printf("Failed to enable PWM\n");
+        printf("Failed to open pwmchip%d/pwm%d under %s\n", PWM_MAIN_CHIP, PWM_MAIN_CHANNEL, pwm_get_root());
         return -1;
     }
 
@@ -127,88 +136,43 @@ int init_pwm(void)
 
 int set_pwm_duty_cycle(int duty_percent)
 {
-    char command[256];
+    pwm_status_t st;
 
-    if (duty_percent < 0)
-        duty_percent = 0;
-    if (duty_percent > 100)
-        duty_percent = 100;
-
-    int duty_ns = (current_period_ns * duty_percent) / 100;
-
-    if (duty_ns > current_period_ns)
-    {
-        duty_ns = current_period_ns;
-        duty_percent = 100;
-        printf("Warning: Duty cycle clamped to 100%%\n");
-    }
-
-    snprintf(command, sizeof(command), "echo %d > /sys/class/pwm/pwmchip0/pwm0/duty_cycle", duty_ns);
-    if (system(command) == 0)
-    {
-        current_duty_percent = duty_percent;
-        printf("PWM duty cycle set to: %d%% (%d ns)\n", duty_percent, duty_ns);
-    }
-    else
+    if (pwm_set_percent(pwm_main, duty_percent) < 0)
     {
         printf("Failed to set PWM duty cycle\n");
         return -1;
     }
-
+    pwm_get_status(pwm_main, &st);
+    printf("PWM duty cycle set to: %d%% (%u ns)\n", st.duty_percent, st.duty_ns);
     return 0;
 }
 
 int set_pwm_frequency(int freq_hz)
 {
-    char command[256];
+    pwm_status_t st;
 
     if (freq_hz < 1)
         freq_hz = 1;
     if (freq_hz > 100000)
         freq_hz = 100000;
 
-    int new_period_ns = 1000000000 / freq_hz;
-
-    system("echo 0 > /sys/class/pwm/pwmchip0/pwm0/enable");
-
-    // 设置新周期
-    snprintf(command, sizeof(command), "echo %d > /sys/class/pwm/pwmchip0/pwm0/period", new_period_ns);
-    if (system(command) != 0)
+    // 占空比百分比保持不变，pwm_set_period 按方向安排 period/duty_cycle 写入顺序，不需要先关闭输出
+    if (pwm_set_period(pwm_main, 1000000000u / freq_hz) < 0)
     {
         printf("Failed to set PWM period\n");
-        // 恢复原状态
-        system("echo 1 > /sys/class/pwm/pwmchip0/pwm0/enable");
         return -1;
     }
-    // 更新周期
-    current_period_ns = new_period_ns;
-
-    // 重新计算并设置占空比（保持当前百分比）
-    int duty_ns = (current_period_ns * current_duty_percent) / 100;
-
-    if (duty_ns > current_period_ns)
-    {
-        duty_ns = current_period_ns;
-        current_duty_percent = 100;
-        printf("Warning: Duty cycle adjusted to 100%% for new frequency\n");
-    }
-
-    snprintf(command, sizeof(command), "echo %d > /sys/class/pwm/pwmchip0/pwm0/duty_cycle", duty_ns);
-    if (system(command) != 0)
-    {
-        printf("Failed to set PWM duty cycle after frequency change\n");
-        return -1;
-    }
-    system("echo 1 > /sys/class/pwm/pwmchip0/pwm0/enable");
-
-    printf("PWM frequency set to: %d Hz (period: %d ns, duty: %d%% = %d ns)\n",
-           freq_hz, new_period_ns, current_duty_percent, duty_ns);
+    pwm_get_status(pwm_main, &st);
+    printf("PWM frequency set to: %d Hz (period: %u ns, duty: %d%% = %u ns)\n",
+           freq_hz, st.period_ns, st.duty_percent, st.duty_ns);
     return 0;
 }
 
-// PWM 控制函数
+// PWM 控制函数，手动设置会停止正在执行的曲线
 int pwm_set_duty(int duty_percent)
 {
+    pwm_profile_stop(pwm_main);
     pthread_mutex_lock(&pwm_mutex);
     int result = set_pwm_duty_cycle(duty_percent);
     pthread_mutex_unlock(&pwm_mutex);
@@ -223,439 +187,707 @@ int pwm_set_freq(int freq_hz)
     return result;
 }
 
-// 获取当前 PWM 状态信息
-void get_pwm_status(void)
+/*
+ * @description : 在主PWM通道上执行曲线，立即返回，由 pwm_task 按时间推进
+ * @return : 曲线编号，用于 pwm_profile_finished()；0 表示PWM未初始化或曲线无效
+ */
+uint32_t pwm_start_profile(const pwm_profile_t *profile)
 {
-    int duty_ns = (current_period_ns * current_duty_percent) / 100;
-    int freq_hz = 1000000000 / current_period_ns;
+    uint32_t seq = pwm_profile_start(pwm_main, profile);
 
-    printf("PWM Status: Freq=%d Hz, Period=%d ns, Duty=%d%% (%d ns)\n",
-           freq_hz, current_period_ns, current_duty_percent, duty_ns);
+    if (seq == 0)
+        printf("Failed to start PWM profile\n");
+    return seq;
 }
 
-// ============================================================================
-// 任务函数
-// ============================================================================
-void *motor_a_task(void *arg __attribute__((unused)))
+// 曲线 seq 是否已结束，done_ns 返回结束时间
+int pwm_profile_finished(uint32_t seq, uint64_t *done_ns)
 {
-    printf("Motor A task started\n");
-
-    while (running)
-    {
-        Motor_Run_Circle(&motor_data_A, Target_Circle_A, Enable, "A");
-        usleep(1000);
-    }
-
-    printf("Motor A task stopped\n");
-    return NULL;
+    return pwm_profile_done(pwm_main, seq, done_ns);
 }
 
-void *motor_b_task(void *arg __attribute__((unused)))
+// 获取当前 PWM 状态信息
+void get_pwm_status(void)
 {
-    printf("Motor B task started\n");
+    pwm_profile_stats_t ps;
+    pwm_status_t st;
 
-    while (running)
+    if (pwm_get_status(pwm_main, &st) < 0)
     {
-        Motor_Run_Circle(&motor_data_B, Target_Circle_B, Enable, "B");
-        usleep(1000);
+        printf("PWM Status: not initialized\n");
+        return;
     }
+    printf("PWM Status: Freq=%u Hz, Period=%u ns, Duty=%d%% (%u ns), %s, %llu writes (max %.1f us)\n",
+           1000000000u / st.period_ns, st.period_ns, st.duty_percent, st.duty_ns,
+           st.enabled ? "enabled" : "disabled", (unsigned long long)st.writes, st.write_ns_max / 1e3);
+    if (pwm_profile_get_stats(pwm_main, &ps) == 0 && ps.started > 0)
+        printf("PWM Profile: %s, profiles %u started / %u completed / %u aborted, %llu updates, max late %.1f us\n",
+               ps.active ? "running" : "idle", ps.started, ps.completed, ps.aborted,
+               (unsigned long long)ps.updates, ps.late_ns_max / 1e3);
+}
 
-    printf("Motor B task stopped\n");
-    return NULL;
+// ============================================================================
+// 任务函数
+// ============================================================================
+// 请求打印一次状态，PRINT_DELAY_NS 内的多次请求合并为一次
+static void print_request(void)
+{
+    // 定时器已在计时就不推迟
+    if (print_pending)
+        return;
+    print_pending = 1;
+    reactor_timer_arm(print_timer, monotonic_ns() + PRINT_DELAY_NS);
 }
 
-void *motor_c_task(void *arg __attribute__((unused)))
+static void print_reactor_stats(void)
 {
-    printf("Motor C task started\n");
+    reactor_stats_t st;
+    int i;
+
+    reactor_get_stats(&st);
+    printf("Event loop: %llu wakeups", (unsigned long long)st.wakeups);
+    for (i = 0; i < st.count; i++)
+        printf(", %s %llu (max %.1f us)", st.source[i].name,
+               (unsigned long long)st.source[i].events, st.source[i].handler_ns_max / 1e3);
+    printf("\n");
+}
 
-    while (running)
-    {
-        Motor_Run_Circle(&motor_data_C, Target_Circle_C, Enable, "C");
-        usleep(1000);
-    }
+static void print_vision_stats(void)
+{
+    const vision_parser_stats_t *vs = &serial_vision.stats;
+    vision_result_t r;
+
+    if (vs->lines == 0)
+        return;
+    printf("Vision results: %llu lines, %llu results, %llu errors, %llu truncated\n",
+           (unsigned long long)vs->lines, (unsigned long long)vs->results,
+           (unsigned long long)vs->errors, (unsigned long long)vs->truncated);
+    if (!vision_get_latest(&r))
+        return;
+    printf("  latest #%u: %s (%s)", r.seq, r.label, r.color);
+    if (r.has_blob)
+        printf(" at (%d,%d) area %d", r.x, r.y, r.area);
+    else if (r.no_blob)
+        printf(" stable, no blob");
+    printf(", %.0f ms ago\n", (monotonic_ns() - r.stamp_ns) / 1e6);
+}
 
-    printf("Motor C task stopped\n");
-    return NULL;
+static void print_serial_stats(void)
+{
+    const proto_stats_t *st = &serial_rx.stats;
+    const usart_parser_stats_t *cs = &serial_cmd.stats;
+
+    if (serial_fd < 0)
+        return;
+    printf("Serial protocol: rx frames=%llu crc errors=%llu resyncs=%llu discarded=%llu overflow=%llu, acks tx=%llu rx=%llu\n",
+           (unsigned long long)st->frames, (unsigned long long)st->crc_errors,
+           (unsigned long long)st->resyncs, (unsigned long long)st->discarded, (unsigned long long)st->overflows,
+           (unsigned long long)serial_acks_tx, (unsigned long long)serial_acks_rx);
+    printf("Serial commands: %llu bytes, %llu commands in %llu lines, %llu errors\n",
+           (unsigned long long)cs->bytes, (unsigned long long)cs->commands,
+           (unsigned long long)cs->lines, (unsigned long long)cs->errors);
+    print_vision_stats();
 }
 
-void *motor_d_task(void *arg __attribute__((unused)))
+static void print_event(int fd __attribute__((unused)), uint32_t events __attribute__((unused)),
+                        void *ctx __attribute__((unused)))
 {
-    printf("Motor D task started\n");
+    print_pending = 0;
+    pthread_mutex_lock(&print_mutex);
+
+    printf("------------------------\n");
+    Print_Motor_IO_State("A", &motor_data_A);
+    Print_Motor_IO_State("B", &motor_data_B);
+    Print_Motor_IO_State("C", &motor_data_C);
+    Print_Motor_IO_State("D", &motor_data_D);
+    step_sched_print_stats();
+    Print_Motor_Timing("A", &motor_data_A);
+    Print_Motor_Timing("B", &motor_data_B);
+    Print_Motor_Timing("C", &motor_data_C);
+    Print_Motor_Timing("D", &motor_data_D);
+    Print_GPIO_Write_Stats();
+    recipe_print_stats();
+    sample_print_stats();
+    print_serial_stats();
+    print_reactor_stats();
+    printf("------------------------\n");
+    pthread_mutex_unlock(&print_mutex);
+}
 
-    while (running)
-    {
-        Motor_Run_Circle(&motor_data_D, Target_Circle_D, Enable, "D");
-        usleep(1000);
-    }
+// 发送一帧，seq 自动递增
+static int serial_send_proto(uint8_t type, const void *payload, int len)
+{
+    uint8_t buf[PROTO_MAX_FRAME];
+    int n = proto_encode(type, serial_tx_seq++, payload, len, buf, sizeof(buf));
 
-    printf("Motor D task stopped\n");
-    return NULL;
+    return n < 0 ? -1 : serial_send_data(buf, n);
 }
 
-void *print_task(void *arg __attribute__((unused)))
+static void serial_ack(uint8_t seq, uint8_t status)
 {
-    printf("Print task started\n");
-
-    while (running)
-    {
-        if (Printf_Flag == 0)
-        {
-            usleep(500000);
-            continue;
-        }
-        pthread_mutex_lock(&print_mutex);
+    uint8_t payload[2] = {seq, status};
 
-        printf("------------------------\n");
-        Print_Motor_IO_State("A", &motor_data_A);
-        Print_Motor_IO_State("B", &motor_data_B);
-        Print_Motor_IO_State("C", &motor_data_C);
-        Print_Motor_IO_State("D", &motor_data_D);
-        printf("------------------------\n");
-        Printf_Flag = 0;
-        pthread_mutex_unlock(&print_mutex);
+    if (serial_send_proto(PROTO_ACK, payload, sizeof(payload)) > 0)
+        serial_acks_tx++;
+}
 
-        usleep(100000);
-    }
+static void print_ph_result(float value)
+{
+    static int reference_shown = 0;
 
-    printf("Print task stopped\n");
-    return NULL;
+    printf("PH is: %.1f\n", value);
+    if (value < 7.0)
+        printf("→ 当前为酸性环境。\n");
+    else if (value > 7.0)
+        printf("→ 当前为碱性环境。\n");
+    else
+        printf("→ 当前为中性环境。\n");
+
+    // 参考表只在第一次结果时打印，连续结果不刷屏
+    if (reference_shown)
+        return;
+    reference_shown = 1;
+    printf("常见物质PH值参考:\n");
+    printf("  - 柠檬汁: 2.0\n");
+    printf("  - 可乐: 2.5\n");
+    printf("  - 雨水: 5.5\n");
+    printf("  - 纯净水: 7.0\n");
+    printf("  - 海水: 8.0\n");
+    printf("  - 肥皂水: 10.0\n");
+    printf("  - 漂白水: 12.5\n");
 }
 
-void *serial_task(void *arg __attribute__((unused)))
+// 执行运动命令帧，返回 ACK 状态
+static uint8_t serial_motion(const proto_frame_t *f)
 {
-    printf("Serial task started\n");
+    float targets[STEP_AXES] = {0};
+    uint8_t mask, flags;
+    int axis, n = 0;
+    double planned;
 
-    if (init_serial_port("/dev/ttyS9", 115200) < 0)
+    if (f->len < 2)
+        return PROTO_ACK_INVALID;
+    mask = f->payload[0];
+    flags = f->payload[1];
+    if (mask == 0 || mask >= (1u << STEP_AXES))
+        return PROTO_ACK_INVALID;
+    for (axis = 0; axis < STEP_AXES; axis++)
     {
-        printf("Failed to initialize serial port /dev/ttyS9, serial task will exit\n");
-        return NULL;
+        if (mask & (1u << axis))
+            n++;
     }
+    if (f->len != 2 + 4 * n)
+        return PROTO_ACK_INVALID;
 
-    unsigned char recv_buffer[256];
-    int recv_len = 0;
-
-    while (running)
+    n = 0;
+    for (axis = 0; axis < STEP_AXES; axis++)
     {
-        pthread_mutex_lock(&serial_mutex);
-        recv_len = func_receive_frame(serial_fd, recv_buffer, sizeof(recv_buffer) - 1);
+        if (!(mask & (1u << axis)))
+            continue;
+        targets[axis] = proto_get_f32(&f->payload[2 + 4 * n++]);
+        if (!(targets[axis] >= 0)) // 负数和 NaN
+            return PROTO_ACK_INVALID;
+        targets[axis] = clamp_axis_target(axis, targets[axis]);
+    }
 
-        if (recv_len > 0)
+    if (flags & PROTO_MOTION_QUEUE)
+    {
+        for (axis = 0; axis < STEP_AXES; axis++)
         {
-            if (recv_len == 4)
-            {
-                float value;
-                memcpy(&value, recv_buffer, 4);
-                printf("PH is: %.1f\n", value);
-                if (value < 7.0)
-                    printf("→ 当前为酸性环境。\n");
-                else if (value > 7.0)
-                    printf("→ 当前为碱性环境。\n");
-                else
-                    printf("→ 当前为中性环境。\n");
-
-                printf("常见物质PH值参考:\n");
-                printf("  - 柠檬汁: 2.0\n");
-                printf("  - 可乐: 2.5\n");
-                printf("  - 雨水: 5.5\n");
-                printf("  - 纯净水: 7.0\n");
-                printf("  - 海水: 8.0\n");
-                printf("  - 肥皂水: 10.0\n");
-                printf("  - 漂白水: 12.5\n");
-            }
-            const char *response = "OK\r\n";
-            func_send_frame(serial_fd, (const unsigned char *)response, strlen(response));
+            if ((mask & (1u << axis)) && step_sched_enqueue(axis, targets[axis]) < 0)
+                return PROTO_ACK_BUSY;
         }
-        else if (recv_len < 0)
+    }
+    else
+    {
+        // 在本线程打印规划结果，调度线程是实时线程，不做输出
+        planned = step_sched_move_coordinated(targets, mask);
+        if (planned > 0)
+            printf("Coordinated move: axes 0x%x, planned %.3f s\r\n", mask, planned);
+    }
+    return PROTO_ACK_OK;
+}
+
+static void serial_handle_frame(const proto_frame_t *f)
+{
+    switch (f->type)
+    {
+    case PROTO_PH_RESULT:
+        if (f->len != 4)
         {
-            printf("Serial receive error\n");
+            serial_ack(f->seq, PROTO_ACK_INVALID);
+            break;
         }
-
-        pthread_mutex_unlock(&serial_mutex);
-        usleep(10000);
+        print_ph_result(proto_get_f32(f->payload));
+        serial_ack(f->seq, PROTO_ACK_OK);
+        break;
+    case PROTO_MOTION:
+        serial_ack(f->seq, serial_motion(f));
+        break;
+    case PROTO_ACK:
+        // 本机只发送 ACK，对端的 ACK 只计数
+        serial_acks_rx++;
+        break;
+    default:
+        serial_ack(f->seq, PROTO_ACK_UNSUPPORTED);
+        break;
     }
+}
 
-    if (serial_fd != -1)
-    {
-        close(serial_fd);
-        serial_fd = -1;
+// 串口文本命令：与控制台的 A:10、$A:10、$ 相同，每行结束应答 OK 或 ERR
+static void serial_command(const usart_cmd_t *cmd, void *ctx __attribute__((unused)))
+{
+    const char *reply;
+    int axis;
+
+    switch (cmd->type)
+    {
+    case USART_CMD_TARGET:
+        Set_Motor_Target(cmd->axis, clamp_axis_target(cmd->axis, cmd->target));
+        if (cmd->enable)
+            Begin_Motor_flag(axis_motor[cmd->axis]);
+        break;
+    case USART_CMD_BEGIN_ALL:
+        for (axis = 0; axis < STEP_AXES; axis++)
+            Begin_Motor_flag(axis_motor[axis]);
+        break;
+    default: // USART_CMD_LINE_END
+        reply = cmd->errors ? "ERR\r\n" : "OK\r\n";
+        serial_send_data((const unsigned char *)reply, strlen(reply));
+        print_request();
+        break;
     }
+}
 
-    printf("Serial task stopped\n");
-    return NULL;
+// 视觉结果：发布给处理引擎，标签变化时打印
+static void serial_vision_result(const vision_result_t *result, void *ctx __attribute__((unused)))
+{
+    static char shown[VISION_LABEL_MAX];
+    vision_result_t r = *result;
+
+    vision_publish(&r);
+    if (strcmp(shown, r.label) == 0)
+        return;
+    memcpy(shown, r.label, sizeof(shown));
+    printf("Vision: %s (%s)", r.label, r.color);
+    if (r.has_blob)
+        printf(" at (%d,%d) area %d", r.x, r.y, r.area);
+    printf("\n");
 }
 
-void *pwm_task(void *arg __attribute__((unused)))
+// 帧外文本按行分流：以 { 开头的行是视觉结果，其余是文本命令
+static void serial_text_byte(uint8_t byte, void *ctx __attribute__((unused)))
 {
-    printf("PWM task started\n");
+    if (serial_text_bol)
+        serial_text_json = byte == '{';
+    serial_text_bol = byte == '\n' || byte == '\r';
+    if (serial_text_json)
+        vision_parser_byte(&serial_vision, byte);
+    else
+        usart_parser_byte(&serial_cmd, byte);
+}
 
-    if (init_pwm() < 0)
+/*
+ * @description : 串口可读时调用，读出已到达的字节送入帧解析器，逐帧处理并应答
+ *                读操作可能拆开或合并帧，解析器负责重组
+ */
+static void serial_event(int fd, uint32_t events, void *ctx __attribute__((unused)))
+{
+    unsigned char recv_buffer[256];
+    int recv_len = func_receive_frame(fd, recv_buffer, sizeof(recv_buffer));
+    proto_frame_t frame;
+
+    if (recv_len > 0)
     {
-        printf("Failed to initialize PWM, PWM task will exit\n");
-        return NULL;
+        proto_feed(&serial_rx, recv_buffer, recv_len);
+        while (proto_next(&serial_rx, &frame))
+            serial_handle_frame(&frame);
     }
-
-    int duty_cycle = 0;
-    int direction = 1;
-
-    while (running)
+    else if (recv_len < 0 && errno != EAGAIN && errno != EINTR)
     {
-        pthread_mutex_lock(&pwm_mutex);
-        if (direction == 1)
-        {
-            duty_cycle = 0;
-            set_pwm_duty_cycle(duty_cycle);
-            direction = 0;
-        }
-        pthread_mutex_unlock(&pwm_mutex);
-        usleep(100000);
+        printf("Serial receive error\n");
     }
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        printf("Serial port closed\n");
+        reactor_del_fd(fd);
+    }
+}
 
-    system("echo 0 > /sys/class/pwm/pwmchip0/pwm0/enable");
-    system("echo 0 > /sys/class/pwm/pwmchip0/unexport");
+// 新曲线提交或曲线定时器到期：推进曲线并把定时器设到下一个更新时刻
+static void pwm_event(int fd __attribute__((unused)), uint32_t events __attribute__((unused)), void *ctx)
+{
+    int timer = *(int *)ctx;
+    uint64_t next = pwm_profile_poll(monotonic_ns());
 
-    printf("PWM task stopped\n");
-    return NULL;
+    // 没有 eventfd 时新曲线无法唤醒，空闲时也按 PWM_PROFILE_TICK_NS 轮询
+    if (next == 0 && pwm_profile_fd() < 0)
+        next = monotonic_ns() + PWM_PROFILE_TICK_NS;
+    reactor_timer_arm(timer, next);
 }
 
-void *console_task(void *arg __attribute__((unused)))
+
+static void console_banner(void)
 {
-    char input[128];
     printf("控制台任务已启动，输入如 A:10 或 $A:10 修改目标圈数和使能\n");
     printf("PWM控制: P:50 设置占空比50%%, F:1000 设置频率1000Hz, PWM 查看状态\n");
+    printf("PWM曲线: PR:RAMP:80:300,HOLD:1000,RAMP:0:300 斜坡/保持，PR:BURST:80:50:50:10 脉冲串\n");
+    printf("运动限制: V:C:8,8,80 设置C轴 速度(圈/秒),加速度(圈/秒²),加加速度(圈/秒³，0为梯形)\n");
+    printf("分辨率: R:A:200,16 设置A轴 每圈步数,细分数（默认%d,%d，每步两个PUL边沿）\n", PLUSE, MICROSTEP);
+    printf("运动队列: Q:A:5,A:0,C:18 依次排队，前一条结束后立即执行（每轴最多%d条）\n", MOTION_QUEUE_DEPTH);
     printf(">> ");
     fflush(stdout);
+}
 
-    while (running)
+static int console_open = 1; // stdin 未到 EOF
+
+// 处理控制台的一行命令
+static void console_handle_line(char *input)
+{
+    if (strcmp(input, "@") == 0)
+    {
+        print_request();
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
+
+    // PWM 控制命令
+    if (strncmp(input, "P:", 2) == 0)
     {
-        fd_set readfds;
-        struct timeval timeout;
-        FD_ZERO(&readfds);
-        FD_SET(STDIN_FILENO, &readfds);
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
+        int duty = atoi(input + 2);
+        pwm_set_duty(duty);
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
+
+    if (strncmp(input, "PR:", 3) == 0)
+    {
+        pwm_profile_t profile;
+        uint32_t seq;
+
+        if (pwm_profile_parse(input + 3, &profile) < 0)
+            printf("格式错误，应为 PR:RAMP:80:300,HOLD:1000,RAMP:0:300 或 PR:BURST:80:50:50:10\n");
+        else if ((seq = pwm_start_profile(&profile)) != 0)
+            printf("PWM曲线 #%u 已开始，%d 段，共 %u ms\n", seq, profile.count, pwm_profile_duration_ms(&profile));
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
 
-        int select_result = select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout);
+    if (strncmp(input, "F:", 2) == 0)
+    {
+        int freq = atoi(input + 2);
+        pwm_set_freq(freq);
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
 
-        if (select_result < 0)
+    if (strncmp(input, "V:", 2) == 0)
+    {
+        char axis = 0;
+        float velocity = 0, accel = 0, jerk = 0;
+        if (sscanf(input + 2, "%c:%f,%f,%f", &axis, &velocity, &accel, &jerk) == 4 &&
+            axis >= 'A' && axis <= 'D')
         {
-            if (!running)
-                break;
-            continue;
+            Set_Motor_Limits(axis - 'A', velocity, accel, jerk);
         }
-        else if (select_result == 0)
+        else
         {
-            if (!running)
-                break;
-            continue;
+            printf("格式错误，应为 V:C:8,8,80\n");
         }
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
 
-        if (!fgets(input, sizeof(input), stdin))
+    if (strncmp(input, "Q:", 2) == 0)
+    {
+        char *item = strtok(input + 2, ",");
+        while (item != NULL)
         {
-            if (!running)
-                break;
-            continue;
+            char axis = 0;
+            float value = 0;
+            while (*item == ' ')
+                item++;
+            if (sscanf(item, "%c:%f", &axis, &value) != 2 || axis < 'A' || axis > 'D')
+                printf("格式错误，应为 Q:A:5,C:18\n");
+            else if (step_sched_enqueue(axis - 'A', value) < 0)
+                printf("%c 轴运动队列已满\n", axis);
+            else
+                printf("已排队 %c: %.2f\n", axis, value);
+            item = strtok(NULL, ",");
         }
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
 
-        input[strcspn(input, "\n")] = 0;
-
-        if (strcmp(input, "@") == 0)
+    if (strncmp(input, "R:", 2) == 0)
+    {
+        char axis = 0;
+        int steps = 0, micro = 0;
+        if (sscanf(input + 2, "%c:%d,%d", &axis, &steps, &micro) == 3 &&
+            axis >= 'A' && axis <= 'D')
         {
-            Printf_Flag = 1;
-            printf(">> ");
-            fflush(stdout);
-            continue;
+            Set_Motor_Resolution(axis - 'A', steps, micro);
         }
-
-        // PWM 控制命令
-        if (strncmp(input, "P:", 2) == 0)
+        else
         {
-            int duty = atoi(input + 2);
-            pwm_set_duty(duty);
-            printf(">> ");
-            fflush(stdout);
-            continue;
+            printf("格式错误，应为 R:A:200,16\n");
         }
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
 
-        if (strncmp(input, "F:", 2) == 0)
+    // 样品装载：S:3 装3个常规样品，S:2,wash.txt 指定配方；STAT 或 STAT:wash.txt 装一个急诊样品
+    if (strncmp(input, "S:", 2) == 0 || strncmp(input, "STAT", 4) == 0)
+    {
+        int stat = input[1] == 'T';
+        int count = 1;
+        char *file = NULL;
+        char *arg = stat ? input + 4 : input + 2;
+
+        if (stat && *arg == ':')
         {
-            int freq = atoi(input + 2);
-            pwm_set_freq(freq);
-            printf(">> ");
-            fflush(stdout);
-            continue;
+            file = arg + 1;
         }
-
-        if (strcmp(input, "PWM") == 0)
+        else if (!stat)
         {
-            get_pwm_status();
-            printf(">> ");
-            fflush(stdout);
-            continue;
+            count = atoi(arg);
+            file = strchr(arg, ',');
+            if (file)
+                file++;
         }
-
-        if (strcmp(input, "$") == 0)
+        if (count <= 0 || (stat && *arg != '\0' && *arg != ':'))
         {
-            pthread_mutex_lock(&motor_data_A.mutex);
-            motor_data_A.Process_Flag = 1;
-            motor_data_A.State = 0;
-            pthread_mutex_unlock(&motor_data_A.mutex);
-
-            pthread_mutex_lock(&motor_data_B.mutex);
-            motor_data_B.Process_Flag = 1;
-            motor_data_B.State = 0;
-            pthread_mutex_unlock(&motor_data_B.mutex);
-
-            pthread_mutex_lock(&motor_data_C.mutex);
-            motor_data_C.Process_Flag = 1;
-            motor_data_C.State = 0;
-            pthread_mutex_unlock(&motor_data_C.mutex);
-
-            pthread_mutex_lock(&motor_data_D.mutex);
-            motor_data_D.Process_Flag = 1;
-            motor_data_D.State = 0;
-            pthread_mutex_unlock(&motor_data_D.mutex);
-
-            Printf_Flag = 1;
-            Process_continue_flag = 1;
-            printf("所有电机EN已置为1\n");
-            printf(">> ");
-            fflush(stdout);
-            continue;
+            printf("格式错误，应为 S:3、S:2,recipe.txt 或 STAT\n");
+            count = 0;
         }
-
-        char *token = strtok(input, ",");
-        while (token != NULL)
+        while (count-- > 0)
         {
-            while (*token == ' ')
-                token++;
-            char *end = token + strlen(token) - 1;
-            while (end > token && *end == ' ')
-                *end-- = '\0';
-
-            int enable = 0;
-            char motor = 0;
-            float value = 0;
-
-            if (token[0] == '$')
+            int id = sample_enqueue(stat, file && *file ? file : NULL);
+            if (id < 0)
             {
-                enable = 1;
-                motor = token[1];
-                if (sscanf(token + 2, ":%f", &value) != 1)
-                {
-                    printf("格式错误，应为 $A:10\n");
-                    token = strtok(NULL, ",");
-                    continue;
-                }
+                printf("样品装载失败（配方无效或队列已满）\n");
+                break;
             }
-            else
+            printf("已装载样品 S%d%s\n", id, stat ? "(STAT)" : "");
+        }
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
+
+    if (strcmp(input, "PWM") == 0)
+    {
+        get_pwm_status();
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
+
+    if (strcmp(input, "$") == 0)
+    {
+        Begin_Motor_flag(&motor_data_A);
+        Begin_Motor_flag(&motor_data_B);
+        Begin_Motor_flag(&motor_data_C);
+        Begin_Motor_flag(&motor_data_D);
+
+        print_request();
+        printf("所有电机EN已置为1\n");
+        if (sample_enqueue(SAMPLE_ROUTINE, NULL) < 0)
+            printf("样品队列已满\n");
+        printf(">> ");
+        fflush(stdout);
+        return;
+    }
+
+    char *token = strtok(input, ",");
+    while (token != NULL)
+    {
+        while (*token == ' ')
+            token++;
+        char *end = token + strlen(token) - 1;
+        while (end > token && *end == ' ')
+            *end-- = '\0';
+
+        int enable = 0;
+        char motor = 0;
+        float value = 0;
+
+        if (token[0] == '$')
+        {
+            enable = 1;
+            motor = token[1];
+            if (sscanf(token + 2, ":%f", &value) != 1)
             {
-                motor = token[0];
-                if (sscanf(token + 1, ":%f", &value) != 1)
-                {
-                    printf("格式错误，应为 A:10\n");
-                    token = strtok(NULL, ",");
-                    continue;
-                }
+                printf("格式错误，应为 $A:10\n");
+                token = strtok(NULL, ",");
+                continue;
             }
-
-            switch (motor)
+        }
+        else
+        {
+            motor = token[0];
+            if (sscanf(token + 1, ":%f", &value) != 1)
             {
-            case 'A':
-                if (value > 10.5f)
-                {
-                    value = 10.5f;
-                    printf("A电机最大值为10.5\n");
-                }
-                Set_Motor_Target(Motor_A, value);
-                pthread_mutex_lock(&motor_data_A.mutex);
-                if (enable)
-                {
-                    motor_data_A.Process_Flag = 1;
-                    motor_data_A.State = 0;
-                }
-                pthread_mutex_unlock(&motor_data_A.mutex);
-                break;
-            case 'B':
-                if (value > 9.0f)
-                {
-                    value = 9.0f;
-                    printf("B电机最大值为9.0\n");
-                }
-                Set_Motor_Target(Motor_B, value);
-                pthread_mutex_lock(&motor_data_B.mutex);
-                if (enable)
-                {
-                    motor_data_B.Process_Flag = 1;
-                    motor_data_B.State = 0;
-                }
-                pthread_mutex_unlock(&motor_data_B.mutex);
-                break;
-            case 'C':
-                if (value > 18.0f)
-                {
-                    value = 18.0f;
-                    printf("C电机最大值为18.0\n");
-                }
-                Set_Motor_Target(Motor_C, value);
-                pthread_mutex_lock(&motor_data_C.mutex);
-                if (enable)
-                {
-                    motor_data_C.Process_Flag = 1;
-                    motor_data_C.State = 0;
-                }
-                pthread_mutex_unlock(&motor_data_C.mutex);
-                break;
-            case 'D':
-                Set_Motor_Target(Motor_D, value);
-                pthread_mutex_lock(&motor_data_D.mutex);
-                if (enable)
-                {
-                    motor_data_D.Process_Flag = 1;
-                    motor_data_D.State = 0;
-                }
-                pthread_mutex_unlock(&motor_data_D.mutex);
-                break;
-            default:
-                printf("未知电机: %c\n", motor);
+                printf("格式错误，应为 A:10\n");
                 token = strtok(NULL, ",");
                 continue;
             }
-            printf("已设置 %c: %.2f\n", motor, value);
+        }
+
+        if (motor < 'A' || motor >= 'A' + STEP_AXES)
+        {
+            printf("未知电机: %c\n", motor);
             token = strtok(NULL, ",");
+            continue;
         }
-        Printf_Flag = 1;
-        printf(">> ");
-        fflush(stdout);
+        value = clamp_axis_target(motor - 'A', value);
+        Set_Motor_Target(motor - 'A', value);
+        if (enable)
+            Begin_Motor_flag(axis_motor[motor - 'A']);
+        printf("已设置 %c: %.2f\n", motor, value);
+        token = strtok(NULL, ",");
+    }
+    print_request();
+    printf(">> ");
+    fflush(stdout);
+}
+
+/*
+ * @description : stdin 可读时调用，按行拆分后逐行处理
+ *                直接 read() 而不用 fgets()，stdio 缓冲里残留的行不会再触发 epoll
+ */
+static void console_event(int fd, uint32_t events __attribute__((unused)), void *ctx __attribute__((unused)))
+{
+    static char line[CONSOLE_LINE_MAX];
+    static int len = 0;
+    static int overflow = 0; // 行过长，丢弃到下一个换行
+    char buf[256];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    ssize_t k;
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    {
+        // stdin 关闭后不再监听，其他事件源照常工作
+        reactor_del_fd(fd);
+        console_open = 0;
+        printf("控制台输入已关闭\n");
+        return;
+    }
+    for (k = 0; k < n; k++)
+    {
+        if (buf[k] == '\n')
+        {
+            line[len] = '\0';
+            if (!overflow)
+                console_handle_line(line);
+            len = 0;
+            overflow = 0;
+        }
+        else if (len < CONSOLE_LINE_MAX - 1)
+        {
+            line[len++] = buf[k];
+        }
+        else
+        {
+            overflow = 1;
+        }
+    }
+}
+
+/*
+ * @description : 事件循环线程：串口、控制台、PWM曲线和状态打印
+ *                只在 fd 有数据、定时器到期或收到退出请求时醒来，代替原来各自轮询的四个线程
+ */
+void *io_task(void *arg __attribute__((unused)))
+{
+    static int pwm_timer = -1;
+
+    printf("I/O task started\n");
+
+    if (reactor_init() < 0)
+    {
+        printf("Failed to create event loop, I/O task will exit\n");
+        return NULL;
+    }
+
+    print_timer = reactor_add_timer(print_event, NULL, "print");
+    print_pending = 1;
+    reactor_timer_arm(print_timer, monotonic_ns());
+
+    usart_parser_init(&serial_cmd, serial_command, NULL);
+    vision_parser_init(&serial_vision, serial_vision_result, NULL);
+    proto_parser_init(&serial_rx, serial_text_byte, NULL);
+    if (init_serial_port("/dev/ttyS9", 115200) < 0)
+        printf("Failed to initialize serial port /dev/ttyS9, continuing without serial\n");
+    else if (reactor_add_fd(serial_fd, EPOLLIN, serial_event, NULL, "serial") < 0)
+        perror("serial: epoll_ctl");
+
+    if (init_pwm() < 0)
+    {
+        printf("Failed to initialize PWM, continuing without PWM\n");
+    }
+    else
+    {
+        pwm_timer = reactor_add_timer(pwm_event, &pwm_timer, "pwm");
+        if (pwm_profile_init() == 0)
+            reactor_add_counter(pwm_profile_fd(), pwm_event, &pwm_timer, "pwm kick");
+        else
+            reactor_timer_arm(pwm_timer, monotonic_ns());
+    }
+
+    console_banner();
+    if (reactor_add_fd(STDIN_FILENO, EPOLLIN, console_event, NULL, "console") < 0)
+    {
+        // 普通文件不能用 epoll，它总是可读，直接读完
+        while (running && console_open)
+            console_event(STDIN_FILENO, EPOLLIN, NULL);
+    }
+
+    // 在 reactor_init 之前收到的退出信号无法唤醒事件循环，这里再检查一次
+    if (running)
+        reactor_run();
+
+    pwm_close_all();
+    if (serial_fd != -1)
+    {
+        close(serial_fd);
+        serial_fd = -1;
     }
-    printf("控制台任务退出\n");
+    reactor_close();
+    print_timer = -1;
+
+    printf("I/O task stopped\n");
     return NULL;
 }
-int Finish_flag = 1; // 用于标记处理任务是否完成
+
 void *process_task(void *arg __attribute__((unused)))
 {
     printf("Process task started\n");
 
     while (running)
     {
-        if (Process_continue_flag == 1 && Finish_flag == 1)
-        {
-            Finish_flag = 0;
-            motor_data_A.EN = Enable;
-            motor_data_B.EN = Enable;
-            motor_data_C.EN = Enable;
-            motor_data_A.Process_Flag = 1;
-            motor_data_B.Process_Flag = 1;
-            motor_data_C.Process_Flag = 1;
-            My_Motor_process();
-            // Process_continue_flag = 0;
-        }
-        if (motor_data_A.State == 1 && motor_data_B.State == 1 &&
-            motor_data_C.State == 1)
+        uint64_t now;
+        uint64_t deadline;
+        uint64_t timeout = SAMPLE_IDLE_WAIT_NS;
+
+        sample_poll(monotonic_ns());
+
+        // 阻塞到电机到位通知、配方等待到期或装载新样品，不再固定周期轮询
+        deadline = sample_next_deadline();
+        if (deadline)
         {
-            Finish_flag = 1; // 所有电机完成后，设置标志位
-            usleep(500000);
+            now = monotonic_ns();
+            timeout = deadline > now ? deadline - now : 0;
         }
-        usleep(1000000);
+        if (timeout)
+            Motor_Done_Wait(timeout);
     }
 
     printf("Process task stopped\n");
@@ -670,23 +902,11 @@ int get_task_priority(int task_index)
     switch (task_index)
     {
     case 0:
-        return 80; // Motor A
+        return 80; // Step scheduler (Motor A~D)
     case 1:
-        return 80; // Motor B
-    case 2:
-        return 80; // Motor C
-    case 3:
-        return 80; // Motor D
-    case 4:
-        return 10; // Print task
-    case 5:
-        return 50; // Console task
-    case 6:
         return 10; // Process task
-    case 7:
-        return 60; // Serial task
-    case 8:
-        return 40; // PWM task
+    case 2:
+        return 60; // I/O task（串口、控制台、PWM、打印）
     default:
         return 30;
     }
@@ -716,12 +936,10 @@ void set_thread_priority(pthread_t thread, int priority, const char *name)
 int create_all_tasks(pthread_t *threads, int *thread_ids)
 {
     void *(*task_functions[])(void *) = {
-        motor_a_task, motor_b_task, motor_c_task, motor_d_task,
-        print_task, console_task, process_task, serial_task, pwm_task};
+        step_sched_task, process_task, io_task};
 
     const char *task_names[] = {
-        "motor A", "motor B", "motor C", "motor D",
-        "print", "console", "process", "serial", "pwm"};
+        "step scheduler", "process", "io"};
 
     int task_count = sizeof(task_functions) / sizeof(task_functions[0]);
     printf("Creating %d threads...\n", task_count);
@@ -768,8 +986,7 @@ void cleanup_tasks(void)
         serial_fd = -1;
     }
 
-    system("echo 0 > /sys/class/pwm/pwmchip0/pwm0/enable");
-    system("echo 0 > /sys/class/pwm/pwmchip0/unexport");
+    pwm_close_all();
 
     printf("Task resources cleaned up\n");
 }
\ No newline at end of file
@@ -3,15 +3,15 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include "pwm_profile.h"
 
 extern volatile int running;
 extern pthread_mutex_t print_mutex;
 
-void *motor_a_task(void *arg __attribute__((unused)));
-void *motor_b_task(void *arg __attribute__((unused)));
-void *motor_c_task(void *arg __attribute__((unused)));
-void *motor_d_task(void *arg __attribute__((unused)));
-void *print_task(void *arg __attribute__((unused)));
+#define PRINT_DELAY_NS 100000000ull // 控制台命令后延迟打印状态，合并连续命令
+#define CONSOLE_LINE_MAX 128
+
+void *io_task(void *arg __attribute__((unused)));
 
 int create_all_tasks(pthread_t *threads, int *thread_ids);
 void wait_all_tasks(pthread_t *threads, int thread_count);
@@ -27,7 +27,8 @@ int set_pwm_duty_cycle(int duty_percent);
 int set_pwm_frequency(int freq_hz);
 int pwm_set_duty(int duty_percent);
 int pwm_set_freq(int freq_hz);
+uint32_t pwm_start_profile(const pwm_profile_t *profile);
+int pwm_profile_finished(uint32_t seq, uint64_t *done_ns);
 void get_pwm_status(void);
-void *pwm_task(void *arg);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motor.h"
+#include "protocol.h"
+#include "usart_me_Recive.h"
+
+/*
+ * 串口文本命令吞吐量：典型命令行（A:10.5,$B:2,C:18 这样的多轴目标）组成 1MB 的输入，
+ * 分别直接送入命令解析器，以及按 serial_event 的路径经帧解析器的文本回调送入，
+ * 按 256 字节一次读的分段计时，给出每秒命令数。
+ */
+
+#define BENCH_BYTES (1 << 20)
+#define BENCH_ROUNDS 20
+#define READ_SIZE 256
+
+static uint64_t targets;
+
+static void count_cmd(const usart_cmd_t *cmd, void *ctx __attribute__((unused)))
+{
+    if (cmd->type == USART_CMD_TARGET)
+        targets++;
+}
+
+static void text_to_cmd(uint8_t byte, void *ctx)
+{
+    usart_parser_byte(ctx, byte);
+}
+
+static int build_input(char *buf, int size)
+{
+    int n = 0, k = 0;
+
+    while (n < size - 64)
+    {
+        n += sprintf(buf + n, "A:%d.%d,$B:%d,C:%d.%02d,%sD:%d\n",
+                     k % 20, k % 10, k % 3, k % 36, k % 100, k % 2 ? "$" : "", k % 5);
+        k++;
+    }
+    return n;
+}
+
+static void report(const char *name, uint64_t commands, uint64_t bytes, uint64_t ns)
+{
+    printf("%-8s %10.0f commands/s  %7.1f MB/s  %6.1f ns/byte\n",
+           name, commands * 1e9 / ns, bytes * 1e3 / ns, (double)ns / bytes);
+}
+
+int main(void)
+{
+    char *input = malloc(BENCH_BYTES);
+    int len = build_input(input, BENCH_BYTES);
+    usart_parser_t cmd;
+    proto_parser_t rx;
+    proto_frame_t frame;
+    uint64_t t0, dt;
+    int round, off, n;
+
+    // 命令解析器单独计时
+    usart_parser_init(&cmd, count_cmd, NULL);
+    targets = 0;
+    t0 = monotonic_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (off = 0; off < len; off += READ_SIZE)
+        {
+            n = len - off < READ_SIZE ? len - off : READ_SIZE;
+            usart_parser_feed(&cmd, (const uint8_t *)input + off, n);
+        }
+    }
+    dt = monotonic_ns() - t0;
+    report("parser", targets, (uint64_t)len * BENCH_ROUNDS, dt);
+    if (cmd.stats.errors != 0)
+        printf("unexpected parse errors: %llu\n", (unsigned long long)cmd.stats.errors);
+
+    // 串口路径：帧解析器把帧外字节交给命令解析器
+    usart_parser_init(&cmd, count_cmd, NULL);
+    proto_parser_init(&rx, text_to_cmd, &cmd);
+    targets = 0;
+    t0 = monotonic_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (off = 0; off < len; off += READ_SIZE)
+        {
+            n = len - off < READ_SIZE ? len - off : READ_SIZE;
+            proto_feed(&rx, (const uint8_t *)input + off, n);
+            while (proto_next(&rx, &frame))
+                ;
+        }
+    }
+    dt = monotonic_ns() - t0;
+    report("serial", targets, (uint64_t)len * BENCH_ROUNDS, dt);
+
+    // 115200 波特率下每秒约 11520 字节
+    printf("at 115200 baud the line carries %.0f commands/s\n", 11520.0 * targets / ((uint64_t)len * BENCH_ROUNDS));
+    free(input);
+    return cmd.stats.errors != 0;
+}
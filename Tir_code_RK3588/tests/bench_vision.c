@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motor.h"
+#include "vision.h"
+
+/*
+ * 视觉 JSON 行解析吞吐量：把 tests/data/vision_capture.jsonl 重复拼成约 4MB，
+ * 按 256 字节一次读的分段送入解析器，给出每秒行数，并与串口和相机帧率的上限比较。
+ */
+
+#define CAPTURE_FILE "tests/data/vision_capture.jsonl"
+#define BENCH_BYTES (4 << 20)
+#define BENCH_ROUNDS 5
+#define READ_SIZE 256
+
+static uint64_t results;
+
+static void count_result(const vision_result_t *r __attribute__((unused)), void *ctx __attribute__((unused)))
+{
+    results++;
+}
+
+int main(void)
+{
+    FILE *f = fopen(CAPTURE_FILE, "rb");
+    uint8_t *input = malloc(BENCH_BYTES);
+    vision_parser_t p;
+    uint64_t t0, dt, lines = 0;
+    int capture_len, len = 0, round, off, n;
+    double line_bytes;
+
+    if (f == NULL || input == NULL)
+    {
+        perror(CAPTURE_FILE);
+        return 1;
+    }
+    capture_len = fread(input, 1, BENCH_BYTES / 2, f);
+    fclose(f);
+    if (capture_len <= 0)
+        return 1;
+    for (len = capture_len; len + capture_len <= BENCH_BYTES; len += capture_len)
+        memcpy(input + len, input, capture_len);
+
+    results = 0;
+    t0 = monotonic_ns();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        vision_parser_init(&p, count_result, NULL);
+        for (off = 0; off < len; off += READ_SIZE)
+        {
+            n = len - off < READ_SIZE ? len - off : READ_SIZE;
+            vision_parser_feed(&p, input + off, n);
+        }
+        lines += p.stats.lines;
+    }
+    dt = monotonic_ns() - t0;
+
+    line_bytes = (double)len / p.stats.lines;
+    printf("vision   %10.0f lines/s  %7.1f MB/s  %6.0f ns/line  (%llu results, %llu errors per pass)\n",
+           lines * 1e9 / dt, (double)len * BENCH_ROUNDS * 1e3 / dt, (double)dt / lines,
+           (unsigned long long)p.stats.results, (unsigned long long)p.stats.errors);
+    // 相机 115200 波特率串口每秒最多 11520 字节
+    printf("at 115200 baud the camera can send %.0f lines/s (%.0f bytes/line)\n", 11520.0 / line_bytes, line_bytes);
+    free(input);
+    return 0;
+}
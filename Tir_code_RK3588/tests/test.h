@@ -0,0 +1,43 @@
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdio.h>
+#include <math.h>
+
+/*
+ * 测试用的最小断言：失败时打印位置并计数，不中断后续检查。
+ * 每个测试程序 main() 最后 return TEST_RESULT();，make check 按返回值判断。
+ */
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond)                                                              \
+    do                                                                           \
+    {                                                                            \
+        test_checks++;                                                           \
+        if (!(cond))                                                             \
+        {                                                                        \
+            test_failures++;                                                     \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);      \
+        }                                                                        \
+    } while (0)
+
+// |a - b| <= tol
+#define CHECK_NEAR(a, b, tol)                                                    \
+    do                                                                           \
+    {                                                                            \
+        double _a = (a), _b = (b);                                               \
+        test_checks++;                                                           \
+        if (!(fabs(_a - _b) <= (tol)))                                           \
+        {                                                                        \
+            test_failures++;                                                     \
+            printf("%s:%d: %s = %.9g, expected %s = %.9g (tol %g)\n",            \
+                   __FILE__, __LINE__, #a, _a, #b, _b, (double)(tol));           \
+        }                                                                        \
+    } while (0)
+
+#define TEST_RESULT()                                                            \
+    (printf("%s: %d checks, %d failed\n", __FILE__, test_checks, test_failures), \
+     test_failures ? 1 : 0)
+
+#endif
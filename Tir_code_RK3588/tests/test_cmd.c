@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "usart_me_Recive.h"
+#include "test.h"
+
+/*
+ * 串口文本命令解析器测试：固定用例，以及随机生成的命令流（合法命令、格式错误、随机字节、
+ * 任意分隔符）与参考实现逐条比较；同一字节流按随机分段交替送入两个解析器实例，结果必须相同。
+ */
+
+#define FUZZ_ROUNDS 2000
+#define FUZZ_STREAM_MAX 4096
+#define EVENTS_MAX 4096
+
+typedef struct
+{
+    usart_cmd_t ev[EVENTS_MAX];
+    int count;
+} events_t;
+
+static void collect(const usart_cmd_t *cmd, void *ctx)
+{
+    events_t *e = ctx;
+
+    if (e->count < EVENTS_MAX)
+        e->ev[e->count] = *cmd;
+    e->count++;
+}
+
+static int parse(const char *text, events_t *e)
+{
+    usart_parser_t p;
+
+    e->count = 0;
+    usart_parser_init(&p, collect, e);
+    usart_parser_feed(&p, (const uint8_t *)text, strlen(text));
+    return e->count;
+}
+
+static void check_target(const usart_cmd_t *c, int axis, int enable, float target)
+{
+    CHECK(c->type == USART_CMD_TARGET);
+    CHECK(c->axis == axis && c->enable == enable);
+    CHECK_NEAR(c->target, target, 1e-6 * (target > 1 ? target : 1));
+}
+
+static void test_examples(void)
+{
+    events_t e;
+
+    CHECK(parse("A:10.5,$B:2\n", &e) == 3);
+    check_target(&e.ev[0], 0, 0, 10.5f);
+    check_target(&e.ev[1], 1, 1, 2.0f);
+    CHECK(e.ev[2].type == USART_CMD_LINE_END && e.ev[2].errors == 0);
+
+    CHECK(parse("$\r", &e) == 2);
+    CHECK(e.ev[0].type == USART_CMD_BEGIN_ALL && e.ev[1].type == USART_CMD_LINE_END);
+
+    // 格式错误跳到下一个分隔符，同一行其他命令照常发出
+    CHECK(parse("E:1 A:1.2.3 C:x B:.5 D:00012.50;", &e) == 3);
+    check_target(&e.ev[0], 1, 0, 0.5f);
+    check_target(&e.ev[1], 3, 0, 12.5f);
+    CHECK(e.ev[2].type == USART_CMD_LINE_END && e.ev[2].errors == 3);
+
+    // 至少一位数字；有效位数上限
+    CHECK(parse("A: B:. C:0 D:123456789 A:1234567890\n", &e) == 3);
+    check_target(&e.ev[0], 2, 0, 0.0f);
+    check_target(&e.ev[1], 3, 0, 123456789.0f);
+    CHECK(e.ev[2].errors == 3);
+    CHECK(parse("A:0000000000001.00000001\n", &e) == 2);
+    check_target(&e.ev[0], 0, 0, 1.00000001f);
+
+    // 空行和只有分隔符的行不发出 LINE_END
+    CHECK(parse("\n\r\n ,, ;\n", &e) == 0);
+    // 没有结束符的命令等下一个分隔符
+    CHECK(parse("A:5", &e) == 0);
+}
+
+// 一行正好256条命令（计数回绕到0的情况）仍然发出 LINE_END，错误数饱和在255
+static void test_long_line(void)
+{
+    static char line[8192];
+    events_t *e = malloc(sizeof(*e));
+    int i, n = 0;
+
+    for (i = 0; i < 128; i++)
+        n += sprintf(line + n, "C:%d,X%d,", i, i);
+    line[n++] = '\n';
+    line[n] = '\0';
+    CHECK(parse(line, e) == 129);
+    CHECK(e->ev[127].type == USART_CMD_TARGET && e->ev[127].target == 127.0f);
+    CHECK(e->ev[128].type == USART_CMD_LINE_END && e->ev[128].errors == 128);
+
+    for (i = n = 0; i < 300; i++)
+        n += sprintf(line + n, "X%d ", i);
+    line[n++] = ';';
+    line[n] = '\0';
+    CHECK(parse(line, e) == 1);
+    CHECK(e->ev[0].type == USART_CMD_LINE_END && e->ev[0].errors == 255);
+    free(e);
+}
+
+/*
+ * 参考实现：按分隔符切开后逐条判断，与状态机的实现方式无关
+ */
+static int is_sep(uint8_t c)
+{
+    return c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ';';
+}
+
+static int is_line_end(uint8_t c)
+{
+    return c == '\n' || c == '\r' || c == ';';
+}
+
+// 返回 1 命令、0 格式错误
+static int ref_token(const uint8_t *t, int len, usart_cmd_t *cmd)
+{
+    int i = 0, digits = 0, significant = 0, dot = 0;
+    double value = 0, scale = 1;
+
+    memset(cmd, 0, sizeof(*cmd));
+    if (len == 1 && t[0] == '$')
+    {
+        cmd->type = USART_CMD_BEGIN_ALL;
+        cmd->enable = 1;
+        return 1;
+    }
+    if (t[0] == '$')
+    {
+        cmd->enable = 1;
+        i++;
+    }
+    if (len - i < 3 || t[i] < 'A' || t[i] > 'D' || t[i + 1] != ':')
+        return 0;
+    cmd->axis = t[i] - 'A';
+    for (i += 2; i < len; i++)
+    {
+        if (t[i] == '.' && !dot)
+        {
+            dot = 1;
+            continue;
+        }
+        if (t[i] < '0' || t[i] > '9')
+            return 0;
+        digits++;
+        // 整数部分的前导0不算有效位
+        if (dot || significant > 0 || t[i] != '0')
+            significant++;
+        value = value * 10 + (t[i] - '0');
+        if (dot)
+            scale *= 10;
+    }
+    if (digits == 0 || significant > USART_MAX_DIGITS)
+        return 0;
+    cmd->type = USART_CMD_TARGET;
+    cmd->target = (float)(value / scale);
+    return 1;
+}
+
+static int ref_parse(const uint8_t *s, int len, events_t *e)
+{
+    usart_cmd_t cmd;
+    int i = 0, start, items = 0, errors = 0;
+
+    e->count = 0;
+    while (i < len)
+    {
+        if (is_sep(s[i]))
+        {
+            if (is_line_end(s[i]))
+            {
+                if (items > 0)
+                {
+                    memset(&cmd, 0, sizeof(cmd));
+                    cmd.type = USART_CMD_LINE_END;
+                    cmd.errors = errors > 255 ? 255 : errors;
+                    collect(&cmd, e);
+                }
+                items = errors = 0;
+            }
+            i++;
+            continue;
+        }
+        for (start = i; i < len && !is_sep(s[i]); i++)
+            ;
+        if (i == len)
+            break; // 没有分隔符结束的命令不发出
+        items++;
+        if (ref_token(s + start, i - start, &cmd))
+            collect(&cmd, e);
+        else
+            errors++;
+    }
+    return e->count;
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rnd(uint32_t n)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) % n;
+}
+
+static int gen_number(char *out)
+{
+    int n = 0, i, int_len = rnd(7), frac_len = rnd(5);
+
+    for (i = 0; i < int_len; i++)
+        out[n++] = '0' + rnd(10);
+    if (frac_len > 0 || rnd(4) == 0)
+    {
+        out[n++] = '.';
+        for (i = 0; i < frac_len; i++)
+            out[n++] = '0' + rnd(10);
+    }
+    return n;
+}
+
+// 生成一条命令：大多数合法，其余为常见错误形式或随机字节
+static int gen_token(char *out)
+{
+    static const char junk[] = "ABCDE$:.0123456789xa-+\xA5\xFF";
+    int n = 0, i, len, kind = rnd(10);
+
+    if (kind < 6)
+    {
+        if (rnd(2))
+            out[n++] = '$';
+        out[n++] = 'A' + rnd(4);
+        out[n++] = ':';
+        n += gen_number(out + n);
+    }
+    else if (kind == 6)
+    {
+        out[n++] = '$';
+    }
+    else
+    {
+        len = 1 + rnd(8);
+        for (i = 0; i < len; i++)
+            out[n++] = junk[rnd(sizeof(junk) - 1)];
+    }
+    return n;
+}
+
+static int gen_stream(uint8_t *s, int max)
+{
+    static const char seps[] = ", \t,,  ";
+    static const char ends[] = "\n\r;";
+    int n = 0, k;
+
+    while (n < max - 64)
+    {
+        n += gen_token((char *)s + n);
+        k = rnd(8);
+        if (k == 0)
+            s[n++] = ends[rnd(3)];
+        else
+            s[n++] = seps[rnd(sizeof(seps) - 1)];
+        if (rnd(16) == 0)
+            s[n++] = seps[rnd(sizeof(seps) - 1)];
+    }
+    s[n++] = '\n';
+    return n;
+}
+
+static int same_events(const events_t *a, const events_t *b)
+{
+    int i;
+
+    if (a->count != b->count)
+        return 0;
+    for (i = 0; i < a->count && i < EVENTS_MAX; i++)
+    {
+        const usart_cmd_t *x = &a->ev[i], *y = &b->ev[i];
+
+        if (x->type != y->type || x->errors != y->errors)
+            return 0;
+        if (x->type == USART_CMD_TARGET && (x->axis != y->axis || x->enable != y->enable || x->target != y->target))
+            return 0;
+    }
+    return 1;
+}
+
+static void test_fuzz(void)
+{
+    static uint8_t s[FUZZ_STREAM_MAX];
+    static events_t got, ref, other;
+    usart_parser_t p, q;
+    int round, len, off, n, mismatches = 0, commands = 0, errors = 0;
+
+    for (round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        len = gen_stream(s, 64 + rnd(FUZZ_STREAM_MAX - 64));
+        ref_parse(s, len, &ref);
+
+        // 两个实例交替送入随机长度的分段，互不影响
+        got.count = other.count = 0;
+        usart_parser_init(&p, collect, &got);
+        usart_parser_init(&q, collect, &other);
+        for (off = 0; off < len; off += n)
+        {
+            n = 1 + rnd(32);
+            if (n > len - off)
+                n = len - off;
+            usart_parser_feed(&p, s + off, n);
+            usart_parser_feed(&q, s + off, n);
+        }
+        if (!same_events(&got, &ref) || !same_events(&got, &other))
+        {
+            if (mismatches++ == 0)
+                printf("fuzz round %d: %d events, reference %d\n", round, got.count, ref.count);
+        }
+        CHECK(p.stats.bytes == (uint64_t)len);
+        commands += p.stats.commands;
+        errors += p.stats.errors;
+    }
+    CHECK(mismatches == 0);
+    // 生成器确实覆盖了合法命令和格式错误
+    CHECK(commands > FUZZ_ROUNDS * 10);
+    CHECK(errors > FUZZ_ROUNDS);
+    printf("fuzz: %d rounds, %d commands, %d errors\n", FUZZ_ROUNDS, commands, errors);
+}
+
+int main(void)
+{
+    test_examples();
+    test_long_line();
+    test_fuzz();
+    return TEST_RESULT();
+}
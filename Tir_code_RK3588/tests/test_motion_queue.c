@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "motor.h"
+#include "motion_queue.h"
+#include "step_sched.h"
+#include "task.h"
+#include "test.h"
+
+/*
+ * 运动队列测试：环形队列满时拒绝、计数回绕、等待时间统计，
+ * 以及经步进调度器在 --sim 仿真GPIO上连续执行排队运动，中间没有空闲间隔，
+ * 队列取空后再入队记一次欠载。
+ */
+
+static void test_full(void)
+{
+    motion_queue_t q = MOTION_QUEUE_INIT;
+    motion_queue_stats_t st;
+    motion_cmd_t cmd;
+    int i, ok = 1;
+
+    for (i = 0; i < MOTION_QUEUE_DEPTH; i++)
+        CHECK(motion_queue_push(&q, i, 1000) == 0);
+    CHECK(motion_queue_depth(&q) == MOTION_QUEUE_DEPTH);
+    CHECK(motion_queue_push(&q, 99, 1000) == -1);
+    CHECK(motion_queue_push(&q, 99, 1000) == -1);
+
+    // 取出一条后又能入队一条
+    CHECK(motion_queue_pop(&q, &cmd, 1250) == 1 && cmd.target == 0);
+    CHECK(motion_queue_push(&q, 16, 2000) == 0);
+    CHECK(motion_queue_push(&q, 99, 2000) == -1);
+
+    for (i = 1; i <= MOTION_QUEUE_DEPTH; i++)
+        ok &= motion_queue_pop(&q, &cmd, 3000) == 1 && cmd.target == i;
+    CHECK(ok);
+    CHECK(motion_queue_pop(&q, &cmd, 3000) == 0);
+
+    motion_queue_get_stats(&q, &st);
+    CHECK(st.depth == 0 && st.max_depth == MOTION_QUEUE_DEPTH);
+    CHECK(st.enqueued == MOTION_QUEUE_DEPTH + 1 && st.rejected == 3);
+    CHECK(st.started == MOTION_QUEUE_DEPTH + 1 && st.flushed == 0);
+    // 等待时间：第一条 250ns，其余 15 条 2000ns，最后入队的一条 1000ns
+    CHECK(st.wait_sum_ns == 250 + 15 * 2000 + 1000);
+    CHECK(st.wait_max_ns == 2000);
+
+    // 时钟倒退时等待时间按0计
+    CHECK(motion_queue_push(&q, 1, 5000) == 0);
+    CHECK(motion_queue_pop(&q, &cmd, 4000) == 1);
+    motion_queue_get_stats(&q, &st);
+    CHECK(st.wait_sum_ns == 250 + 15 * 2000 + 1000 && st.started == MOTION_QUEUE_DEPTH + 2);
+}
+
+// head/tail 从接近 UINT32_MAX 开始，跨过回绕点后顺序、深度和满判断不变
+static void test_wrap(void)
+{
+    motion_queue_t q = MOTION_QUEUE_INIT;
+    motion_queue_stats_t st;
+    motion_cmd_t cmd;
+    int i, k, next_in = 0, next_out = 0, ok = 1;
+
+    q.head = q.tail = UINT32_MAX - 20;
+    for (k = 0; k < 40; k++)
+    {
+        // 每轮入队 1~5 条、取出 1~4 条，深度在 0~16 之间来回
+        for (i = 0; i < 1 + k % 5; i++)
+        {
+            if (motion_queue_push(&q, next_in, 0) == 0)
+                next_in++;
+        }
+        for (i = 0; i < 1 + k % 4; i++)
+        {
+            if (motion_queue_pop(&q, &cmd, 0))
+                ok &= cmd.target == next_out++;
+        }
+        ok &= motion_queue_depth(&q) == (uint32_t)(next_in - next_out);
+    }
+    CHECK(ok);
+    CHECK(q.head < 1000); // 确实跨过了回绕点
+
+    // 跨回绕点填满
+    while (motion_queue_push(&q, next_in, 0) == 0)
+        next_in++;
+    CHECK(motion_queue_depth(&q) == MOTION_QUEUE_DEPTH);
+    CHECK(motion_queue_flush(&q) == MOTION_QUEUE_DEPTH);
+    CHECK(motion_queue_depth(&q) == 0 && motion_queue_pop(&q, &cmd, 0) == 0);
+
+    motion_queue_get_stats(&q, &st);
+    CHECK(st.flushed == MOTION_QUEUE_DEPTH && st.max_depth == MOTION_QUEUE_DEPTH);
+    CHECK(st.enqueued == (uint64_t)next_in && st.started == (uint64_t)next_out);
+}
+
+// 等待 since 之后的一次完成
+static int wait_done(motor *motor_p, uint64_t since, uint64_t timeout_ns)
+{
+    uint64_t end = monotonic_ns() + timeout_ns;
+    motor_state_t st;
+
+    while (monotonic_ns() < end)
+    {
+        Motor_Get_State(motor_p, &st);
+        if (st.State == 1 && st.Done_ns > since)
+            return 1;
+        Motor_Done_Wait(10000000ull);
+    }
+    return 0;
+}
+
+// 经调度器连续执行排队运动：除启动延迟外，轴的忙碌时间等于从入队到完成的墙钟时间
+static void test_sched(void)
+{
+    static const float targets[] = {0.5f, 1.0f, 0.25f};
+    motor *motor_p = &motor_data_C;
+    motion_queue_stats_t q;
+    step_axis_stats_t before, after;
+    gpio_sim_pin_t pin0, pin1;
+    motor_state_t st;
+    pthread_t sched;
+    uint64_t t0, busy_ns;
+    int32_t pos;
+    uint32_t edges = 0;
+    unsigned i;
+
+    motor_gpio_use_sim();
+    CHECK(motor_io_init() == 0);
+    CHECK(pthread_create(&sched, NULL, step_sched_task, NULL) == 0);
+    Set_Motor_Limits(Motor_C, 4, 8, 0);
+
+    CHECK(step_sched_enqueue(-1, 1.0f) == -1);
+    CHECK(step_sched_enqueue(STEP_AXES, 1.0f) == -1);
+
+    Motor_Get_State(motor_p, &st);
+    pos = st.Current_Step;
+    for (i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+    {
+        edges += abs(Motor_Circle_To_Step(motor_p, targets[i]) - pos);
+        pos = Motor_Circle_To_Step(motor_p, targets[i]);
+    }
+
+    step_sched_get_stats(Motor_C, &before);
+    gpio_sim_get(motor_p->PUL_GPIO, &pin0);
+    t0 = monotonic_ns();
+    for (i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+        CHECK(step_sched_enqueue(Motor_C, targets[i]) == 0);
+    CHECK(wait_done(motor_p, t0, 5000000000ull));
+    Motor_Get_State(motor_p, &st);
+    step_sched_get_stats(Motor_C, &after);
+    gpio_sim_get(motor_p->PUL_GPIO, &pin1);
+    step_sched_get_queue_stats(Motor_C, &q);
+
+    busy_ns = after.active_ns - before.active_ns;
+    printf("queued moves: %u edges, busy %.4f s, enqueue to done %.4f s\n",
+           pin1.edges - pin0.edges, busy_ns / 1e9, (st.Done_ns - t0) / 1e9);
+    CHECK(st.Current_Step == pos);
+    CHECK(pin1.edges - pin0.edges == edges);
+    CHECK(after.moves - before.moves == 3 && after.aborted == before.aborted);
+    CHECK(q.enqueued == 3 && q.started == 3 && q.rejected == 0 && q.depth == 0);
+    CHECK(q.underruns == 0);
+    // 后两条在队列中等到前一条结束
+    CHECK(q.wait_max_ns >= busy_ns / 2 && q.wait_sum_ns >= q.wait_max_ns);
+    // 空闲轮询周期是 STEP_IDLE_POLL_NS；运动之间若等到轮询才启动，差值会超过它
+    CHECK(st.Done_ns - t0 >= busy_ns);
+    CHECK(st.Done_ns - t0 - busy_ns < 10000000ull);
+
+    // 队列取空、轴已空闲后才入队的运动记一次欠载
+    t0 = monotonic_ns();
+    CHECK(step_sched_enqueue(Motor_C, 0.0f) == 0);
+    CHECK(wait_done(motor_p, t0, 5000000000ull));
+    step_sched_get_queue_stats(Motor_C, &q);
+    CHECK(q.started == 4 && q.underruns == 1);
+
+    running = 0;
+    step_sched_kick();
+    pthread_join(sched, NULL);
+    motor_cleanup();
+}
+
+int main(void)
+{
+    test_full();
+    test_wrap();
+    test_sched();
+    return TEST_RESULT();
+}
@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ph_blob.h"
+#include "test.h"
+
+/*
+ * pH 色块提取测试：随机掩码图（多个类别重叠）上与逐类别 BFS 的 8 邻接参考实现比较，
+ * 覆盖 ROI 裁剪、PH_PIXEL_THRESHOLD 和 PH_MIN_BLOB_AREA 过滤、PH_MERGE_MARGIN 合并；
+ * 以及色块数超过 PH_BLOB_MAX 时，图像下方面积最大的色块仍然保留。
+ */
+
+#define MAX_W 320
+#define MAX_H 240
+#define REF_MAX 4096
+#define RANDOM_ROUNDS 300
+
+static uint16_t mask[MAX_W * MAX_H];
+
+/*
+ * 参考实现：每个类别对 ROI 内的像素做 BFS，过滤后按 margin 反复两两合并
+ */
+typedef struct
+{
+    ph_blob_t b[REF_MAX];
+    int n;
+} ref_blobs_t;
+
+static int queue[MAX_W * MAX_H];
+static uint8_t seen[MAX_W * MAX_H];
+
+static int near_rect(const ph_rect_t *a, const ph_rect_t *b)
+{
+    return a->x - PH_MERGE_MARGIN < b->x + b->w && b->x < a->x + a->w + PH_MERGE_MARGIN &&
+           a->y - PH_MERGE_MARGIN < b->y + b->h && b->y < a->y + a->h + PH_MERGE_MARGIN;
+}
+
+static void ref_find(int width, int height, const ph_rect_t *roi, ref_blobs_t *out)
+{
+    int x0 = 0, y0 = 0, x1 = width, y1 = height;
+    int k, x, y, i, j, merged;
+
+    if (roi)
+    {
+        x0 = roi->x > 0 ? roi->x : 0;
+        y0 = roi->y > 0 ? roi->y : 0;
+        x1 = roi->x + roi->w < width ? roi->x + roi->w : width;
+        y1 = roi->y + roi->h < height ? roi->y + roi->h : height;
+    }
+    out->n = 0;
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        memset(seen, 0, sizeof(seen));
+        for (y = y0; y < y1; y++)
+        {
+            for (x = x0; x < x1; x++)
+            {
+                int head = 0, tail = 0, bx0 = x, by0 = y, bx1 = x, by1 = y;
+                double sx = 0, sy = 0;
+                ph_blob_t *b;
+
+                if (!(mask[y * width + x] >> k & 1) || seen[y * width + x])
+                    continue;
+                seen[y * width + x] = 1;
+                queue[tail++] = y * width + x;
+                while (head < tail)
+                {
+                    int p = queue[head++], px = p % width, py = p / width, dx, dy;
+
+                    sx += px;
+                    sy += py;
+                    bx0 = px < bx0 ? px : bx0;
+                    bx1 = px > bx1 ? px : bx1;
+                    by0 = py < by0 ? py : by0;
+                    by1 = py > by1 ? py : by1;
+                    for (dy = -1; dy <= 1; dy++)
+                    {
+                        for (dx = -1; dx <= 1; dx++)
+                        {
+                            int qx = px + dx, qy = py + dy, q = qy * width + qx;
+
+                            if (qx < x0 || qx >= x1 || qy < y0 || qy >= y1 || seen[q] || !(mask[q] >> k & 1))
+                                continue;
+                            seen[q] = 1;
+                            queue[tail++] = q;
+                        }
+                    }
+                }
+                if (tail < PH_PIXEL_THRESHOLD || (bx1 - bx0 + 1) * (by1 - by0 + 1) < PH_MIN_BLOB_AREA)
+                    continue;
+                b = &out->b[out->n++];
+                b->cls = k;
+                b->rect.x = bx0;
+                b->rect.y = by0;
+                b->rect.w = bx1 - bx0 + 1;
+                b->rect.h = by1 - by0 + 1;
+                b->pixels = tail;
+                b->cx = sx / tail;
+                b->cy = sy / tail;
+            }
+        }
+    }
+
+    do
+    {
+        merged = 0;
+        for (i = 0; i < out->n; i++)
+        {
+            for (j = i + 1; j < out->n; j++)
+            {
+                ph_blob_t *a = &out->b[i], *b = &out->b[j];
+                int ax1 = a->rect.x + a->rect.w, ay1 = a->rect.y + a->rect.h;
+                int bx1 = b->rect.x + b->rect.w, by1 = b->rect.y + b->rect.h;
+
+                if (a->cls != b->cls || !near_rect(&a->rect, &b->rect))
+                    continue;
+                a->cx = (a->cx * a->pixels + b->cx * b->pixels) / (a->pixels + b->pixels);
+                a->cy = (a->cy * a->pixels + b->cy * b->pixels) / (a->pixels + b->pixels);
+                a->pixels += b->pixels;
+                a->rect.x = a->rect.x < b->rect.x ? a->rect.x : b->rect.x;
+                a->rect.y = a->rect.y < b->rect.y ? a->rect.y : b->rect.y;
+                a->rect.w = (ax1 > bx1 ? ax1 : bx1) - a->rect.x;
+                a->rect.h = (ay1 > by1 ? ay1 : by1) - a->rect.y;
+                out->b[j--] = out->b[--out->n];
+                merged = 1;
+            }
+        }
+    } while (merged);
+}
+
+static int blob_cmp(const void *pa, const void *pb)
+{
+    const ph_blob_t *a = pa, *b = pb;
+
+    if (a->cls != b->cls)
+        return a->cls - b->cls;
+    if (a->rect.y != b->rect.y)
+        return a->rect.y - b->rect.y;
+    if (a->rect.x != b->rect.x)
+        return a->rect.x - b->rect.x;
+    if (a->rect.w != b->rect.w)
+        return a->rect.w - b->rect.w;
+    return a->rect.h - b->rect.h;
+}
+
+// 顺序无关地比较两组色块
+static int same_blobs(ph_blob_t *a, int na, ph_blob_t *b, int nb)
+{
+    int i;
+
+    if (na != nb)
+        return 0;
+    qsort(a, na, sizeof(a[0]), blob_cmp);
+    qsort(b, nb, sizeof(b[0]), blob_cmp);
+    for (i = 0; i < na; i++)
+    {
+        if (blob_cmp(&a[i], &b[i]) != 0 || a[i].pixels != b[i].pixels ||
+            a[i].cx - b[i].cx > 0.01f || b[i].cx - a[i].cx > 0.01f ||
+            a[i].cy - b[i].cy > 0.01f || b[i].cy - a[i].cy > 0.01f)
+            return 0;
+    }
+    return 1;
+}
+
+static int check_against_ref(ph_blob_ctx_t *ctx, int width, int height, const ph_rect_t *roi)
+{
+    static ref_blobs_t ref;
+    int n = ph_blob_find(ctx, mask, width, height, roi);
+
+    ref_find(width, height, roi, &ref);
+    return n >= 0 && ctx->stats.dropped_blobs == 0 && same_blobs(ctx->blobs, ctx->nblobs, ref.b, ref.n);
+}
+
+static void fill_rect(int width, int x, int y, int w, int h, uint16_t bits)
+{
+    int i, j;
+
+    for (j = y; j < y + h; j++)
+    {
+        for (i = x; i < x + w; i++)
+            mask[j * width + i] |= bits;
+    }
+}
+
+static uint32_t rng_state = 2024;
+
+static uint32_t rnd(uint32_t n)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) % n;
+}
+
+// 随机矩形叠加随机噪声，每个像素可以同时属于多个类别
+static void random_mask(int width, int height)
+{
+    int i, n = rnd(8);
+
+    memset(mask, 0, sizeof(mask[0]) * width * height);
+    for (i = 0; i < n; i++)
+    {
+        int w = 1 + rnd(width), h = 1 + rnd(height);
+
+        fill_rect(width, rnd(width - w + 1), rnd(height - h + 1), w, h, 1u << rnd(4));
+    }
+    n = rnd(3) * width * height / 4;
+    for (i = 0; i < n; i++)
+        mask[rnd(width * height)] ^= 1u << rnd(PH_CLASSES);
+}
+
+static void test_random(void)
+{
+    ph_blob_ctx_t ctx;
+    ph_rect_t roi;
+    int round, width, height, bad = 0, blobs = 0, merged = 0;
+
+    CHECK(ph_blob_init(&ctx, 64) == 0);
+    for (round = 0; round < RANDOM_ROUNDS; round++)
+    {
+        width = 1 + rnd(64);
+        height = 1 + rnd(48);
+        random_mask(width, height);
+        if (!check_against_ref(&ctx, width, height, NULL))
+        {
+            if (bad++ == 0)
+                printf("round %d: %dx%d, %d blobs\n", round, width, height, ctx.nblobs);
+        }
+        blobs += ctx.nblobs;
+        merged += ctx.stats.merged;
+
+        // ROI 可以超出图像，按图像边界裁剪
+        roi.x = (int)rnd(width + 8) - 8;
+        roi.y = (int)rnd(height + 8) - 8;
+        roi.w = rnd(width + 16);
+        roi.h = rnd(height + 16);
+        if (!check_against_ref(&ctx, width, height, &roi))
+        {
+            if (bad++ == 0)
+                printf("round %d: %dx%d, ROI (%d,%d,%d,%d)\n", round, width, height, roi.x, roi.y, roi.w, roi.h);
+        }
+    }
+    CHECK(bad == 0);
+    // 随机图确实产生了色块和合并
+    CHECK(blobs > RANDOM_ROUNDS && merged > 0);
+    printf("random: %d rounds, %d blobs, %d merged\n", RANDOM_ROUNDS, blobs, merged);
+    CHECK(ph_blob_find(&ctx, mask, 65, 1, NULL) == -1);
+    ph_blob_free(&ctx);
+}
+
+static void test_cases(void)
+{
+    ph_blob_ctx_t ctx;
+    ph_rect_t roi;
+    int i, w = 40, h = 30;
+
+    CHECK(ph_blob_init(&ctx, w) == 0);
+
+    // 像素数下限：斜线外接矩形面积足够，14 个像素被滤掉，15 个保留
+    memset(mask, 0, sizeof(mask));
+    for (i = 0; i < PH_PIXEL_THRESHOLD - 1; i++)
+        mask[i * w + i] = 1;
+    CHECK(ph_blob_find(&ctx, mask, w, h, NULL) == 0);
+    mask[i * w + i] = 1;
+    CHECK(ph_blob_find(&ctx, mask, w, h, NULL) == 1 && ctx.blobs[0].pixels == PH_PIXEL_THRESHOLD);
+    CHECK(ctx.blobs[0].rect.w == PH_PIXEL_THRESHOLD && ctx.blobs[0].rect.h == PH_PIXEL_THRESHOLD);
+
+    // 面积下限：7x7=49 被滤掉，5x10=50 保留
+    memset(mask, 0, sizeof(mask));
+    fill_rect(w, 1, 1, 7, 7, 1u << 2);
+    CHECK(ph_blob_find(&ctx, mask, w, h, NULL) == 0);
+    fill_rect(w, 20, 1, 5, 10, 1u << 2);
+    CHECK(ph_blob_find(&ctx, mask, w, h, NULL) == 1 && ctx.blobs[0].cls == 2);
+    CHECK(ctx.blobs[0].rect.x == 20 && ctx.blobs[0].rect.y == 1 && ph_blob_area(&ctx.blobs[0]) == 50);
+    CHECK(ctx.blobs[0].cx == 22.0f && ctx.blobs[0].cy == 5.5f);
+
+    // 合并：外接矩形重叠的同类色块合并；相隔一列的、不同类别的不合并
+    memset(mask, 0, sizeof(mask));
+    fill_rect(w, 0, 0, 12, 2, 1);  // U 形的底
+    fill_rect(w, 0, 2, 2, 12, 1);  // 左臂
+    fill_rect(w, 10, 2, 2, 12, 1); // 右臂
+    fill_rect(w, 4, 4, 5, 10, 1);  // U 内部，不相连
+    fill_rect(w, 14, 0, 5, 10, 1); // 与右臂相隔 2 列
+    fill_rect(w, 4, 14, 5, 10, 2);
+    fill_rect(w, 10, 14, 5, 10, 2); // 与左边相隔 1 列
+    fill_rect(w, 20, 14, 6, 10, 4);
+    fill_rect(w, 23, 16, 6, 10, 8); // 与上一个重叠，类别不同
+    CHECK(check_against_ref(&ctx, w, h, NULL));
+    CHECK(ctx.nblobs == 6 && ctx.stats.merged == 1);
+    for (i = 0; i < ctx.nblobs; i++)
+    {
+        if (ctx.blobs[i].cls == 0 && ctx.blobs[i].rect.x == 0)
+            CHECK(ctx.blobs[i].rect.w == 12 && ctx.blobs[i].rect.h == 14 && ctx.blobs[i].pixels == 24 + 48 + 50);
+    }
+
+    // ROI 把一个色块切开，切下的部分各自过滤
+    roi.x = 0;
+    roi.y = 0;
+    roi.w = 5;
+    roi.h = h;
+    CHECK(check_against_ref(&ctx, w, h, &roi));
+    CHECK(ctx.nblobs == 1 && ctx.blobs[0].rect.w == 5 && ctx.blobs[0].rect.h == 14);
+    roi.x = -10;
+    roi.y = 13;
+    roi.w = 1000;
+    roi.h = 1000;
+    CHECK(check_against_ref(&ctx, w, h, &roi) && ctx.nblobs == 4);
+    roi.x = w;
+    roi.y = 0;
+    CHECK(ph_blob_find(&ctx, mask, w, h, &roi) == 0);
+    roi.x = 0;
+    roi.w = -5;
+    CHECK(ph_blob_find(&ctx, mask, w, h, &roi) == 0);
+
+    ph_blob_free(&ctx);
+}
+
+// 图像上方 200 个小色块，下方一个大色块：大色块必须保留，保留的是面积最大的 PH_BLOB_MAX 个
+static void test_overflow(void)
+{
+    static ref_blobs_t ref;
+    ph_blob_ctx_t ctx;
+    const ph_blob_t *best;
+    int i, k, min_kept = MAX_W * MAX_H, max_dropped = 0;
+
+    memset(mask, 0, sizeof(mask));
+    for (i = 0; i < 200; i++)
+    {
+        // 4x13 到 4x17，彼此相隔 2 个像素，不会合并
+        int x = (i % 50) * 6, y = (i / 50) * 20;
+
+        fill_rect(MAX_W, x, y, 4, 13 + i % 5, 1u << (i % 3));
+    }
+    fill_rect(MAX_W, 100, 150, 80, 60, 1u << 5);
+
+    CHECK(ph_blob_init(&ctx, MAX_W) == 0);
+    CHECK(ph_blob_find(&ctx, mask, MAX_W, MAX_H, NULL) == PH_BLOB_MAX);
+    CHECK(ctx.stats.dropped_blobs == 201 - PH_BLOB_MAX);
+    best = ph_blob_best(&ctx);
+    CHECK(best != NULL && best->cls == 5 && best->rect.x == 100 && best->rect.y == 150);
+    CHECK(best && ph_blob_area(best) == 80 * 60 && best->pixels == 80 * 60);
+
+    // 保留的色块每个都不小于任何一个被丢弃的
+    ref_find(MAX_W, MAX_H, NULL, &ref);
+    CHECK(ref.n == 201);
+    for (i = 0; i < ref.n; i++)
+    {
+        int kept = 0;
+
+        for (k = 0; k < ctx.nblobs; k++)
+            kept |= blob_cmp(&ctx.blobs[k], &ref.b[i]) == 0;
+        if (kept && ph_blob_area(&ref.b[i]) < min_kept)
+            min_kept = ph_blob_area(&ref.b[i]);
+        if (!kept && ph_blob_area(&ref.b[i]) > max_dropped)
+            max_dropped = ph_blob_area(&ref.b[i]);
+    }
+    CHECK(min_kept >= max_dropped);
+
+    // 表满时先合并：同类的小色块连成一片后不再占满色块表
+    memset(mask, 0, sizeof(mask));
+    for (i = 0; i < 100; i++)
+        fill_rect(MAX_W, (i % 25) * 12, (i / 25) * 20, 5, 12, 1); // 相隔 7 列，不合并
+    for (i = 0; i < 100; i++)
+        fill_rect(MAX_W, (i % 25) * 12 + 3, 100 + (i / 25) * 20, 5, 12, 2);
+    fill_rect(MAX_W, 0, 90, 300, 1, 2); // 一条横线把下方的色块框在一起
+    fill_rect(MAX_W, 0, 230, 300, 1, 2);
+    fill_rect(MAX_W, 0, 90, 1, 141, 2);
+    CHECK(ph_blob_find(&ctx, mask, MAX_W, MAX_H, NULL) <= PH_BLOB_MAX);
+    best = ph_blob_best(&ctx);
+    CHECK(best != NULL && best->cls == 1 && best->rect.x == 0 && best->rect.y == 90);
+    CHECK(best && best->rect.w == 300 && best->rect.h == 141);
+
+    ph_blob_free(&ctx);
+}
+
+int main(void)
+{
+    test_random();
+    test_cases();
+    test_overflow();
+    return TEST_RESULT();
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ph_detect.h"
+#include "test.h"
+
+/*
+ * pH 颜色分类测试：全部 65536 个 RGB565 值经查找表、直接换算（NEON 或标量）
+ * 和按类别逐个比较的参考实现分类，结果必须逐值一致；
+ * LAB 换算与 OpenMV 的公式（sRGB、D65、向下取整）按双精度计算的结果比较；
+ * 重新标定阈值只改变该类别的一位，格式错误的文本不改变任何类别。
+ */
+
+// 参考实现：每个类别把全部值换算比较一遍，与 视觉代码.py 的 find_blobs 做法相同
+static void classify_ref(const uint16_t *pixels, int n, uint16_t *mask)
+{
+    ph_lab_t lab;
+    int i, k;
+
+    memset(mask, 0, n * sizeof(mask[0]));
+    for (k = 0; k < PH_CLASSES; k++)
+    {
+        const ph_class_t *c = ph_class_get(k);
+
+        for (i = 0; i < n; i++)
+        {
+            ph_rgb565_to_lab(pixels[i], &lab);
+            if (lab.l >= c->l_min && lab.l <= c->l_max &&
+                lab.a >= c->a_min && lab.a <= c->a_max &&
+                lab.b >= c->b_min && lab.b <= c->b_max)
+                mask[i] |= 1u << k;
+        }
+    }
+}
+
+static uint16_t values[PH_LUT_SIZE];
+static uint16_t lut_mask[PH_LUT_SIZE], direct_mask[PH_LUT_SIZE], ref_mask[PH_LUT_SIZE];
+
+static int count_diff(const uint16_t *a, const uint16_t *b, uint16_t bits)
+{
+    int v, n = 0;
+
+    for (v = 0; v < PH_LUT_SIZE; v++)
+        n += ((a[v] ^ b[v]) & bits) != 0;
+    return n;
+}
+
+static void test_classify(void)
+{
+    int v, hits = 0;
+
+    for (v = 0; v < PH_LUT_SIZE; v++)
+        values[v] = v;
+    ph_classify(values, PH_LUT_SIZE, lut_mask);
+    ph_classify_direct(values, PH_LUT_SIZE, direct_mask);
+    classify_ref(values, PH_LUT_SIZE, ref_mask);
+
+    printf("%s: lut %d, direct %d values differ from the per-class reference\n", ph_classify_impl(),
+           count_diff(lut_mask, ref_mask, 0xFFFF), count_diff(direct_mask, ref_mask, 0xFFFF));
+    CHECK(count_diff(lut_mask, ref_mask, 0xFFFF) == 0);
+    CHECK(count_diff(direct_mask, ref_mask, 0xFFFF) == 0);
+    // 不足 8 个像素的尾部走标量路径
+    ph_classify_direct(values + 1001, 7, direct_mask);
+    CHECK(memcmp(direct_mask, ref_mask + 1001, 7 * sizeof(direct_mask[0])) == 0);
+
+    for (v = 0; v < PH_LUT_SIZE; v++)
+        hits += ref_mask[v] != 0;
+    CHECK(hits > 1000 && hits < PH_LUT_SIZE);
+}
+
+/*
+ * OpenMV 的换算：5/6 位扩展到 8 位，sRGB 伽马解码，乘 D65 矩阵并除以白点，
+ * f(t) 在 t > 0.008856 时取立方根，结果向下取整
+ */
+static double srgb_lin(int c8)
+{
+    double c = c8 / 255.0;
+
+    return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double lab_f(double t)
+{
+    return t > 0.008856 ? cbrt(t) : 7.787037 * t + 16.0 / 116.0;
+}
+
+static void lab_ref(uint16_t pixel, double lab[3])
+{
+    double r = srgb_lin(((pixel >> 11) * 527 + 23) >> 6);
+    double g = srgb_lin((((pixel >> 5) & 0x3F) * 259 + 33) >> 6);
+    double b = srgb_lin(((pixel & 0x1F) * 527 + 23) >> 6);
+    double fx = lab_f((0.4124 * r + 0.3576 * g + 0.1805 * b) / 0.95047);
+    double fy = lab_f(0.2126 * r + 0.7152 * g + 0.0722 * b);
+    double fz = lab_f((0.0193 * r + 0.1192 * g + 0.9505 * b) / 1.08883);
+
+    lab[0] = 116.0 * fy - 16.0;
+    lab[1] = 500.0 * (fx - fy);
+    lab[2] = 200.0 * (fy - fz);
+}
+
+static void test_lab(void)
+{
+    // RGB565 原色和灰度的 LAB，按 OpenMV 的公式双精度计算后向下取整
+    static const struct
+    {
+        uint16_t pixel;
+        int l, a, b;
+    } known[] = {
+        {0x0000, 0, 0, 0},      // 黑，L 不能因 16/116 的舍入变成 -1
+        {0xF800, 53, 80, 67},   // 红 (255,0,0)
+        {0x07E0, 87, -87, 83},  // 绿 (0,255,0)
+        {0x001F, 32, 79, -108}, // 蓝 (0,0,255)
+        {0xFFE0, 97, -22, 94},  // 黄
+        {0x07FF, 91, -49, -15}, // 青
+        {0xF81F, 60, 98, -61},  // 品红
+        {0x8410, 54, 1, -1},    // 灰 (132,130,132)
+    };
+    ph_lab_t lab;
+    double ref[3];
+    unsigned i;
+    int v, k, exact = 0, off = 0, near_edge = 0, l_range = 0;
+
+    for (i = 0; i < sizeof(known) / sizeof(known[0]); i++)
+    {
+        ph_rgb565_to_lab(known[i].pixel, &lab);
+        CHECK(lab.l == known[i].l && lab.a == known[i].a && lab.b == known[i].b);
+    }
+    // 白色的 A/B 在 0 附近，向下取整可能得到 -1
+    ph_rgb565_to_lab(0xFFFF, &lab);
+    CHECK(lab.l == 100 && lab.a >= -1 && lab.a <= 0 && lab.b >= -1 && lab.b <= 0);
+
+    // 全部值：单精度实现与双精度公式向下取整的结果一致，
+    // 只有距整数边界不到 0.01 的分量允许差 1
+    for (v = 0; v < PH_LUT_SIZE; v++)
+    {
+        int got[3];
+
+        ph_rgb565_to_lab(v, &lab);
+        lab_ref(v, ref);
+        l_range += lab.l < 0 || lab.l > 100;
+        got[0] = lab.l;
+        got[1] = lab.a;
+        got[2] = lab.b;
+        for (k = 0; k < 3; k++)
+        {
+            double f = floor(ref[k]);
+
+            if (got[k] == (int)f)
+                exact++;
+            else if (abs(got[k] - (int)f) == 1 && (ref[k] - f < 0.01 || f + 1 - ref[k] < 0.01))
+                near_edge++;
+            else
+                off++;
+        }
+    }
+    printf("LAB: %d components exact, %d off by one at an integer edge, %d wrong\n", exact, near_edge, off);
+    CHECK(off == 0 && l_range == 0);
+    CHECK(near_edge < PH_LUT_SIZE * 3 / 1000);
+}
+
+static void get_th(int k, int th[6])
+{
+    const ph_class_t *c = ph_class_get(k);
+
+    th[0] = c->l_min;
+    th[1] = c->l_max;
+    th[2] = c->a_min;
+    th[3] = c->a_max;
+    th[4] = c->b_min;
+    th[5] = c->b_max;
+}
+
+static void test_threshold(void)
+{
+    static uint16_t before[PH_LUT_SIZE], after[PH_LUT_SIZE];
+    static const char *const bad[] = {
+        "pH7:35,70,-25,25,25",        // 少一个值
+        "pH7:35,70,-25,25,25,90,1",   // 多一个值
+        "pH7:35,70,-25,25,25,90x",    // 结尾多余字符
+        "pH7 35,70,-25,25,25,90",     // 没有冒号
+        "pH15:35,70,-25,25,25,90",    // 没有这个类别
+        "pH:35,70,-25,25,25,90",
+        "ph7:35,70,-25,25,25,90",     // 标签区分大小写
+        "pH7:70,35,-25,25,25,90",     // 下限大于上限
+        "pH7:-1,70,-25,25,25,90",     // L 超出 0~100
+        "pH7:35,101,-25,25,25,90",
+        "pH7:35,70,-129,25,25,90",    // A/B 超出 -128~127
+        "pH7:35,70,-25,25,25,128",
+        "pH7:35,70,a,25,25,90",
+    };
+    ph_lut_stats_t st0, st;
+    int th7[6], th1[6], th[6] = {40, 60, -20, 0, 30, 60};
+    unsigned i;
+
+    get_th(6, th7);
+    get_th(0, th1);
+    ph_classify(values, PH_LUT_SIZE, before);
+    ph_lut_get_stats(&st0);
+
+    // 只改变 pH7 这一位，其余位不变，新的一位与参考实现一致
+    CHECK(ph_set_threshold(6, th) == 0);
+    ph_classify(values, PH_LUT_SIZE, after);
+    classify_ref(values, PH_LUT_SIZE, ref_mask);
+    CHECK(count_diff(after, before, (uint16_t)~(1u << 6)) == 0);
+    CHECK(count_diff(after, before, 1u << 6) > 0);
+    CHECK(count_diff(after, ref_mask, 0xFFFF) == 0);
+    ph_lut_get_stats(&st);
+    CHECK(st.rebuilds == st0.rebuilds + 1);
+
+    // 文本形式恢复原阈值，表回到原样
+    CHECK(ph_set_threshold_text("pH7:35,70,-25,25,25,90") == 6);
+    get_th(6, th);
+    CHECK(memcmp(th, th7, sizeof(th)) == 0);
+    ph_classify(values, PH_LUT_SIZE, after);
+    CHECK(count_diff(after, before, 0xFFFF) == 0);
+
+    // "pH1" 不能匹配到 "pH10"，反之亦然
+    CHECK(ph_set_threshold_text("pH10:20,55,-55,-5,-25,60") == 9);
+    CHECK(ph_set_threshold_text("pH1:25,100,25,127,10,90") == 0);
+    ph_classify(values, PH_LUT_SIZE, after);
+    CHECK(count_diff(after, before, 0xFFFF) == 0);
+
+    ph_lut_get_stats(&st0);
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        CHECK(ph_set_threshold_text(bad[i]) == -1);
+    th[0] = 0;
+    th[1] = 100;
+    CHECK(ph_set_threshold(-1, th) == -1);
+    CHECK(ph_set_threshold(PH_CLASSES, th) == -1);
+    ph_lut_get_stats(&st);
+    CHECK(st.rebuilds == st0.rebuilds);
+    get_th(6, th);
+    CHECK(memcmp(th, th7, sizeof(th)) == 0);
+    get_th(0, th);
+    CHECK(memcmp(th, th1, sizeof(th)) == 0);
+    ph_classify(values, PH_LUT_SIZE, after);
+    CHECK(count_diff(after, before, 0xFFFF) == 0);
+}
+
+int main(void)
+{
+    test_classify();
+    test_lab();
+    test_threshold();
+    return TEST_RESULT();
+}
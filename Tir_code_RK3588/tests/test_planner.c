@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "motor.h"
+#include "planner.h"
+#include "step_sched.h"
+#include "task.h"
+#include "test.h"
+
+/*
+ * planner 单元测试：曲线形状、总时间、分段量化，
+ * 以及经步进调度器在 --sim 仿真GPIO上实际走一段运动，核对边沿数和耗时。
+ */
+
+#define SPC 500.0f // 测试用每圈边沿数
+
+// 逐边沿间隔：先单调不增，到匀速后不变，再单调不减；返回间隔总和 s
+static double check_interval_shape(motion_plan_t *plan, double cruise_ns)
+{
+    uint32_t prev = 0, dt, min = UINT32_MAX;
+    double sum = 0;
+    int rising = 0, bad = 0;
+
+    while ((dt = planner_next_interval_ns(plan)) != 0)
+    {
+        sum += dt / 1e9;
+        if (dt < min)
+            min = dt;
+        // 量化到 ns 后相邻间隔允许 1ns 的抖动
+        if (prev && dt > prev + 1)
+            rising = 1;
+        else if (prev && rising && dt + 1 < prev)
+            bad++;
+        prev = dt;
+    }
+    CHECK(bad == 0);
+    if (cruise_ns > 0)
+        CHECK_NEAR(min, cruise_ns, 1);
+    return sum;
+}
+
+// 相邻分段的速度和位置连续
+static void check_continuity(const motion_plan_t *plan)
+{
+    int i;
+
+    for (i = 1; i < plan->segment_count; i++)
+    {
+        const planner_segment_t *a = &plan->seg[i - 1];
+        const planner_segment_t *b = &plan->seg[i];
+        double t = a->duration;
+
+        CHECK_NEAR(a->t0 + t, b->t0, 1e-9);
+        CHECK_NEAR(a->s0 + a->v0 * t + a->a0 * t * t / 2 + a->j * t * t * t / 6, b->s0, 1e-6);
+        CHECK_NEAR(a->v0 + a->a0 * t + a->j * t * t / 2, b->v0, 1e-6);
+    }
+}
+
+static void test_trapezoid(void)
+{
+    motion_limits_t lim = {4, 8, 0};
+    motion_plan_t plan;
+    double d = 10 * SPC, v = 4 * SPC, a = 8 * SPC;
+
+    CHECK(planner_plan(&plan, (uint32_t)d, &lim, SPC) == 0);
+    CHECK(plan.segment_count == 3);
+    CHECK_NEAR(plan.peak_velocity, v, 1e-6);
+    // 加速 v/a，匀速 (d - v²/a)/v，减速 v/a
+    CHECK_NEAR(plan.total_time, d / v + v / a, 1e-9);
+    check_continuity(&plan);
+    CHECK_NEAR(check_interval_shape(&plan, 1e9 / v), plan.total_time, plan.steps * 1e-9);
+}
+
+static void test_scurve(void)
+{
+    motion_limits_t lim = {4, 8, 80};
+    motion_plan_t plan;
+    double d = 10 * SPC, v = 4 * SPC, a = 8 * SPC, j = 80 * SPC;
+
+    CHECK(planner_plan(&plan, (uint32_t)d, &lim, SPC) == 0);
+    CHECK(plan.segment_count == 7);
+    // 达到最大加速度时每个加减速段比梯形多 a/j
+    CHECK_NEAR(plan.total_time, d / v + v / a + a / j, 1e-9);
+    CHECK(plan.seg[0].j > 0 && plan.seg[2].j < 0 && plan.seg[4].j < 0 && plan.seg[6].j > 0);
+    check_continuity(&plan);
+    CHECK_NEAR(check_interval_shape(&plan, 1e9 / v), plan.total_time, plan.steps * 1e-9);
+}
+
+static void test_short_move(void)
+{
+    motion_limits_t lim = {4, 8, 0};
+    motion_plan_t plan;
+    double d = 100, a = 8 * SPC;
+
+    // 距离不够加速到最高速度：三角形曲线，峰值 sqrt(d*a)，总时间 2*sqrt(d/a)
+    CHECK(planner_plan(&plan, (uint32_t)d, &lim, SPC) == 0);
+    CHECK(plan.peak_velocity < 4 * SPC);
+    CHECK_NEAR(plan.peak_velocity, sqrt(d * a), 1e-6);
+    CHECK_NEAR(plan.total_time, 2 * sqrt(d / a), 1e-9);
+    CHECK_NEAR(planner_time_at(&plan, plan.steps), plan.total_time, 1e-12);
+    CHECK_NEAR(planner_time_at(&plan, d / 2), plan.total_time / 2, 1e-9);
+
+    CHECK(planner_plan(&plan, 0, &lim, SPC) == 0 && plan.total_time == 0);
+    lim.acceleration = 0;
+    CHECK(planner_plan(&plan, 100, &lim, SPC) < 0);
+}
+
+// 分段边沿数之和等于总数，分段时长之和等于曲线时长
+static void check_chunks(const motion_plan_t *plan, uint32_t min_period_ns)
+{
+    planner_chunk_t chunks[GPIO_PULSE_MAX_SEGS];
+    uint64_t edges = 0;
+    double time = 0;
+    int n, i;
+
+    n = planner_to_chunks(plan, chunks, GPIO_PULSE_MAX_SEGS, min_period_ns);
+    CHECK(n >= 1 && n <= GPIO_PULSE_MAX_SEGS);
+    for (i = 0; i < n; i++)
+    {
+        CHECK(chunks[i].edges > 0);
+        CHECK(chunks[i].period_ns >= min_period_ns);
+        edges += chunks[i].edges;
+        time += chunks[i].edges * (double)chunks[i].period_ns / 1e9;
+    }
+    CHECK(edges == plan->steps);
+    if (plan->peak_velocity * min_period_ns <= 1e9)
+        CHECK_NEAR(time, plan->total_time, n * plan->steps * 0.5e-9 + 1e-9 * plan->steps);
+    else
+        CHECK(time > plan->total_time);
+}
+
+static void test_chunks(void)
+{
+    motion_limits_t trap = {4, 8, 0}, scurve = {8, 8, 80};
+    motion_limits_t fast = {400, 800, 0}; // 峰值 200000 边沿/秒，超过驱动的 5000ns 下限
+    motion_plan_t plan;
+
+    planner_plan(&plan, 10 * SPC, &trap, SPC);
+    check_chunks(&plan, GPIO_PULSE_MIN_PERIOD_NS);
+    planner_plan(&plan, 18 * SPC, &scurve, SPC);
+    check_chunks(&plan, GPIO_PULSE_MIN_PERIOD_NS);
+    planner_plan(&plan, 37, &trap, SPC);
+    check_chunks(&plan, GPIO_PULSE_MIN_PERIOD_NS);
+    planner_plan(&plan, 100 * SPC, &fast, SPC);
+    check_chunks(&plan, GPIO_PULSE_MIN_PERIOD_NS);
+}
+
+static int wait_done(motor *motor_p, uint64_t timeout_ns)
+{
+    uint64_t end = monotonic_ns() + timeout_ns;
+    motor_state_t st;
+
+    while (monotonic_ns() < end)
+    {
+        Motor_Get_State(motor_p, &st);
+        if (st.State == 1)
+            return 1;
+        Motor_Done_Wait(10000000ull);
+    }
+    return 0;
+}
+
+// 在仿真GPIO上走一段运动，比较 PUL 边沿数和调度器记录的耗时与规划结果
+static void sim_move(motor *motor_p, int index, float target, float v, float a, float j)
+{
+    motion_limits_t lim = {v, a, j};
+    motion_plan_t plan;
+    gpio_sim_pin_t before, after;
+    step_axis_stats_t stats;
+    motor_timing_t timing;
+    motor_state_t st;
+    uint32_t edges;
+
+    Motor_Get_State(motor_p, &st);
+    edges = (uint32_t)abs(Motor_Circle_To_Step(motor_p, target) - st.Current_Step);
+    planner_plan(&plan, edges, &lim, Motor_Steps_Per_Circle(motor_p));
+
+    Set_Motor_Limits(index, v, a, j);
+    gpio_sim_get(motor_p->PUL_GPIO, &before);
+    Set_Motor_Target(index, target);
+    Begin_Motor_flag(motor_p);
+    CHECK(wait_done(motor_p, (uint64_t)(plan.total_time * 3e9) + 1000000000ull));
+    gpio_sim_get(motor_p->PUL_GPIO, &after);
+    step_sched_get_stats(index, &stats);
+    Motor_Get_Timing(motor_p, &timing);
+
+    printf("sim move to %.2f: %u edges, planned %.4f s, measured %.4f s, %u missed\n",
+           target, after.edges - before.edges, plan.total_time, stats.last_time, timing.missed);
+    CHECK(after.edges - before.edges == edges);
+    CHECK(timing.edges == edges);
+    CHECK(stats.last_edges == edges && stats.aborted == 0 && stats.fallbacks == 0);
+    CHECK_NEAR(stats.last_planned, plan.total_time, 1e-9);
+    Motor_Get_State(motor_p, &st);
+    CHECK(st.Current_Step == Motor_Circle_To_Step(motor_p, target));
+    // 不会提前；丢失的边沿从当前时间重新对齐，总延迟是耗时超出规划的上限
+    CHECK(stats.last_time >= plan.total_time - 1e-4);
+    CHECK(stats.last_time <= plan.total_time + timing.late_sum_ns / 1e9 + 0.002);
+}
+
+static void test_sim(void)
+{
+    pthread_t sched;
+
+    motor_gpio_use_sim();
+    CHECK(motor_io_init() == 0);
+    CHECK(pthread_create(&sched, NULL, step_sched_task, NULL) == 0);
+
+    sim_move(&motor_data_C, Motor_C, 2.0f, 4, 8, 0);
+    sim_move(&motor_data_C, Motor_C, 0.5f, 4, 8, 80);
+    sim_move(&motor_data_C, Motor_C, 0.52f, 4, 8, 80);
+
+    running = 0;
+    step_sched_kick();
+    pthread_join(sched, NULL);
+    motor_cleanup();
+}
+
+int main(void)
+{
+    test_trapezoid();
+    test_scurve();
+    test_short_move();
+    test_chunks();
+    test_sim();
+    return TEST_RESULT();
+}
@@ -0,0 +1,329 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "motor.h"
+#include "protocol.h"
+#include "serial.h"
+#include "test.h"
+
+/*
+ * 串口帧协议测试：同一段字节流（pH 帧、文本命令、文本中夹杂的 0xA5、CRC 错误的帧）
+ * 按不同分段直接送入解析器，再经过伪终端对（posix_openpt）用 serial.c 的收发函数传输，
+ * 检查帧按顺序全部取出、帧外字节原样交给文本解析器，并给出每秒帧数。
+ */
+
+#define STREAM_FRAMES 20000
+#define TEXT_MAX (64 * 1024)
+
+typedef struct
+{
+    uint8_t buf[TEXT_MAX];
+    int len;
+} text_sink_t;
+
+typedef struct
+{
+    uint8_t *data;
+    int len;
+    uint8_t text[TEXT_MAX]; // 应交给文本解析器的字节
+    int text_len;
+    int corrupted;          // CRC 错误的帧数
+} stream_t;
+
+static stream_t stream;
+
+static void text_byte(uint8_t byte, void *ctx)
+{
+    text_sink_t *sink = ctx;
+
+    if (sink->len < TEXT_MAX)
+        sink->buf[sink->len++] = byte;
+}
+
+static void append(stream_t *s, const void *data, int len, int is_text)
+{
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    if (is_text)
+    {
+        memcpy(s->text + s->text_len, data, len);
+        s->text_len += len;
+    }
+}
+
+static float frame_value(int k)
+{
+    return 7.0f + (float)(k % 700) * 0.01f;
+}
+
+static void build_stream(stream_t *s)
+{
+    uint8_t frame[PROTO_MAX_FRAME], payload[4];
+    int k, n;
+
+    s->data = malloc(STREAM_FRAMES * 16 + TEXT_MAX);
+    s->len = s->text_len = s->corrupted = 0;
+    for (k = 0; k < STREAM_FRAMES; k++)
+    {
+        if (k % 400 == 50)
+        {
+            // 0xA5 后面是可打印字符，立即判定不是帧头
+            append(s, "M A=1.5\n", 8, 1);
+            append(s, "x\xA5" "B=2\n", 6, 1);
+            // 0xA5 后面是换行，长度字节取到下一帧的 0xA5，长度不合理
+            append(s, "y\xA5\n", 3, 1);
+        }
+        if (k % 1000 == 999)
+        {
+            // 负载错一位，整帧作为文本交出，后面的帧不受影响
+            proto_put_f32(payload, 1.0f);
+            n = proto_encode(PROTO_PH_RESULT, 0x11, payload, 4, frame, sizeof(frame));
+            frame[PROTO_HEADER_LEN] ^= 0x01;
+            append(s, frame, n, 1);
+            s->corrupted++;
+        }
+        proto_put_f32(payload, frame_value(k));
+        n = proto_encode(PROTO_PH_RESULT, (uint8_t)k, payload, 4, frame, sizeof(frame));
+        append(s, frame, n, 0);
+    }
+}
+
+static int check_frame(const proto_frame_t *f, int k)
+{
+    return f->type == PROTO_PH_RESULT && f->len == 4 && f->seq == (uint8_t)k &&
+           proto_get_f32(f->payload) == frame_value(k);
+}
+
+// 解析器取出的帧与文本和期望值比较
+typedef struct
+{
+    proto_parser_t parser;
+    text_sink_t text;
+    int frames;
+    int bad;
+} rx_t;
+
+static void rx_init(rx_t *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+    proto_parser_init(&rx->parser, text_byte, &rx->text);
+}
+
+static void rx_feed(rx_t *rx, const uint8_t *data, int len)
+{
+    proto_frame_t f;
+
+    proto_feed(&rx->parser, data, len);
+    while (proto_next(&rx->parser, &f))
+    {
+        if (!check_frame(&f, rx->frames))
+            rx->bad++;
+        rx->frames++;
+    }
+}
+
+static void rx_check(const rx_t *rx)
+{
+    CHECK(rx->frames == STREAM_FRAMES);
+    CHECK(rx->bad == 0);
+    CHECK(rx->parser.stats.frames == STREAM_FRAMES);
+    CHECK(rx->parser.stats.crc_errors >= (uint64_t)stream.corrupted);
+    CHECK(rx->parser.stats.discarded == 0 && rx->parser.stats.overflows == 0);
+    CHECK(rx->text.len == stream.text_len);
+    CHECK(memcmp(rx->text.buf, stream.text, stream.text_len) == 0);
+    CHECK(rx->parser.head == rx->parser.tail);
+}
+
+static void test_basic(void)
+{
+    uint8_t frame[PROTO_MAX_FRAME], payload[PROTO_MAX_PAYLOAD];
+    proto_parser_t p;
+    proto_frame_t f;
+    text_sink_t text;
+    int n, i;
+
+    // CRC-16/CCITT-FALSE 标准校验值
+    CHECK(proto_crc16((const uint8_t *)"123456789", 9) == 0x29B1);
+
+    CHECK(proto_encode(PROTO_ACK, 1, payload, PROTO_MAX_PAYLOAD + 1, frame, sizeof(frame)) < 0);
+    CHECK(proto_encode(PROTO_ACK, 1, payload, 2, frame, 7) < 0);
+
+    // 负载和 seq 中的 0xA5 不影响解析
+    memset(payload, PROTO_SYNC, sizeof(payload));
+    n = proto_encode(PROTO_MOTION, PROTO_SYNC, payload, PROTO_MAX_PAYLOAD, frame, sizeof(frame));
+    CHECK(n == PROTO_MAX_FRAME);
+    memset(&text, 0, sizeof(text));
+    proto_parser_init(&p, text_byte, &text);
+    proto_feed(&p, frame, n);
+    CHECK(proto_next(&p, &f) == 1);
+    CHECK(f.type == PROTO_MOTION && f.seq == PROTO_SYNC && f.len == PROTO_MAX_PAYLOAD);
+    CHECK(memcmp(f.payload, payload, PROTO_MAX_PAYLOAD) == 0);
+    CHECK(proto_next(&p, &f) == 0 && text.len == 0);
+
+    // 文本中的 0xA5 后面跟着文本字符：不等凑满一帧，两个字节立即交给文本解析器
+    proto_feed(&p, (const uint8_t *)"\xA5", 1);
+    CHECK(proto_next(&p, &f) == 0 && text.len == 0);
+    proto_feed(&p, (const uint8_t *)"M", 1);
+    CHECK(proto_next(&p, &f) == 0);
+    CHECK(text.len == 2 && text.buf[0] == PROTO_SYNC && text.buf[1] == 'M');
+    CHECK(p.stats.resyncs == 1 && p.head == p.tail);
+
+    // 合理的帧头等待剩余字节，逐字节送入也能取出
+    text.len = 0;
+    proto_put_f32(payload, 6.86f);
+    n = proto_encode(PROTO_PH_RESULT, 7, payload, 4, frame, sizeof(frame));
+    for (i = 0; i < n - 1; i++)
+    {
+        proto_feed(&p, &frame[i], 1);
+        CHECK(proto_next(&p, &f) == 0);
+    }
+    proto_feed(&p, &frame[n - 1], 1);
+    CHECK(proto_next(&p, &f) == 1 && f.seq == 7 && proto_get_f32(f.payload) == 6.86f);
+    CHECK(text.len == 0);
+
+    // 没有文本解析器时帧外字节计入 discarded
+    proto_parser_init(&p, NULL, NULL);
+    proto_feed(&p, (const uint8_t *)"ab\xA5z", 4);
+    CHECK(proto_next(&p, &f) == 0);
+    CHECK(p.stats.discarded == 4 && p.stats.resyncs == 1);
+
+    // 缓冲区满时多余字节丢弃
+    memset(payload, 'a', sizeof(payload));
+    for (i = 0; i < PROTO_RING_SIZE / PROTO_MAX_PAYLOAD; i++)
+        CHECK(proto_feed(&p, payload, PROTO_MAX_PAYLOAD) == PROTO_MAX_PAYLOAD);
+    CHECK(proto_feed(&p, payload, 10) == 0 && p.stats.overflows == 10);
+}
+
+// 同一段字节流按不同大小分段送入，结果相同
+static void test_split(void)
+{
+    static const int chunks[] = {1, 3, 10, 64, 1000};
+    rx_t *rx = malloc(sizeof(*rx));
+    unsigned c;
+    int off, n;
+
+    for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+    {
+        rx_init(rx);
+        for (off = 0; off < stream.len; off += n)
+        {
+            n = stream.len - off < chunks[c] ? stream.len - off : chunks[c];
+            rx_feed(rx, stream.data + off, n);
+        }
+        rx_check(rx);
+    }
+    free(rx);
+}
+
+static void *pty_writer(void *arg)
+{
+    int fd = *(int *)arg;
+    int off = 0, n;
+
+    while (off < stream.len)
+    {
+        n = func_send_frame(fd, stream.data + off, stream.len - off > 4096 ? 4096 : stream.len - off);
+        if (n <= 0)
+            break;
+        off += n;
+    }
+    return NULL;
+}
+
+// 伪终端对：主端写入，从端按 serial_event 的方式读取并解析
+static void test_pty(void)
+{
+    uint8_t buf[256], ack[PROTO_MAX_FRAME], status[2] = {0x42, PROTO_ACK_OK};
+    rx_t *rx = malloc(sizeof(*rx));
+    proto_parser_t p;
+    proto_frame_t f;
+    pthread_t writer;
+    uint64_t t0, dt, deadline;
+    int master, slave, n;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("posix_openpt");
+        free(rx);
+        return;
+    }
+    slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    CHECK(func_set_opt(slave, 115200, 8, 1, 'N', 0) == 0);
+
+    rx_init(rx);
+    t0 = monotonic_ns();
+    deadline = t0 + 10000000000ull;
+    pthread_create(&writer, NULL, pty_writer, &master);
+    while (rx->frames < STREAM_FRAMES && monotonic_ns() < deadline)
+    {
+        n = func_receive_frame(slave, buf, sizeof(buf));
+        if (n > 0)
+            rx_feed(rx, buf, n);
+    }
+    dt = monotonic_ns() - t0;
+    pthread_join(writer, NULL);
+    rx_check(rx);
+    printf("pty: %d frames, %d text bytes in %.1f ms, %.0f frames/s\n",
+           rx->frames, rx->text.len, dt / 1e6, rx->frames * 1e9 / dt);
+    // 921600 波特率下 10 字节的帧约 9200 帧/s，伪终端加解析器应至少达到这个速率
+    CHECK(rx->frames * 1e9 / dt > 9200);
+
+    // 反方向：从端发出 ACK，主端收到
+    n = proto_encode(PROTO_ACK, 3, status, sizeof(status), ack, sizeof(ack));
+    CHECK(func_send_frame(slave, ack, n) == n);
+    proto_parser_init(&p, NULL, NULL);
+    deadline = monotonic_ns() + 1000000000ull;
+    while (!proto_next(&p, &f) && monotonic_ns() < deadline)
+    {
+        n = func_receive_frame(master, buf, sizeof(buf));
+        if (n > 0)
+            proto_feed(&p, buf, n);
+    }
+    CHECK(p.stats.frames == 1);
+    CHECK(f.type == PROTO_ACK && f.seq == 3 && f.len == 2 && f.payload[0] == 0x42 && f.payload[1] == PROTO_ACK_OK);
+
+    close(slave);
+    close(master);
+    free(rx);
+}
+
+// 只计解析器：逐段送入并取帧的速率
+static void bench_parser(void)
+{
+    rx_t *rx = malloc(sizeof(*rx));
+    uint64_t t0, dt;
+    int off, n, round;
+
+    t0 = monotonic_ns();
+    for (round = 0; round < 10; round++)
+    {
+        rx_init(rx);
+        for (off = 0; off < stream.len; off += n)
+        {
+            n = stream.len - off < 256 ? stream.len - off : 256;
+            rx_feed(rx, stream.data + off, n);
+        }
+    }
+    dt = monotonic_ns() - t0;
+    rx_check(rx);
+    printf("parser: %.0f frames/s, %.1f MB/s\n", 10.0 * STREAM_FRAMES * 1e9 / dt, 10.0 * stream.len * 1e3 / dt);
+    free(rx);
+}
+
+int main(void)
+{
+    build_stream(&stream);
+    test_basic();
+    test_split();
+    test_pty();
+    bench_parser();
+    free(stream.data);
+    return TEST_RESULT();
+}
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "motor.h"
+#include "pwm.h"
+#include "pwm_profile.h"
+#include "test.h"
+
+/*
+ * sysfs PWM 后端测试：在临时目录里建立 pwmchipN/pwmM 的属性文件，
+ * 用 pwm_set_root() 指向它，检查 period / duty_cycle / enable 的写入值；
+ * PWM 曲线引擎用指定的时刻调用 pwm_profile_poll()，检查每个时刻写入的占空比。
+ */
+
+static char root[64];
+
+static void make_file(const char *fmt, int chip, int channel)
+{
+    char path[256];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/", root);
+    snprintf(path + strlen(path), sizeof(path) - strlen(path), fmt, chip, channel);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+        close(fd);
+}
+
+static void make_chip(int chip)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/pwmchip%d", root, chip);
+    mkdir(path, 0755);
+    make_file("pwmchip%d/export", chip, 0);
+    make_file("pwmchip%d/unexport", chip, 0);
+}
+
+static void make_channel(int chip, int channel)
+{
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/pwmchip%d/pwm%d", root, chip, channel);
+    mkdir(path, 0755);
+    make_file("pwmchip%d/pwm%d/period", chip, channel);
+    make_file("pwmchip%d/pwm%d/duty_cycle", chip, channel);
+    make_file("pwmchip%d/pwm%d/enable", chip, channel);
+}
+
+// 读取属性文件的数值；pwrite 从偏移0覆盖，短值后面可能残留旧内容，只解析第一行
+static long read_value(int chip, const char *rel)
+{
+    char path[256], buf[32];
+    ssize_t n;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/pwmchip%d/%s", root, chip, rel);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = '\0';
+    return strtol(buf, NULL, 10);
+}
+
+static void test_open_and_write(void)
+{
+    pwm_status_t st;
+    int h;
+
+    make_chip(0);
+    make_channel(0, 0);
+
+    h = pwm_open(0, 0);
+    CHECK(h >= 0);
+    CHECK(pwm_open(0, 0) == h);
+    CHECK(read_value(0, "pwm0/period") == PWM_DEFAULT_PERIOD_NS);
+    CHECK(read_value(0, "pwm0/duty_cycle") == 0);
+    CHECK(read_value(0, "pwm0/enable") == 1);
+
+    CHECK(pwm_set_percent(h, 50) == 0);
+    CHECK(read_value(0, "pwm0/duty_cycle") == PWM_DEFAULT_PERIOD_NS / 2);
+
+    // 缩短周期：占空比百分比不变，duty_cycle 随之缩小
+    CHECK(pwm_set_period(h, 200000) == 0);
+    CHECK(read_value(0, "pwm0/period") == 200000);
+    CHECK(read_value(0, "pwm0/duty_cycle") == 100000);
+    CHECK(pwm_set_period(h, 400000) == 0);
+    CHECK(read_value(0, "pwm0/period") == 400000);
+    CHECK(read_value(0, "pwm0/duty_cycle") == 200000);
+    CHECK(pwm_set_period(h, 0) < 0);
+
+    // 超出范围截断
+    CHECK(pwm_set_percent(h, 150) == 0);
+    CHECK(read_value(0, "pwm0/duty_cycle") == 400000);
+    CHECK(pwm_set_percent(h, -5) == 0);
+    CHECK(read_value(0, "pwm0/duty_cycle") == 0);
+
+    CHECK(pwm_enable(h, 0) == 0);
+    CHECK(read_value(0, "pwm0/enable") == 0);
+    CHECK(pwm_enable(h, 1) == 0);
+    CHECK(read_value(0, "pwm0/enable") == 1);
+
+    CHECK(pwm_get_status(h, &st) == 0);
+    CHECK(st.chip == 0 && st.channel == 0);
+    CHECK(st.period_ns == 400000 && st.duty_ns == 0 && st.duty_percent == 0);
+    CHECK(st.enabled == 1);
+    // open 3次 + 周期2×2 + 占空比3 + 使能2
+    CHECK(st.writes == 12);
+
+    // 已存在的通道不是本程序导出的，关闭时只关输出，不写 unexport
+    pwm_close(h);
+    CHECK(read_value(0, "pwm0/enable") == 0);
+    CHECK(read_value(0, "unexport") == -1);
+    CHECK(pwm_get_status(h, &st) < 0);
+    CHECK(pwm_set_percent(h, 10) < 0);
+    CHECK(pwm_enable(h, 1) < 0);
+}
+
+static void test_export(void)
+{
+    int h;
+
+    // 通道目录不存在：写 export，等待超时后打开属性文件失败
+    make_chip(1);
+    h = pwm_open(1, 2);
+    CHECK(h < 0);
+    CHECK(read_value(1, "export") == 2);
+
+    // 失败的 open 不占用槽位；槽位用完后新通道打开失败，关闭后可以再用
+    make_chip(2);
+    make_channel(2, 0);
+    make_channel(2, 1);
+    make_channel(2, 2);
+    make_channel(2, 3);
+    CHECK(pwm_open(2, 0) >= 0);
+    CHECK(pwm_open(2, 1) >= 0);
+    CHECK(pwm_open(2, 2) >= 0);
+    CHECK(pwm_open(2, 3) >= 0);
+    make_channel(2, 4);
+    CHECK(pwm_open(2, 4) < 0);
+    pwm_close_all();
+    CHECK(read_value(2, "pwm3/enable") == 0);
+    CHECK(pwm_open(2, 4) >= 0);
+    pwm_close_all();
+}
+
+static void test_profile_parse(void)
+{
+    pwm_profile_t p;
+
+    CHECK(pwm_profile_parse("RAMP:80:300,HOLD:1000,RAMP:0:300", &p) == 3);
+    CHECK(p.seg[0].type == PWM_SEG_RAMP && p.seg[0].duty == 80 && p.seg[0].ms == 300);
+    CHECK(p.seg[1].type == PWM_SEG_HOLD && p.seg[1].ms == 1000);
+    CHECK(pwm_profile_duration_ms(&p) == 1600);
+
+    CHECK(pwm_profile_parse("set:40,burst:60:50:25:4", &p) == 2);
+    CHECK(p.seg[0].type == PWM_SEG_RAMP && p.seg[0].duty == 40 && p.seg[0].ms == 0);
+    CHECK(p.seg[1].type == PWM_SEG_BURST && p.seg[1].count == 4 && p.seg[1].off_ms == 25);
+    CHECK(pwm_profile_duration_ms(&p) == 300);
+
+    pwm_profile_ramp(&p, 120, 200);
+    CHECK(p.count == 1 && p.seg[0].duty == 100 && p.seg[0].ms == 200);
+
+    CHECK(pwm_profile_parse("RAMP:101:10", &p) < 0);
+    CHECK(pwm_profile_parse("RAMP:-1:10", &p) < 0);
+    CHECK(pwm_profile_parse("RAMP:50", &p) < 0);
+    CHECK(pwm_profile_parse("HOLD", &p) < 0);
+    CHECK(pwm_profile_parse("BURST:50:0:0:3", &p) < 0);
+    CHECK(pwm_profile_parse("BURST:50:10:10:0", &p) < 0);
+    CHECK(pwm_profile_parse("FADE:50:10", &p) < 0);
+    CHECK(pwm_profile_parse("", &p) < 0);
+    CHECK(pwm_profile_parse("SET:1,SET:2,SET:3,SET:4,SET:5,SET:6,SET:7,SET:8", &p) == 8);
+    CHECK(pwm_profile_parse("SET:1,SET:2,SET:3,SET:4,SET:5,SET:6,SET:7,SET:8,SET:9", &p) < 0);
+}
+
+#define MS(x) ((uint64_t)(x) * 1000000ull)
+
+static void test_profile_run(void)
+{
+    pwm_profile_stats_t stats;
+    pwm_profile_t p;
+    uint64_t t0, done_ns;
+    uint32_t seq, seq2;
+    int h;
+
+    make_chip(3);
+    make_channel(3, 0);
+    h = pwm_open(3, 0);
+    CHECK(h >= 0);
+    CHECK(pwm_profile_parse("SET:20,RAMP:80:300,HOLD:100,BURST:60:50:50:2", &p) == 4);
+
+    // 引擎以 pwm_profile_start() 内的时刻为起点，t0 只比它晚几微秒
+    seq = pwm_profile_start(h, &p);
+    t0 = monotonic_ns();
+    CHECK(seq > 0);
+    CHECK(!pwm_profile_done(h, seq, NULL));
+
+    CHECK(pwm_profile_poll(t0) > t0);
+    CHECK(read_value(3, "pwm0/duty_cycle") == PWM_DEFAULT_PERIOD_NS / 100 * 20);
+    // 斜坡中点，下一次更新在一个 tick 之内
+    CHECK(pwm_profile_poll(t0 + MS(150)) <= t0 + MS(150) + PWM_PROFILE_TICK_NS);
+    CHECK_NEAR(read_value(3, "pwm0/duty_cycle") / (PWM_DEFAULT_PERIOD_NS / 100), 50, 1);
+    // 保持段只在段结束时再更新
+    CHECK_NEAR((double)pwm_profile_poll(t0 + MS(350)), (double)(t0 + MS(400)), MS(1));
+    CHECK(read_value(3, "pwm0/duty_cycle") == PWM_DEFAULT_PERIOD_NS / 100 * 80);
+    // 脉冲串：50ms 高、50ms 低，共两个
+    CHECK_NEAR((double)pwm_profile_poll(t0 + MS(420)), (double)(t0 + MS(450)), MS(1));
+    CHECK(read_value(3, "pwm0/duty_cycle") == PWM_DEFAULT_PERIOD_NS / 100 * 60);
+    pwm_profile_poll(t0 + MS(470));
+    CHECK(read_value(3, "pwm0/duty_cycle") == 0);
+    pwm_profile_poll(t0 + MS(520));
+    CHECK(read_value(3, "pwm0/duty_cycle") == PWM_DEFAULT_PERIOD_NS / 100 * 60);
+    CHECK(!pwm_profile_done(h, seq, NULL));
+
+    // 结束：占空比为最后一段的结束值，记录结束时间
+    CHECK(pwm_profile_poll(t0 + MS(610)) == 0);
+    CHECK(read_value(3, "pwm0/duty_cycle") == 0);
+    CHECK(pwm_profile_done(h, seq, &done_ns));
+    CHECK(done_ns == t0 + MS(610));
+    CHECK(pwm_profile_get_stats(h, &stats) == 0);
+    CHECK(stats.started == 1 && stats.completed == 1 && stats.aborted == 0);
+    CHECK(stats.active == 0 && stats.duty == 0);
+    // 20、50、80、60、0、60、0
+    CHECK(stats.updates == 7);
+
+    // 新曲线替换正在执行的曲线，旧曲线视为结束
+    pwm_profile_ramp(&p, 100, 1000);
+    seq = pwm_profile_start(h, &p);
+    seq2 = pwm_profile_start(h, &p);
+    CHECK(seq2 == seq + 1);
+    CHECK(pwm_profile_done(h, seq, NULL));
+    CHECK(!pwm_profile_done(h, seq2, NULL));
+    pwm_profile_stop(h);
+    CHECK(pwm_profile_done(h, seq2, NULL));
+    CHECK(pwm_profile_poll(monotonic_ns()) == 0);
+    CHECK(pwm_profile_get_stats(h, &stats) == 0);
+    CHECK(stats.started == 3 && stats.completed == 1 && stats.aborted == 2);
+
+    CHECK(pwm_profile_start(PWM_MAX_CHANNELS, &p) == 0);
+    pwm_close(h);
+    CHECK(pwm_profile_start(h, &p) == 0);
+}
+
+int main(void)
+{
+    char cmd[96];
+    int ret;
+
+    snprintf(root, sizeof(root), "/tmp/pwm_test.XXXXXX");
+    if (mkdtemp(root) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    pwm_set_root(root);
+    CHECK(strcmp(pwm_get_root(), root) == 0);
+
+    test_open_and_write();
+    test_export();
+    test_profile_parse();
+    test_profile_run();
+
+    // 恢复默认，环境变量次之
+    pwm_set_root(NULL);
+    setenv("PWM_SYSFS_ROOT", root, 1);
+    CHECK(strcmp(pwm_get_root(), root) == 0);
+    unsetenv("PWM_SYSFS_ROOT");
+    CHECK(strcmp(pwm_get_root(), PWM_SYSFS_ROOT) == 0);
+    ret = TEST_RESULT();
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+    if (system(cmd) != 0)
+        printf("cannot remove %s\n", root);
+    return ret;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "motor.h"
+#include "recipe.h"
+#include "step_sched.h"
+#include "task.h"
+#include "test.h"
+
+/*
+ * 配方解析与依赖关系测试：内置配方与 recipe.txt 一致，
+ * 探头（A轴）的运动不会与前面仍在运行的泵步骤并行；
+ * 在仿真GPIO上执行一次循环，检查不冲突的步骤同时开始、等待和到位后的统计。
+ */
+
+// deps 的传递闭包：closure[j] 为第 j 步开始前必须完成的全部步骤
+static void dep_closure(const recipe_t *r, uint64_t closure[RECIPE_MAX_STEPS])
+{
+    int i, j;
+
+    for (j = 0; j < r->count; j++)
+    {
+        closure[j] = r->step[j].deps;
+        for (i = 0; i < j; i++)
+        {
+            if (closure[j] & (1ull << i))
+                closure[j] |= closure[i];
+        }
+    }
+}
+
+static void check_probe_after_pump(const recipe_t *r)
+{
+    uint64_t closure[RECIPE_MAX_STEPS];
+    int i, j;
+
+    dep_closure(r, closure);
+    for (j = 0; j < r->count; j++)
+    {
+        if (!(r->step[j].mask & RECIPE_RES_AXIS(Motor_A)))
+            continue;
+        for (i = 0; i < j; i++)
+        {
+            if (r->step[i].res & RECIPE_RES_PUMP)
+            {
+                if (!(closure[j] & (1ull << i)))
+                    printf("step %d (%s) may run during pump step %d\n", j + 1, r->step[j].label, i + 1);
+                CHECK(closure[j] & (1ull << i));
+            }
+        }
+    }
+}
+
+static void test_files(void)
+{
+    const recipe_t *file, *builtin;
+    int i;
+
+    // 不存在的文件退回内置配方（0号），再单独加载 recipe.txt
+    CHECK(recipe_init("/nonexistent/recipe.txt") > 0);
+    builtin = recipe_get(0);
+    CHECK(recipe_load(RECIPE_DEFAULT_FILE) == 1);
+    file = recipe_get(1);
+    CHECK(builtin != NULL && file != NULL);
+    if (builtin == NULL || file == NULL)
+        return;
+
+    CHECK(builtin->count == file->count);
+    for (i = 0; i < builtin->count && i < file->count; i++)
+        CHECK(memcmp(&builtin->step[i], &file->step[i], sizeof(builtin->step[i])) == 0);
+    check_probe_after_pump(file);
+}
+
+static void test_deps(void)
+{
+    recipe_t r;
+
+    CHECK(recipe_parse(&r, "A=5 PUMP=ON\nPUMP=OFF WAIT=2000\nA=10 # wash\n", "deps") == 3);
+    // 第3步只与第1步共享 A，可以在泵的等待期间开始
+    CHECK(r.step[2].deps == 1);
+
+    CHECK(recipe_parse(&r, "A=5 PUMP=ON\nPUMP=OFF WAIT=2000\nA=10 HOLD=PUMP\n", "hold") == 3);
+    CHECK(r.step[2].deps == 3);
+    check_probe_after_pump(&r);
+
+    CHECK(recipe_parse(&r, "B=1\nSYNC\nC=2\n", "sync") == 3);
+    CHECK(r.step[1].deps == 1 && r.step[2].deps == 2);
+    CHECK(strcmp(r.step[1].label, "SYNC") == 0);
+
+    CHECK(recipe_parse(&r, "WAIT=100\n", "wait") == 1 && r.step[0].res == RECIPE_RES_ALL);
+}
+
+static void test_errors(void)
+{
+    recipe_t r;
+
+    CHECK(recipe_parse(&r, "A=1 X=2\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "D=1 PUMP=ON\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "PWM=50 PROFILE=HOLD:100\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "PWM=101\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "A=-1\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "HOLD=A,E\n", "bad") < 0);
+    CHECK(recipe_parse(&r, "# only comments\n\n", "empty") == 0);
+}
+
+// 仿真GPIO上执行一次循环，按 process_task 的方式在到位通知或等待到期时推进
+static void test_run(void)
+{
+    static recipe_run_t run;
+    recipe_stats_t st;
+    motor_state_t ms;
+    pthread_t sched;
+    recipe_t r;
+    uint64_t end;
+    int i, active = 1;
+
+    CHECK(recipe_parse(&r, "A=0.2 C=0.5 # 探头和转盘\nB=0.3\nWAIT=50\nA=0\n", "run") == 4);
+    motor_gpio_use_sim();
+    CHECK(motor_io_init() == 0);
+    CHECK(pthread_create(&sched, NULL, step_sched_task, NULL) == 0);
+    for (i = Motor_A; i <= Motor_C; i++)
+        Set_Motor_Limits(i, 4, 8, 0);
+
+    recipe_run_start(&run, &r, "test", monotonic_ns());
+    end = monotonic_ns() + 10000000000ull;
+    while (active && monotonic_ns() < end)
+    {
+        active = recipe_run_poll(&run, 0, monotonic_ns());
+        if (active)
+            Motor_Done_Wait(5000000ull);
+    }
+    CHECK(!active);
+    recipe_get_stats(&st);
+    CHECK(st.cycles == 1 && st.steps == 4);
+
+    // 第2步（B轴）与第1步资源不冲突，同时开始
+    CHECK(st.step_start[1] < 0.005);
+    // 只有 WAIT 的步骤等前面全部完成，至少等待 50ms
+    CHECK(st.step_start[2] >= st.step_start[0] + st.step_time[0] - 0.001);
+    CHECK(st.step_start[2] >= st.step_start[1] + st.step_time[1] - 0.001);
+    CHECK(st.step_time[2] >= 0.050);
+    CHECK(st.step_start[3] >= st.step_start[2] + st.step_time[2] - 0.001);
+    // 并行执行比按顺序执行快
+    CHECK(st.cycle_time < st.serial_time);
+    CHECK(st.dead_max < 0.02);
+
+    Motor_Get_State(&motor_data_A, &ms);
+    CHECK(ms.Current_Step == Motor_Circle_To_Step(&motor_data_A, 0));
+    Motor_Get_State(&motor_data_B, &ms);
+    CHECK(ms.Current_Step == Motor_Circle_To_Step(&motor_data_B, 0.3f));
+    Motor_Get_State(&motor_data_C, &ms);
+    CHECK(ms.Current_Step == Motor_Circle_To_Step(&motor_data_C, 0.5f));
+
+    running = 0;
+    step_sched_kick();
+    pthread_join(sched, NULL);
+    motor_cleanup();
+}
+
+int main(void)
+{
+    test_files();
+    test_deps();
+    test_errors();
+    test_run();
+    return TEST_RESULT();
+}
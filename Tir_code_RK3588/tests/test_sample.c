@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "motor.h"
+#include "recipe.h"
+#include "sample.h"
+#include "step_sched.h"
+#include "task.h"
+#include "test.h"
+
+/*
+ * 多样品调度测试：在仿真GPIO上按 process_task 的方式推进两个常规样品，
+ * 第一个样品运动中装入一个 STAT 样品。每次推进后检查发布的执行状态：
+ * 任意两个样品不同时占用同一资源，常规样品只在 SYNC 前停下，
+ * STAT 开始之后、完成之前常规样品不再开始新步骤；最后核对周转时间和吞吐量统计。
+ */
+
+// 第2个样品的 A 轴步骤要等第1个样品的第3步完成，之后与第1个样品的第4步同时运动
+#define ROUTINE_RECIPE "A=0.3\nSYNC\nA=0 C=0.3\nC=0\n"
+#define STAT_RECIPE "B=0.3\nB=0\n"
+
+static void write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+
+    if (f == NULL)
+    {
+        perror(path);
+        return;
+    }
+    fputs(text, f);
+    fclose(f);
+}
+
+static const sample_status_t *find(const sample_stats_t *st, uint32_t id)
+{
+    int k;
+
+    for (k = 0; k < st->running; k++)
+    {
+        if (st->run[k].id == id)
+            return &st->run[k];
+    }
+    return NULL;
+}
+
+static void test_preempt(const char *routine_path, const char *stat_path)
+{
+    const sample_status_t *s1, *stat;
+    sample_stats_t st;
+    uint64_t now, deadline, end, stat_start = 0, resume_ns = 0;
+    int s1_id, s2_id, stat_id = -1, active = 1;
+    int j, k, routine, overlap = 0, shared = 0, too_many = 0, moved_during_stat = 0;
+    int stopped_at_sync = 0, s1_started = -1;
+
+    s1_id = sample_enqueue(SAMPLE_ROUTINE, routine_path);
+    s2_id = sample_enqueue(SAMPLE_ROUTINE, routine_path);
+    CHECK(s1_id > 0 && s2_id == s1_id + 1);
+
+    end = monotonic_ns() + 20000000000ull;
+    while (active && monotonic_ns() < end)
+    {
+        active = sample_poll(monotonic_ns());
+        sample_get_stats(&st);
+
+        // 资源互斥；同时执行的常规样品数不超过上限
+        for (j = routine = 0; j < st.running; j++)
+        {
+            routine += !st.run[j].stat;
+            for (k = j + 1; k < st.running; k++)
+            {
+                shared |= (st.run[j].in_use & st.run[k].in_use) != 0;
+                overlap |= !st.run[j].stat && !st.run[k].stat && st.run[j].in_use && st.run[k].in_use;
+            }
+        }
+        too_many |= routine > SAMPLE_MAX_INFLIGHT;
+
+        s1 = find(&st, s1_id);
+        // 第1个样品走第1步时装入 STAT
+        if (stat_id < 0 && s1 && s1->steps_started == 1 && s1->in_use)
+        {
+            stat_id = sample_enqueue(SAMPLE_STAT, stat_path);
+            CHECK(stat_id == s2_id + 1);
+        }
+        stat = stat_id > 0 ? find(&st, stat_id) : NULL;
+        if (stat && stat_start == 0)
+        {
+            // STAT 开始时常规样品都已停稳，第1个样品正好停在 SYNC 前
+            stat_start = stat->start_ns;
+            CHECK(st.run[0].id == (uint32_t)stat_id);
+            CHECK(s1 && s1->paused && s1->in_use == 0 && s1->steps_done == 1 && s1->steps_started == 1);
+            stopped_at_sync = 1;
+            s1_started = s1 ? s1->steps_started : -1;
+        }
+        if (stat && s1)
+            moved_during_stat |= s1->steps_started != s1_started || !s1->paused;
+        if (!stat && stat_start && s1 && resume_ns == 0 && s1->steps_started > s1_started)
+            resume_ns = monotonic_ns();
+
+        deadline = sample_next_deadline();
+        now = monotonic_ns();
+        if (deadline == 0 || deadline > now + 5000000ull)
+            deadline = now + 5000000ull;
+        if (active && deadline > now)
+            Motor_Done_Wait(deadline - now);
+    }
+    CHECK(!active);
+    CHECK(!shared && !too_many);
+    // 两个常规样品交错执行：第1个样品的 C 轴和第2个样品的 A 轴同时运动
+    CHECK(overlap);
+    CHECK(stopped_at_sync && !moved_during_stat);
+    CHECK(stat_start > 0 && resume_ns > stat_start);
+
+    sample_get_stats(&st);
+    sample_print_stats();
+    CHECK(st.loaded == 3 && st.running == 0);
+    CHECK(st.completed[SAMPLE_ROUTINE] == 2 && st.completed[SAMPLE_STAT] == 1);
+    CHECK(st.preemptions == 1);
+    // STAT 比后装入的第2个常规样品周转更快；它只等第1个样品走完第1步
+    CHECK(st.turnaround_max[SAMPLE_STAT] < st.turnaround_max[SAMPLE_ROUTINE]);
+    CHECK(st.wait_sum[SAMPLE_STAT] < st.turnaround_max[SAMPLE_STAT]);
+    CHECK(st.batch_count == 3);
+    CHECK(st.batch_time >= st.turnaround_max[SAMPLE_ROUTINE] - 0.01);
+    CHECK(st.batch_time <= st.turnaround_max[SAMPLE_ROUTINE] + 0.01);
+    CHECK(st.last_id == (uint32_t)s2_id);
+}
+
+int main(void)
+{
+    char dir[64], routine_path[96], stat_path[96], cmd[96];
+    pthread_t sched;
+    int i;
+
+    snprintf(dir, sizeof(dir), "/tmp/sample_test.XXXXXX");
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(routine_path, sizeof(routine_path), "%s/routine.txt", dir);
+    snprintf(stat_path, sizeof(stat_path), "%s/stat.txt", dir);
+    write_file(routine_path, ROUTINE_RECIPE);
+    write_file(stat_path, STAT_RECIPE);
+
+    motor_gpio_use_sim();
+    CHECK(motor_io_init() == 0);
+    CHECK(pthread_create(&sched, NULL, step_sched_task, NULL) == 0);
+    for (i = Motor_A; i <= Motor_C; i++)
+        Set_Motor_Limits(i, 4, 8, 0);
+
+    CHECK(sample_enqueue(SAMPLE_ROUTINE, "/nonexistent/recipe.txt") == -1);
+    test_preempt(routine_path, stat_path);
+
+    running = 0;
+    step_sched_kick();
+    pthread_join(sched, NULL);
+    motor_cleanup();
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0)
+        printf("failed to remove %s\n", dir);
+    return TEST_RESULT();
+}
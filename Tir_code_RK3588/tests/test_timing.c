@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "motor.h"
+#include "test.h"
+
+/*
+ * 边沿时序统计测试：延迟按 <1,<5,<10,<20,<50,<100,<500,>=500us 分桶，
+ * 提前的边沿按0计，最大延迟饱和在 UINT32_MAX，发布后读到的统计与写入的一致。
+ */
+
+static void test_record(void)
+{
+    static const struct
+    {
+        int64_t late_ns;
+        int bucket;
+    } cases[] = {
+        {-2000, 0}, {0, 0}, {999, 0}, {1000, 1}, {4999, 1}, {5000, 2}, {9999, 2}, {10000, 3},
+        {19999, 3}, {20000, 4}, {49999, 4}, {50000, 5}, {99999, 5}, {100000, 6}, {499999, 6}, {500000, 7},
+    };
+    motor_timing_t t;
+    uint64_t sum = 0;
+    uint32_t total;
+    unsigned i;
+    int b;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        memset(&t, 0, sizeof(t));
+        motor_timing_record(&t, cases[i].late_ns, 0);
+        CHECK(t.edges == 1 && t.hist[cases[i].bucket] == 1);
+        CHECK(t.late_sum_ns == (uint64_t)(cases[i].late_ns > 0 ? cases[i].late_ns : 0));
+    }
+
+    memset(&t, 0, sizeof(t));
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        motor_timing_record(&t, cases[i].late_ns, cases[i].bucket == 7);
+        sum += cases[i].late_ns > 0 ? cases[i].late_ns : 0;
+    }
+    motor_timing_record(&t, 5000000000ll, 1);
+    sum += 5000000000ull;
+    for (b = 0, total = 0; b < JITTER_BUCKETS; b++)
+        total += t.hist[b];
+    CHECK(t.edges == sizeof(cases) / sizeof(cases[0]) + 1 && total == t.edges);
+    CHECK(t.late_sum_ns == sum);
+    CHECK(t.late_max_ns == UINT32_MAX);
+    CHECK(t.missed == 2 && t.hist[7] == 2);
+}
+
+static void test_publish(void)
+{
+    static motor m;
+    motor_timing_t t, got;
+
+    memset(&t, 0, sizeof(t));
+    motor_timing_record(&t, 1500, 0);
+    motor_timing_record(&t, 700000, 1);
+    Motor_Publish_Timing(&m, &t);
+    Motor_Get_Timing(&m, &got);
+    CHECK(memcmp(&t, &got, sizeof(t)) == 0);
+}
+
+int main(void)
+{
+    test_record();
+    test_publish();
+    return TEST_RESULT();
+}
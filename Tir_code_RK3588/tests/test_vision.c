@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motor.h"
+#include "vision.h"
+#include "test.h"
+
+/*
+ * 视觉 JSON 行解析测试：tests/data/vision_capture.jsonl 是按 视觉代码.py 的输出格式
+ * （MicroPython json.dumps + "\n"）生成的串口数据，含丢失行尾、两行粘连和上电噪声，
+ * vision_capture.expected 是用 Python json 模块逐行解析得到的期望结果。
+ * 整段、逐字节和随机分段送入，结果都必须与期望逐行一致。
+ */
+
+#define CAPTURE_FILE "tests/data/vision_capture.jsonl"
+#define EXPECTED_FILE "tests/data/vision_capture.expected"
+#define CAPTURE_LINES 477 // 非空行
+#define CAPTURE_ERRORS 9  // 4行丢失行尾、4处两行粘连、1行噪声
+
+typedef struct
+{
+    char *text; // 格式化后的结果，每行一个
+    int len;
+    int size;
+    int count;
+} results_t;
+
+static void collect(const vision_result_t *r, void *ctx)
+{
+    results_t *out = ctx;
+
+    if (out->len + 128 > out->size)
+    {
+        out->size = out->size * 2 + 4096;
+        out->text = realloc(out->text, out->size);
+    }
+    out->len += sprintf(out->text + out->len, "%s %s %d %d %d %d %d\n",
+                        r->label, r->color, r->x, r->y, r->area, r->has_blob, r->no_blob);
+    out->count++;
+}
+
+static char *load(const char *path, int *len)
+{
+    FILE *f = fopen(path, "rb");
+    char *buf;
+    long n;
+
+    if (f == NULL)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    rewind(f);
+    buf = malloc(n + 1);
+    if (fread(buf, 1, n, f) != (size_t)n)
+        n = 0;
+    buf[n] = '\0';
+    fclose(f);
+    *len = n;
+    return buf;
+}
+
+static uint32_t rng_state = 777;
+
+static uint32_t rnd(uint32_t n)
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 8) % n;
+}
+
+static void test_capture(void)
+{
+    static const int max_chunk[] = {0, 1, 16, 300};
+    results_t out = {0};
+    vision_parser_t p;
+    char *capture, *expected;
+    int capture_len, expected_len, off, n;
+    unsigned k;
+
+    capture = load(CAPTURE_FILE, &capture_len);
+    expected = load(EXPECTED_FILE, &expected_len);
+    CHECK(capture != NULL && expected != NULL);
+    if (capture == NULL || expected == NULL)
+        return;
+
+    // 0 表示整段送入
+    for (k = 0; k < sizeof(max_chunk) / sizeof(max_chunk[0]); k++)
+    {
+        out.len = out.count = 0;
+        vision_parser_init(&p, collect, &out);
+        for (off = 0; off < capture_len; off += n)
+        {
+            n = max_chunk[k] ? 1 + (int)rnd(max_chunk[k]) : capture_len;
+            if (n > capture_len - off)
+                n = capture_len - off;
+            vision_parser_feed(&p, (const uint8_t *)capture + off, n);
+        }
+        CHECK(out.len == expected_len && memcmp(out.text, expected, expected_len) == 0);
+        CHECK(p.stats.bytes == (uint64_t)capture_len);
+        CHECK(p.stats.lines == CAPTURE_LINES);
+        CHECK(p.stats.results == (uint64_t)out.count);
+        CHECK(p.stats.errors == CAPTURE_ERRORS);
+        CHECK(p.stats.truncated == 0);
+    }
+    free(out.text);
+    free(capture);
+    free(expected);
+}
+
+static vision_result_t last;
+
+static void keep_last(const vision_result_t *r, void *ctx __attribute__((unused)))
+{
+    last = *r;
+}
+
+static int parse_last(const char *line)
+{
+    vision_parser_t p;
+
+    memset(&last, 0, sizeof(last));
+    vision_parser_init(&p, keep_last, NULL);
+    vision_parser_feed(&p, (const uint8_t *)line, strlen(line));
+    return (int)p.stats.results;
+}
+
+static void test_lines(void)
+{
+    vision_result_t r, got;
+
+    CHECK(parse_last("{\"pH\": \"pH7\", \"color\": \"\\u7eff\", \"position\": [80, 60], \"area\": 1234}\n") == 1);
+    CHECK(strcmp(last.label, "pH7") == 0 && last.ph == 7.0f);
+    CHECK(strcmp(last.color, "绿") == 0);
+    CHECK(last.has_blob && last.x == 80 && last.y == 60 && last.area == 1234 && !last.no_blob);
+
+    // 数值形式的 pH、未知键、\r 结尾
+    CHECK(parse_last("{\"fps\": 29.5, \"pH\": 6.5, \"ok\": true, \"extra\": null}\r") == 1);
+    CHECK(strcmp(last.label, "pH6.5") == 0 && last.ph == 6.5f && !last.has_blob);
+
+    // 缺少 pH、嵌套对象、position 元素个数不对
+    CHECK(parse_last("{\"color\": \"红\"}\n") == 0);
+    CHECK(parse_last("{\"pH\": \"pH1\", \"x\": {\"a\": 1}}\n") == 0);
+    CHECK(parse_last("{\"pH\": \"pH1\", \"position\": [1]}\n") == 1 && !last.has_blob);
+
+    // 过长的颜色名截断在 UTF-8 字符边界
+    CHECK(parse_last("{\"pH\": \"pH2\", \"color\": \"深红深红深红深红\"}\n") == 1);
+    CHECK(strlen(last.color) == 15 && strcmp(last.color, "深红深红深") == 0);
+
+    // 只有 pH 的对象；没有行结束符时不发出；整数形式的 pH
+    CHECK(parse_last("{\"pH\": \"pH3\"}\n") == 1 && last.ph == 3.0f);
+    CHECK(parse_last("{\"pH\": \"pH4\", \"area\": 17}") == 0);
+    CHECK(parse_last("{\"pH\": 8}\n") == 1 && last.ph == 8.0f);
+
+    // 发布：seq 递增，带时间戳
+    memset(&r, 0, sizeof(r));
+    strcpy(r.label, "pH9");
+    vision_publish(&r);
+    CHECK(vision_get_latest(&got) == 1);
+    CHECK(got.seq == r.seq && got.seq >= 1 && strcmp(got.label, "pH9") == 0);
+    CHECK(got.stamp_ns > 0 && got.stamp_ns <= monotonic_ns());
+    vision_publish(&r);
+    CHECK(vision_get_latest(&got) == 1 && got.seq == r.seq);
+}
+
+int main(void)
+{
+    test_capture();
+    test_lines();
+    return TEST_RESULT();
+}
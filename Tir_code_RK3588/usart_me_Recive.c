@@ -1,97 +1,188 @@
-#include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
-#include "motor.h"
 #include "usart_me_Recive.h"
 
-extern float Target_Circle_A;
-extern float Target_Circle_B;
-extern float Target_Circle_C;
-extern float Target_Circle_D;
-extern motor motor_data_A, motor_data_B, motor_data_C, motor_data_D;
+/*
+ * 串口文本命令解析
+ * 逐字节状态机，直接消费串口接收环形缓冲区中的字节：不拷贝整行、不用 strtok/strlen，
+ * 读操作在任意位置拆开命令都没有影响。每识别出一条命令就通过回调发出，
+ * 格式错误的命令跳到下一个分隔符，不影响同一行的其他命令。
+ */
 
-// 解析函数
-void Parse_Motor_Targets(const char *rx)
+enum
 {
-    int i = 0;
-    float val = 0;
-    char id = 0;
-    int len = strlen(rx);
-
-    // 只输入了"$"，全部置1并返回
-    if (len == 1 && rx[0] == '$') {
-        motor_data_A.Process_Flag = 1; motor_data_A.State = 0;
-        motor_data_B.Process_Flag = 1; motor_data_B.State = 0;
-        motor_data_C.Process_Flag = 1; motor_data_C.State = 0;
-        motor_data_D.Process_Flag = 1; motor_data_D.State = 0;
-        printf("All Process_Flag set to 1 by $ command\n");
+    ST_START = 0, // 命令开头
+    ST_DOLLAR,    // 读到 $
+    ST_AXIS,      // 读到轴名，等待 ':'
+    ST_INT,       // 整数部分
+    ST_FRAC,      // 小数部分
+    ST_SKIP,      // 格式错误，跳到下一个分隔符
+};
+
+static const double pow10_table[USART_MAX_DIGITS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+void usart_parser_init(usart_parser_t *p, usart_cmd_cb_t emit, void *ctx)
+{
+    memset(p, 0, sizeof(*p));
+    p->emit = emit;
+    p->ctx = ctx;
+}
+
+// 计数饱和在255，一行超过255条命令时仍然发出 LINE_END
+static void line_item(usart_parser_t *p)
+{
+    if (p->line_items < 255)
+        p->line_items++;
+}
+
+static void emit_cmd(usart_parser_t *p, uint8_t type)
+{
+    usart_cmd_t cmd = {.type = type, .axis = p->axis, .enable = p->enable};
+
+    if (type == USART_CMD_TARGET)
+        cmd.target = (float)(p->mantissa / pow10_table[p->frac]);
+    line_item(p);
+    p->stats.commands++;
+    p->emit(&cmd, p->ctx);
+}
+
+static void line_end(usart_parser_t *p)
+{
+    usart_cmd_t cmd = {.type = USART_CMD_LINE_END};
+
+    if (p->line_items > 0)
+    {
+        cmd.errors = p->line_errors;
+        p->stats.lines++;
+        p->emit(&cmd, p->ctx);
+    }
+    p->line_items = 0;
+    p->line_errors = 0;
+    p->state = ST_START;
+}
+
+static void token_error(usart_parser_t *p)
+{
+    line_item(p);
+    if (p->line_errors < 255)
+        p->line_errors++;
+    p->stats.errors++;
+    p->state = ST_SKIP;
+}
+
+// 一条命令的数值结束：至少要有一位数字
+static void value_end(usart_parser_t *p)
+{
+    if (p->has_digit)
+        emit_cmd(p, USART_CMD_TARGET);
+    else
+        token_error(p);
+}
+
+static void value_digit(usart_parser_t *p, uint8_t c, int frac)
+{
+    p->has_digit = 1;
+    // 整数部分的前导0不占有效位
+    if (!frac && p->mantissa == 0 && c == '0')
+        return;
+    if (p->digits >= USART_MAX_DIGITS)
+    {
+        token_error(p);
         return;
     }
-    while (i < len)
+    p->mantissa = p->mantissa * 10 + (c - '0');
+    p->digits++;
+    if (frac)
+        p->frac++;
+}
+
+/*
+ * @description : 送入一个字节
+ */
+void usart_parser_byte(usart_parser_t *p, uint8_t c)
+{
+    p->stats.bytes++;
+
+    // 分隔符结束当前命令，行结束符同时结束一行
+    if (c == ',' || c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ';')
     {
-        int has_dollar = 0;
-        if (rx[i] == '$') {
-            has_dollar = 1;
-            i++;
+        switch (p->state)
+        {
+        case ST_DOLLAR:
+            emit_cmd(p, USART_CMD_BEGIN_ALL);
+            break;
+        case ST_AXIS:
+            token_error(p);
+            break;
+        case ST_INT:
+        case ST_FRAC:
+            value_end(p);
+            break;
+        default:
+            break;
         }
+        p->state = ST_START;
+        if (c == '\n' || c == '\r' || c == ';')
+            line_end(p);
+        return;
+    }
 
-        if ((rx[i] == 'A' || rx[i] == 'B' || rx[i] == 'C' || rx[i] == 'D') && rx[i + 1] == ':')
+    switch (p->state)
+    {
+    case ST_START:
+        p->enable = 0;
+        if (c == '$')
+        {
+            p->enable = 1;
+            p->state = ST_DOLLAR;
+            break;
+        }
+        // 没有 $ 时直接按轴名处理
+        // fall through
+    case ST_DOLLAR:
+        if (c >= 'A' && c <= 'D')
         {
-            id = rx[i];
-            i += 2;
-            val = 0;
-            float frac = 0.1f;
-            int point = 0;
-            while ((rx[i] >= '0' && rx[i] <= '9') || rx[i] == '.')
-            {
-                if (rx[i] == '.')
-                    point = 1;
-                else if (!point)
-                    val = val * 10 + (rx[i] - '0');
-                else
-                {
-                    val = val + (rx[i] - '0') * frac;
-                    frac *= 0.1f;
-                }
-                i++;
-            }
-            if (id == 'A') {
-                Target_Circle_A = val;
-                if (has_dollar) { motor_data_A.Process_Flag = 1; motor_data_A.State = 0; }
-            } else if (id == 'B') {
-                Target_Circle_B = val;
-                if (has_dollar) { motor_data_B.Process_Flag = 1; motor_data_B.State = 0; }
-            } else if (id == 'C') {
-                Target_Circle_C = val;
-                if (has_dollar) { motor_data_C.Process_Flag = 1; motor_data_C.State = 0; }
-            } else if (id == 'D') {
-                Target_Circle_D = val;
-                if (has_dollar) { motor_data_D.Process_Flag = 1; motor_data_D.State = 0; }
-            }
+            p->axis = c - 'A';
+            p->state = ST_AXIS;
         }
         else
         {
-            i++;
+            token_error(p);
         }
+        break;
+    case ST_AXIS:
+        if (c == ':')
+        {
+            p->mantissa = 0;
+            p->digits = 0;
+            p->frac = 0;
+            p->has_digit = 0;
+            p->state = ST_INT;
+        }
+        else
+        {
+            token_error(p);
+        }
+        break;
+    case ST_INT:
+    case ST_FRAC:
+        if (c >= '0' && c <= '9')
+            value_digit(p, c, p->state == ST_FRAC);
+        else if (c == '.' && p->state == ST_INT)
+            p->state = ST_FRAC;
+        else
+            token_error(p);
+        break;
+    default: // ST_SKIP
+        break;
     }
 }
 
-void Process_Usart_Lines(char *buf)
+void usart_parser_feed(usart_parser_t *p, const uint8_t *data, int len)
 {
-    char *line = strtok(buf, "\r\n");
-    while (line != NULL)
-    {
-        if (strlen(line) > 0)
-        {
-            printf("Received: %s\n", line);
-            Parse_Motor_Targets(line);
-            printf("  Target_Circle_A = %.2f, Target_Circle_B = %.2f, Target_Circle_C = %.2f, Target_Circle_D = %.2f\n",
-                   Target_Circle_A, Target_Circle_B, Target_Circle_C, Target_Circle_D);
-            printf(" Current_Circle_A = %.2f, Current_Circle_B = %.2f, Current_Circle_C = %.2f, Current_Circle_D = %.2f\n",
-                   motor_data_A.Current_Circle, motor_data_B.Current_Circle, motor_data_C.Current_Circle, motor_data_D.Current_Circle);
-            printf("    Process_Flag_A = %d, Process_Flag_B = %d, Process_Flag_C = %d, Process_Flag_D = %d\n",
-                   motor_data_A.Process_Flag, motor_data_B.Process_Flag, motor_data_C.Process_Flag, motor_data_D.Process_Flag);
-        }
-        line = strtok(NULL, "\r\n");
-    }
-}
\ No newline at end of file
+    int i;
+
+    for (i = 0; i < len; i++)
+        usart_parser_byte(p, data[i]);
+}
@@ -3,7 +3,60 @@
 
 #include <stdint.h>
 
-void Parse_Motor_Targets(const char *rx);
-void Process_Usart_Lines(char *buf);
+/*
+ * 串口文本命令，与控制台相同：
+ *   A:10.5,$B:2    设置目标圈数，带 $ 的轴同时置运行标志
+ *   $              所有轴置运行标志
+ * 命令之间用逗号或空格分隔，\r、\n 或 ; 结束一行；
+ * 格式错误的命令被跳过，同一行的其他命令照常执行，LINE_END 报告错误数
+ */
+#define USART_MAX_DIGITS 9 // 数值最多有效位数（整数+小数），超出视为格式错误
 
-#endif
\ No newline at end of file
+typedef enum
+{
+    USART_CMD_TARGET = 0, // axis/target/enable 有效
+    USART_CMD_BEGIN_ALL,  // 单独的 $
+    USART_CMD_LINE_END,   // 一行结束，errors 为本行格式错误数
+} usart_cmd_type_t;
+
+typedef struct
+{
+    uint8_t type;    // usart_cmd_type_t
+    uint8_t axis;    // 0~3 对应 A~D
+    uint8_t enable;  // 1：带 $，置运行标志
+    uint8_t errors;
+    float target;
+} usart_cmd_t;
+
+typedef void (*usart_cmd_cb_t)(const usart_cmd_t *cmd, void *ctx);
+
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t commands; // 发出的 TARGET/BEGIN_ALL 命令
+    uint64_t lines;
+    uint64_t errors;
+} usart_parser_stats_t;
+
+// 解析器状态全部在结构体内，可以有多个实例，字节可以按任意分段送入
+typedef struct
+{
+    uint8_t state;
+    uint8_t enable;
+    uint8_t axis;
+    uint8_t digits;     // 已读有效位数
+    uint8_t frac;       // 小数位数
+    uint8_t has_digit;  // 数值中至少有一位数字
+    uint8_t line_items; // 本行已识别的命令数（含错误），饱和在255
+    uint8_t line_errors;
+    uint32_t mantissa;  // 数值去掉小数点后的整数
+    usart_cmd_cb_t emit;
+    void *ctx;
+    usart_parser_stats_t stats;
+} usart_parser_t;
+
+void usart_parser_init(usart_parser_t *p, usart_cmd_cb_t emit, void *ctx);
+void usart_parser_byte(usart_parser_t *p, uint8_t c);
+void usart_parser_feed(usart_parser_t *p, const uint8_t *data, int len);
+
+#endif
@@ -0,0 +1,513 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "motor.h"
+#include "seqlock.h"
+#include "vision.h"
+
+/*
+ * 视觉结果 JSON 行解析
+ * 逐字节状态机，与串口文本命令解析器相同的用法：不缓存整行、不分配内存，
+ * 只保留当前键和字符串值，读操作在任意位置拆开一行都没有影响。
+ * 每行是一个对象，行结束（\r 或 \n）时对象完整且带 pH 就发出一个结果；
+ * 格式错误的行跳到行结束，不影响下一行。
+ */
+
+enum
+{
+    ST_LINE = 0,    // 行首，等待 {
+    ST_KEY_OR_END,  // { 之后，等待键或 }
+    ST_KEY,         // , 之后，等待键
+    ST_STR,         // 字符串内
+    ST_ESC,         // 读到反斜杠
+    ST_HEX,         // \u 后的十六进制
+    ST_COLON,       // 键之后，等待 :
+    ST_VALUE,       // 等待值
+    ST_ARRAY_FIRST, // [ 之后，等待第一个元素或 ]
+    ST_INT,         // 数值整数部分
+    ST_FRAC,        // 数值小数部分
+    ST_LIT,         // true/false/null
+    ST_NEXT,        // 值之后，等待 , ] 或 }
+    ST_DONE,        // 对象结束，等待行结束
+    ST_SKIP,        // 格式错误，跳到行结束
+};
+
+enum
+{
+    KEY_OTHER = 0,
+    KEY_PH,
+    KEY_COLOR,
+    KEY_POSITION,
+    KEY_AREA,
+    KEY_STATUS,
+};
+
+static const char *const key_names[] = {
+    [KEY_PH] = "pH",
+    [KEY_COLOR] = "color",
+    [KEY_POSITION] = "position",
+    [KEY_AREA] = "area",
+    [KEY_STATUS] = "status",
+};
+
+static const double pow10_table[VISION_MAX_DIGITS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+// 最近的结果，只由 I/O 线程写
+static seqlock_t latest_lock = SEQLOCK_INIT;
+static vision_result_t latest;
+static uint32_t latest_seq = 0;
+
+void vision_parser_init(vision_parser_t *p, vision_result_cb_t emit, void *ctx)
+{
+    memset(p, 0, sizeof(*p));
+    p->emit = emit;
+    p->ctx = ctx;
+}
+
+static int is_space(uint8_t c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static void line_error(vision_parser_t *p)
+{
+    p->stats.errors++;
+    p->state = ST_SKIP;
+}
+
+static void line_end(vision_parser_t *p)
+{
+    if (p->state != ST_LINE)
+    {
+        p->stats.lines++;
+        if (p->state == ST_DONE && (p->cur.label[0] || p->cur.ph > 0))
+        {
+            p->stats.results++;
+            p->emit(&p->cur, p->ctx);
+        }
+        else if (p->state != ST_SKIP)
+        {
+            // 缺少 pH，或行在对象结束前被截断
+            p->stats.errors++;
+        }
+    }
+    p->state = ST_LINE;
+    p->in_array = 0;
+}
+
+static void string_begin(vision_parser_t *p, uint8_t ret_state)
+{
+    p->str_len = 0;
+    p->str_trunc = 0;
+    p->hi = 0;
+    p->ret_state = ret_state;
+    p->state = ST_STR;
+}
+
+// 追加 n 个字节，放不下时整体丢弃，不会截断在 UTF-8 字符中间
+static void string_put(vision_parser_t *p, const uint8_t *s, int n)
+{
+    if (p->str_len + n >= VISION_STR_MAX)
+    {
+        p->str_trunc = 1;
+        return;
+    }
+    memcpy(&p->str[p->str_len], s, n);
+    p->str_len += n;
+}
+
+static void string_put_codepoint(vision_parser_t *p, uint32_t cp)
+{
+    uint8_t u[4];
+    int n;
+
+    // 代理项对：高代理项暂存，等下一个 \uDCxx 组合
+    if (cp >= 0xD800 && cp < 0xDC00)
+    {
+        p->hi = cp;
+        return;
+    }
+    if (cp >= 0xDC00 && cp < 0xE000)
+    {
+        cp = p->hi ? 0x10000 + ((uint32_t)(p->hi - 0xD800) << 10) + (cp - 0xDC00) : 0xFFFD;
+        p->hi = 0;
+    }
+
+    if (cp < 0x80)
+    {
+        u[0] = cp;
+        n = 1;
+    }
+    else if (cp < 0x800)
+    {
+        u[0] = 0xC0 | (cp >> 6);
+        u[1] = 0x80 | (cp & 0x3F);
+        n = 2;
+    }
+    else if (cp < 0x10000)
+    {
+        u[0] = 0xE0 | (cp >> 12);
+        u[1] = 0x80 | ((cp >> 6) & 0x3F);
+        u[2] = 0x80 | (cp & 0x3F);
+        n = 3;
+    }
+    else
+    {
+        u[0] = 0xF0 | (cp >> 18);
+        u[1] = 0x80 | ((cp >> 12) & 0x3F);
+        u[2] = 0x80 | ((cp >> 6) & 0x3F);
+        u[3] = 0x80 | (cp & 0x3F);
+        n = 4;
+    }
+    string_put(p, u, n);
+}
+
+// 拷贝字符串值，截断时退回到 UTF-8 字符边界
+static void string_copy(const vision_parser_t *p, char *dst, int size)
+{
+    int n = p->str_len < size - 1 ? p->str_len : size - 1;
+
+    if (n < p->str_len)
+    {
+        while (n > 0 && ((uint8_t)p->str[n] & 0xC0) == 0x80)
+            n--;
+    }
+    memcpy(dst, p->str, n);
+    dst[n] = '\0';
+}
+
+// 一个值结束
+static void value_done(vision_parser_t *p)
+{
+    if (p->in_array)
+        p->index++;
+    p->state = ST_NEXT;
+}
+
+static void string_end(vision_parser_t *p)
+{
+    int k;
+
+    p->str[p->str_len] = '\0';
+    if (p->str_trunc)
+        p->stats.truncated++;
+
+    if (p->ret_state == ST_COLON)
+    {
+        p->key = KEY_OTHER;
+        for (k = KEY_PH; k <= KEY_STATUS && !p->str_trunc; k++)
+        {
+            if (strcmp(p->str, key_names[k]) == 0)
+                p->key = k;
+        }
+        p->state = ST_COLON;
+        return;
+    }
+
+    if (!p->in_array)
+    {
+        switch (p->key)
+        {
+        case KEY_PH:
+        {
+            char *end;
+            float ph;
+
+            string_copy(p, p->cur.label, sizeof(p->cur.label));
+            // "pH7" -> 7，其他格式只保留标签
+            if ((p->str[0] == 'p' || p->str[0] == 'P') && (p->str[1] == 'h' || p->str[1] == 'H'))
+            {
+                ph = strtof(p->str + 2, &end);
+                if (end != p->str + 2 && *end == '\0' && ph > 0 && ph <= 14)
+                    p->cur.ph = ph;
+            }
+            break;
+        }
+        case KEY_COLOR:
+            string_copy(p, p->cur.color, sizeof(p->cur.color));
+            break;
+        case KEY_STATUS:
+            p->cur.no_blob = strcmp(p->str, "stable_no_blob") == 0;
+            break;
+        default:
+            break;
+        }
+    }
+    value_done(p);
+}
+
+static void number_digit(vision_parser_t *p, uint8_t c)
+{
+    p->has_digit = 1;
+    if (p->state == ST_INT && p->mantissa == 0 && c == '0')
+        return;
+    if (p->digits >= VISION_MAX_DIGITS)
+    {
+        // 多余的小数位不影响结果，整数部分过长视为错误
+        if (p->state == ST_INT)
+            line_error(p);
+        return;
+    }
+    p->mantissa = p->mantissa * 10 + (c - '0');
+    p->digits++;
+    if (p->state == ST_FRAC)
+        p->frac++;
+}
+
+static void number_end(vision_parser_t *p)
+{
+    double v;
+
+    if (!p->has_digit)
+    {
+        line_error(p);
+        return;
+    }
+    v = p->mantissa / pow10_table[p->frac];
+    if (p->neg)
+        v = -v;
+
+    if (p->in_array)
+    {
+        if (p->key == KEY_POSITION && p->index == 0)
+            p->cur.x = (int32_t)v;
+        else if (p->key == KEY_POSITION && p->index == 1)
+            p->cur.y = (int32_t)v;
+    }
+    else if (p->key == KEY_AREA)
+    {
+        p->cur.area = (int32_t)v;
+    }
+    else if (p->key == KEY_PH && v > 0 && v <= 14)
+    {
+        // 数值形式的 pH 补一个标签，显示和记录与 "pH7" 形式一致
+        p->cur.ph = (float)v;
+        snprintf(p->cur.label, sizeof(p->cur.label), "pH%.1f", v);
+    }
+    value_done(p);
+}
+
+static void array_end(vision_parser_t *p)
+{
+    p->in_array = 0;
+    if (p->key == KEY_POSITION)
+        p->cur.has_blob = p->index == 2;
+    p->state = ST_NEXT;
+}
+
+// 处理一个字节，返回1表示该字节结束了一个数值或字面量，需要在新状态下再处理一次
+static int parser_step(vision_parser_t *p, uint8_t c)
+{
+    switch (p->state)
+    {
+    case ST_LINE:
+        if (c == '{')
+        {
+            memset(&p->cur, 0, sizeof(p->cur));
+            p->state = ST_KEY_OR_END;
+        }
+        else if (!is_space(c))
+        {
+            line_error(p);
+        }
+        break;
+    case ST_KEY_OR_END:
+    case ST_KEY:
+        if (c == '"')
+            string_begin(p, ST_COLON);
+        else if (c == '}' && p->state == ST_KEY_OR_END)
+            p->state = ST_DONE;
+        else if (!is_space(c))
+            line_error(p);
+        break;
+    case ST_STR:
+        if (c == '"')
+            string_end(p);
+        else if (c == '\\')
+            p->state = ST_ESC;
+        else if (c < 0x20)
+            line_error(p);
+        else
+            string_put(p, &c, 1);
+        break;
+    case ST_ESC:
+        p->state = ST_STR;
+        switch (c)
+        {
+        case 'u':
+            p->cp = 0;
+            p->hex_n = 0;
+            p->state = ST_HEX;
+            break;
+        case 'b': c = '\b'; string_put(p, &c, 1); break;
+        case 'f': c = '\f'; string_put(p, &c, 1); break;
+        case 'n': c = '\n'; string_put(p, &c, 1); break;
+        case 'r': c = '\r'; string_put(p, &c, 1); break;
+        case 't': c = '\t'; string_put(p, &c, 1); break;
+        case '"':
+        case '\\':
+        case '/':
+            string_put(p, &c, 1);
+            break;
+        default:
+            line_error(p);
+            break;
+        }
+        break;
+    case ST_HEX:
+        if (c >= '0' && c <= '9')
+            p->cp = (p->cp << 4) | (c - '0');
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            p->cp = (p->cp << 4) | ((c | 0x20) - 'a' + 10);
+        else
+        {
+            line_error(p);
+            break;
+        }
+        if (++p->hex_n == 4)
+        {
+            string_put_codepoint(p, p->cp);
+            p->state = ST_STR;
+        }
+        break;
+    case ST_COLON:
+        if (c == ':')
+            p->state = ST_VALUE;
+        else if (!is_space(c))
+            line_error(p);
+        break;
+    case ST_ARRAY_FIRST:
+        if (c == ']')
+        {
+            array_end(p);
+            break;
+        }
+        // fall through
+    case ST_VALUE:
+        if (is_space(c))
+            break;
+        if (c == '"')
+        {
+            string_begin(p, ST_NEXT);
+        }
+        else if (c == '-' || (c >= '0' && c <= '9'))
+        {
+            p->neg = c == '-';
+            p->mantissa = 0;
+            p->digits = 0;
+            p->frac = 0;
+            p->has_digit = 0;
+            p->state = ST_INT;
+            if (c != '-')
+                number_digit(p, c);
+        }
+        else if (c == '[' && !p->in_array)
+        {
+            p->in_array = 1;
+            p->index = 0;
+            p->state = ST_ARRAY_FIRST;
+        }
+        else if (c >= 'a' && c <= 'z')
+        {
+            p->state = ST_LIT;
+        }
+        else
+        {
+            // 嵌套的对象或数组不支持
+            line_error(p);
+        }
+        break;
+    case ST_INT:
+    case ST_FRAC:
+        if (c >= '0' && c <= '9')
+        {
+            number_digit(p, c);
+        }
+        else if (c == '.' && p->state == ST_INT && p->has_digit)
+        {
+            p->state = ST_FRAC;
+        }
+        else if (c == 'e' || c == 'E' || c == '.' || c == '-' || c == '+')
+        {
+            line_error(p);
+        }
+        else
+        {
+            number_end(p);
+            return p->state == ST_NEXT;
+        }
+        break;
+    case ST_LIT:
+        if (c < 'a' || c > 'z')
+        {
+            value_done(p);
+            return 1;
+        }
+        break;
+    case ST_NEXT:
+        if (c == ',')
+            p->state = p->in_array ? ST_VALUE : ST_KEY;
+        else if (c == ']' && p->in_array)
+            array_end(p);
+        else if (c == '}' && !p->in_array)
+            p->state = ST_DONE;
+        else if (!is_space(c))
+            line_error(p);
+        break;
+    case ST_DONE:
+        if (!is_space(c))
+            line_error(p);
+        break;
+    default: // ST_SKIP
+        break;
+    }
+    return 0;
+}
+
+/*
+ * @description : 送入一个字节
+ */
+void vision_parser_byte(vision_parser_t *p, uint8_t c)
+{
+    p->stats.bytes++;
+    if (c == '\n' || c == '\r')
+    {
+        // 数值或字面量可能正好在行尾结束
+        if (p->state == ST_INT || p->state == ST_FRAC || p->state == ST_LIT)
+            parser_step(p, ' ');
+        line_end(p);
+        return;
+    }
+    while (parser_step(p, c))
+        ;
+}
+
+void vision_parser_feed(vision_parser_t *p, const uint8_t *data, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        vision_parser_byte(p, data[i]);
+}
+
+/*
+ * @description : 发布最近的视觉结果，填写 seq 和 stamp_ns，只由 I/O 线程调用
+ */
+void vision_publish(vision_result_t *result)
+{
+    result->seq = ++latest_seq;
+    result->stamp_ns = monotonic_ns();
+    seqlock_publish(&latest_lock, &latest, result, sizeof(*result));
+}
+
+/*
+ * @description : 读取最近的视觉结果，任何线程可调用
+ * @return : 1 有结果，0 还没有收到过结果
+ */
+int vision_get_latest(vision_result_t *result)
+{
+    seqlock_snapshot(&latest_lock, result, &latest, sizeof(*result));
+    return result->seq != 0;
+}
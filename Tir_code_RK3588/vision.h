@@ -0,0 +1,75 @@
+#ifndef __VISION_H
+#define __VISION_H
+
+#include <stdint.h>
+
+/*
+ * 视觉模块（OpenMV，见 视觉代码.py）经同一串口每帧发送一行 JSON：
+ *   {"pH": "pH7", "color": "绿", "position": [80, 60], "area": 1234}
+ *   {"pH": "pH7", "color": "绿", "status": "stable_no_blob"}
+ * 以 { 开头的文本行交给本解析器，其余文本行仍是串口文本命令（usart_me_Recive.h）。
+ * 字符串支持 \uXXXX 转义和 UTF-8 原文；未知键忽略；
+ * 只支持一层数组（position），嵌套对象或数组视为格式错误。
+ */
+#define VISION_LABEL_MAX 8  // "pH14" 及结尾 0
+#define VISION_COLOR_MAX 16 // 颜色名 UTF-8，最多5个汉字
+#define VISION_STR_MAX 32   // 字符串临时缓冲，超出部分截断
+#define VISION_MAX_DIGITS 15
+
+typedef struct
+{
+    char label[VISION_LABEL_MAX]; // pH 标签，例如 "pH7"；数值形式的 pH 为 "pH6.5"
+    char color[VISION_COLOR_MAX];
+    float ph;                     // 从标签或数值解析，0 表示未知
+    int32_t x, y;                 // 色块中心，has_blob 时有效
+    int32_t area;
+    uint8_t has_blob;             // 收到完整的 position
+    uint8_t no_blob;              // status 为 stable_no_blob
+    uint32_t seq;                 // 发布序号，从1开始，0 表示还没有结果
+    uint64_t stamp_ns;            // 发布时刻 monotonic_ns()
+} vision_result_t;
+
+typedef void (*vision_result_cb_t)(const vision_result_t *result, void *ctx);
+
+typedef struct
+{
+    uint64_t bytes;
+    uint64_t lines;     // 非空行
+    uint64_t results;   // 解析成功并发出的结果
+    uint64_t errors;    // 格式错误、缺少 pH 或行被截断
+    uint64_t truncated; // 字符串超出缓冲被截断
+} vision_parser_stats_t;
+
+// 解析器状态全部在结构体内，不分配内存，字节可以按任意分段送入
+typedef struct
+{
+    uint8_t state;
+    uint8_t ret_state;  // 字符串结束后的状态
+    uint8_t key;        // 当前键
+    uint8_t in_array;
+    uint8_t index;      // 数组元素序号
+    uint8_t hex_n;      // \u 后已读的十六进制位数
+    uint8_t str_len;
+    uint8_t str_trunc;
+    uint8_t neg;
+    uint8_t digits;
+    uint8_t frac;
+    uint8_t has_digit;
+    uint16_t hi;        // 待配对的高代理项
+    uint32_t cp;
+    int64_t mantissa;
+    char str[VISION_STR_MAX];
+    vision_result_t cur;
+    vision_result_cb_t emit;
+    void *ctx;
+    vision_parser_stats_t stats;
+} vision_parser_t;
+
+void vision_parser_init(vision_parser_t *p, vision_result_cb_t emit, void *ctx);
+void vision_parser_byte(vision_parser_t *p, uint8_t c);
+void vision_parser_feed(vision_parser_t *p, const uint8_t *data, int len);
+
+void vision_publish(vision_result_t *result);
+int vision_get_latest(vision_result_t *result);
+
+#endif